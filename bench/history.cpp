@@ -0,0 +1,159 @@
+// Checks and measures the progress history in src/progress_history.h, which
+// backs progressBar.history. Plain C++, so it runs anywhere:
+//
+//   npm run bench:history
+//
+// Each case records samples into a fresh history, then checks how many
+// buckets it ends up with, how long they are, and what the buckets it
+// names hold: first, last, lowest and highest progress, and RateAt().
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+#include "progress_history.h"
+
+static std::string Describe(const ProgressHistory& history, size_t index) {
+    const ProgressHistory::Bucket& bucket = history[index];
+    char line[96];
+    snprintf(line, sizeof(line), "%zu: %g %g %g %g, %g/s", index, bucket.first, bucket.last, bucket.min,
+             bucket.max, history.RateAt(index));
+    return line;
+}
+
+struct Case {
+    const char* name;
+    std::function<void(ProgressHistory&)> record;
+    std::vector<size_t> shown;
+    std::vector<std::string> expected;
+};
+
+static bool Check(const Case& test) {
+    ProgressHistory history;
+    test.record(history);
+
+    std::vector<std::string> actual;
+    char size[64];
+    snprintf(size, sizeof(size), "%zu buckets of %gs", history.size(), history.interval());
+    actual.push_back(size);
+    for (size_t index : test.shown) {
+        if (index >= history.size()) {
+            actual.push_back(std::to_string(index) + ": missing");
+            continue;
+        }
+        actual.push_back(Describe(history, index));
+    }
+    if (actual == test.expected) {
+        return true;
+    }
+
+    fprintf(stderr, "FAIL %s:\n", test.name);
+    for (const std::string& line : actual) {
+        fprintf(stderr, "  %s\n", line.c_str());
+    }
+    return false;
+}
+
+// How long a Record() takes, compactions included, over a run long enough
+// to double the interval a few times
+static double Measure() {
+    size_t rounds = 0;
+    double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    while (elapsed < std::chrono::milliseconds(200)) {
+        ProgressHistory history;
+        for (int i = 0; i < 100000; i++) {
+            history.Record(i * 0.01, i % 101);
+        }
+        sink += history.RateAt(history.size() - 1);
+        rounds += 100000;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    if (sink != sink) {
+        abort();
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+int main() {
+    const std::vector<Case> cases = {
+        { "first sample", [](ProgressHistory& history) {
+            history.Record(10, 5);
+        }, { 0 }, { "1 buckets of 0.25s", "0: 5 5 5 5, 0/s" } },
+
+        // Bucket 0 has no bucket before it, so its rate starts from the
+        // first sample
+        { "rate at bucket 0", [](ProgressHistory& history) {
+            history.Record(0, 0);
+            history.Record(0.1, 2);
+            history.Record(0.2, 1);
+        }, { 0 }, { "1 buckets of 0.25s", "0: 0 1 0 2, 4/s" } },
+
+        { "flat buckets across a stall", [](ProgressHistory& history) {
+            history.Record(0, 0);
+            history.Record(0.3, 10);
+            history.Advance(1.3);
+        }, { 1, 2, 5 }, { "6 buckets of 0.25s", "1: 0 10 0 10, 40/s", "2: 10 10 10 10, 0/s",
+                          "5: 10 10 10 10, 0/s" } },
+
+        { "sample after a stall", [](ProgressHistory& history) {
+            history.Record(0, 0);
+            history.Record(0.3, 10);
+            history.Advance(1.3);
+            history.Record(1.4, 20);
+        }, { 4, 5 }, { "6 buckets of 0.25s", "4: 10 10 10 10, 0/s", "5: 10 20 10 20, 40/s" } },
+
+        { "advance before any sample", [](ProgressHistory& history) {
+            history.Advance(100);
+        }, {}, { "0 buckets of 0.25s" } },
+
+        { "full without merging", [](ProgressHistory& history) {
+            for (int i = 0; i < 120; i++) {
+                history.Record(i * 0.25, i);
+            }
+        }, { 0, 1, 119 }, { "120 buckets of 0.25s", "0: 0 0 0 0, 0/s", "1: 0 1 0 1, 4/s",
+                            "119: 118 119 118 119, 4/s" } },
+
+        // Bucket 120 doesn't fit, so pairs merge into 60 buckets of 0.5s and
+        // the sample goes into bucket 60
+        { "merging at 120 buckets", [](ProgressHistory& history) {
+            for (int i = 0; i < 120; i++) {
+                history.Record(i * 0.25, i);
+            }
+            history.Record(30, 120);
+        }, { 0, 1, 59, 60 }, { "61 buckets of 0.5s", "0: 0 1 0 1, 2/s", "1: 1 3 1 3, 4/s",
+                               "59: 117 119 117 119, 4/s", "60: 119 120 119 120, 2/s" } },
+
+        // A sample 400 buckets out doubles the interval twice, merging the
+        // lone first bucket with nothing
+        { "interval doubling", [](ProgressHistory& history) {
+            history.Record(0, 0);
+            history.Record(100, 50);
+        }, { 0, 99, 100 }, { "101 buckets of 1s", "0: 0 0 0 0, 0/s", "99: 0 0 0 0, 0/s",
+                             "100: 0 50 0 50, 50/s" } },
+
+        { "merging keeps the extremes", [](ProgressHistory& history) {
+            history.Record(0, 50);
+            history.Record(0.3, 90);
+            history.Record(0.4, 10);
+            history.Record(0.6, 40);
+            history.Advance(30);
+        }, { 0, 1, 2 }, { "61 buckets of 0.5s", "0: 50 10 10 90, -80/s", "1: 10 40 10 40, 60/s",
+                          "2: 40 40 40 40, 0/s" } },
+    };
+
+    bool ok = true;
+    for (const Case& test : cases) {
+        ok = Check(test) && ok;
+    }
+    if (!ok) {
+        return 1;
+    }
+    printf("%zu cases ok\n", cases.size());
+
+    printf("record %8.1f ns\n", Measure());
+    return 0;
+}
@@ -0,0 +1,289 @@
+// Microbenchmarks for the native update path. Runs with plain Node against
+// the headless backend:
+//
+//   node-gyp rebuild --alloc_stats=1   # optional, enables allocs/call
+//   node bench/index.js [--json] [--filter=update]
+//
+// With --json, results are printed as a single JSON document so they can be
+// stored and compared between runs.
+
+const native = require("bindings")("progress_bar");
+
+const BAR_COUNTS = [1, 10, 1000];
+const TARGET_CALLS = 200000;
+const MIN_ROUNDS = 3;
+
+// Fields of a native.updateProgress() call, mirrored in src/progress_bar.cpp
+const UPDATE_PROGRESS = 1 << 0;
+const UPDATE_MESSAGE = 1 << 1;
+const UPDATE_BUTTONS = 1 << 2;
+
+const args = process.argv.slice(2);
+const json = args.includes("--json");
+const filterArg = args.find((arg) => arg.startsWith("--filter="));
+const filter = filterArg ? filterArg.slice("--filter=".length) : null;
+
+function log(...values) {
+  if (!json) {
+    console.log(...values);
+  }
+}
+
+function getAllocations() {
+  if (!native.getAllocationStats) {
+    return null;
+  }
+
+  return native.getAllocationStats();
+}
+
+function showBars(count, buttons = []) {
+  const handles = [];
+  for (let i = 0; i < count; i++) {
+    handles.push(native.showProgressBar("Benchmark", "Working", "default", buttons));
+  }
+  return handles;
+}
+
+function closeBars(handles) {
+  for (const handle of handles) {
+    native.closeProgress(handle);
+  }
+}
+
+// (id, progress) pairs for updateMany(), built once per set of handles
+const pairsByHandles = new WeakMap();
+function getPairs(handles) {
+  let pairs = pairsByHandles.get(handles);
+  if (!pairs || pairs.length !== handles.length * 2) {
+    pairs = new Float64Array(handles.length * 2);
+    handles.forEach((handle, i) => {
+      pairs[i * 2] = native.getProgressBarId(handle);
+    });
+    pairsByHandles.set(handles, pairs);
+  }
+  return pairs;
+}
+
+const noop = () => {};
+const BUTTONS_A = [{ label: "Cancel", click: noop }];
+const BUTTONS_B = [
+  { label: "Pause", click: noop },
+  { label: "Cancel", click: noop },
+];
+
+/**
+ * Each scenario gets `bars` open handles and runs `run(handles, round)` once
+ * per round. `run` returns the number of native calls it made.
+ */
+const SCENARIOS = [
+  {
+    name: "showProgressBar",
+    setup: () => [],
+    run: (handles, round, bars) => {
+      const created = showBars(bars);
+      handles.push(...created);
+      return bars;
+    },
+    // Closing is not part of what we measure here
+    afterRound: (handles) => {
+      closeBars(handles);
+      handles.length = 0;
+    },
+  },
+  {
+    name: "closeProgress",
+    setup: () => [],
+    beforeRound: (handles, bars) => {
+      handles.push(...showBars(bars));
+    },
+    run: (handles) => {
+      closeBars(handles);
+      const calls = handles.length;
+      handles.length = 0;
+      return calls;
+    },
+  },
+  {
+    name: "setProgress",
+    run: (handles, round) => {
+      const progress = round % 100;
+      for (const handle of handles) {
+        native.setProgress(handle, progress);
+      }
+      return handles.length;
+    },
+  },
+  {
+    // One native call per round, so report per bar
+    name: "updateMany",
+    run: (handles, round) => {
+      const pairs = getPairs(handles);
+      const progress = round % 100;
+      for (let i = 0; i < handles.length; i++) {
+        pairs[i * 2 + 1] = progress;
+      }
+      native.updateMany(pairs);
+      return handles.length;
+    },
+  },
+  {
+    name: "setMessage (unchanged)",
+    run: (handles) => {
+      for (const handle of handles) {
+        native.setMessage(handle, "Downloading file.zip");
+      }
+      return handles.length;
+    },
+  },
+  {
+    name: "setMessage (changed)",
+    run: (handles, round) => {
+      const message = `Downloading file ${round}.zip`;
+      for (const handle of handles) {
+        native.setMessage(handle, message);
+      }
+      return handles.length;
+    },
+  },
+  {
+    name: "updateProgress (progress+message)",
+    run: (handles, round) => {
+      const message = `Downloading file ${round}.zip`;
+      for (const handle of handles) {
+        native.updateProgress(handle, UPDATE_PROGRESS | UPDATE_MESSAGE, round % 100, message);
+      }
+      return handles.length;
+    },
+  },
+  {
+    name: "updateProgress (buttons)",
+    run: (handles, round) => {
+      const buttons = round % 2 ? BUTTONS_A : BUTTONS_B;
+      for (const handle of handles) {
+        native.updateProgress(handle, UPDATE_BUTTONS, 0, "", buttons);
+      }
+      return handles.length;
+    },
+  },
+  {
+    name: "flush",
+    beforeRound: (handles, bars, round) => {
+      const message = `Downloading file ${round}.zip`;
+      for (const handle of handles) {
+        native.updateProgress(handle, UPDATE_PROGRESS | UPDATE_MESSAGE, round % 100, message);
+      }
+    },
+    // One flush applies one frame to every bar, so report per bar
+    run: (handles) => {
+      native.flush();
+      return handles.length;
+    },
+  },
+];
+
+function runScenario(scenario, bars) {
+  const handles = scenario.setup ? scenario.setup() : showBars(bars);
+  const rounds = Math.max(MIN_ROUNDS, Math.ceil(TARGET_CALLS / bars));
+
+  // Warm up, so that JIT and first-use allocations don't skew the numbers
+  for (let round = 0; round < Math.min(rounds, 100); round++) {
+    scenario.beforeRound?.(handles, bars, round);
+    scenario.run(handles, round, bars);
+    scenario.afterRound?.(handles, bars, round);
+  }
+  native.flush();
+
+  let calls = 0;
+  let elapsed = 0n;
+  let allocations = 0;
+  let allocatedBytes = 0;
+
+  for (let round = 0; round < rounds; round++) {
+    scenario.beforeRound?.(handles, bars, round);
+
+    const allocationsBefore = getAllocations();
+    const start = process.hrtime.bigint();
+    calls += scenario.run(handles, round, bars);
+    elapsed += process.hrtime.bigint() - start;
+    const allocationsAfter = getAllocations();
+
+    if (allocationsBefore && allocationsAfter) {
+      allocations += allocationsAfter.allocations - allocationsBefore.allocations;
+      allocatedBytes += allocationsAfter.allocatedBytes - allocationsBefore.allocatedBytes;
+    }
+
+    scenario.afterRound?.(handles, bars, round);
+  }
+
+  native.flush();
+  closeBars(handles);
+
+  const hasAllocations = !!native.getAllocationStats;
+  return {
+    scenario: scenario.name,
+    bars,
+    calls,
+    nsPerCall: Number(elapsed) / calls,
+    allocationsPerCall: hasAllocations ? allocations / calls : null,
+    bytesPerCall: hasAllocations ? allocatedBytes / calls : null,
+  };
+}
+
+function format(value, digits) {
+  return value === null ? "-" : value.toFixed(digits);
+}
+
+function main() {
+  if (native.getBackends().includes("headless")) {
+    native.setBackend("headless");
+  } else {
+    console.error("The benchmarks need the headless backend, which is only available on Linux.");
+    process.exit(1);
+  }
+
+  // Nothing should be applied behind our back while we measure
+  native.setMaxFrameRate(1);
+
+  if (!native.getAllocationStats) {
+    log("Allocation counting is off. Build with `node-gyp rebuild --alloc_stats=1` to enable it.\n");
+  }
+
+  const results = [];
+  for (const scenario of SCENARIOS) {
+    if (filter && !scenario.name.includes(filter)) {
+      continue;
+    }
+
+    for (const bars of BAR_COUNTS) {
+      const result = runScenario(scenario, bars);
+      results.push(result);
+
+      log(
+        `${result.scenario.padEnd(36)} ${String(bars).padStart(5)} bars ` +
+          `${format(result.nsPerCall, 1).padStart(10)} ns/call ` +
+          `${format(result.allocationsPerCall, 2).padStart(7)} allocs/call ` +
+          `${format(result.bytesPerCall, 1).padStart(8)} bytes/call`,
+      );
+    }
+  }
+
+  if (json) {
+    console.log(
+      JSON.stringify(
+        {
+          date: new Date().toISOString(),
+          node: process.version,
+          platform: process.platform,
+          arch: process.arch,
+          allocationStats: !!native.getAllocationStats,
+          results,
+        },
+        null,
+        2,
+      ),
+    );
+  }
+}
+
+main();
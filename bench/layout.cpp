@@ -0,0 +1,192 @@
+// Checks and measures the window layout in src/progress_layout.h, which the
+// macOS and Windows backends apply to every bar. Needs no window system, so
+// it runs anywhere:
+//
+//   npm run bench:layout
+//
+// Each case takes one layout through a series of button changes and checks
+// the ops every step returns, in order. Labels measure 10 units per byte.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "progress_layout.h"
+
+static ProgressBarLayoutMetrics Metrics(bool firstButtonRightmost) {
+    ProgressBarLayoutMetrics metrics;
+    metrics.contentWidth = 400;
+    metrics.margin = 20;
+    metrics.top = 20;
+    metrics.messageHeight = 20;
+    metrics.progressGap = 10;
+    metrics.progressHeight = 20;
+    metrics.buttonGap = 10;
+    metrics.buttonHeight = 30;
+    metrics.buttonMinWidth = 80;
+    metrics.buttonPadding = 20;
+    metrics.buttonSpacing = 10;
+    metrics.bottomMargin = 20;
+    metrics.firstButtonRightmost = firstButtonRightmost;
+    return metrics;
+}
+
+static int MeasureLabel(const std::string& label) {
+    return static_cast<int>(label.size()) * 10;
+}
+
+static std::string Describe(const LayoutOp& op) {
+    const LayoutRect& r = op.rect;
+    char where[64];
+    snprintf(where, sizeof(where), "%d,%d %dx%d", r.x, r.y, r.width, r.height);
+    std::string index = std::to_string(op.index);
+    switch (op.kind) {
+        case LayoutOpKind::kResize:
+            return "resize " + std::to_string(r.width) + "x" + std::to_string(r.height);
+        case LayoutOpKind::kMoveMessage:
+            return std::string("move message ") + where;
+        case LayoutOpKind::kMoveProgress:
+            return std::string("move progress ") + where;
+        case LayoutOpKind::kCreateButton:
+            return "create " + index + " " + where;
+        case LayoutOpKind::kRelabelButton:
+            return "relabel " + index + " " + where;
+        case LayoutOpKind::kMoveButton:
+            return "move " + index + " " + where;
+        case LayoutOpKind::kDestroyButton:
+            return "destroy " + index;
+    }
+    return "?";
+}
+
+struct Step {
+    std::vector<std::string> labels;
+    std::vector<std::string> expected;
+};
+
+struct Case {
+    const char* name;
+    bool firstButtonRightmost;
+    std::vector<Step> steps;
+};
+
+static bool Check(const Case& test) {
+    ProgressBarLayout layout;
+    ProgressBarLayoutMetrics metrics = Metrics(test.firstButtonRightmost);
+    for (size_t i = 0; i < test.steps.size(); i++) {
+        const Step& step = test.steps[i];
+        std::vector<std::string> actual;
+        for (const LayoutOp& op : layout.Update(metrics, step.labels, MeasureLabel)) {
+            actual.push_back(Describe(op));
+        }
+        if (actual == step.expected) {
+            continue;
+        }
+
+        fprintf(stderr, "FAIL %s, step %zu:\n", test.name, i);
+        for (const std::string& op : actual) {
+            fprintf(stderr, "  %s\n", op.c_str());
+        }
+        return false;
+    }
+    return true;
+}
+
+// How long an Update() that changes nothing takes, which is what every
+// repeated setButtons() with the same labels costs
+static double Measure(const std::vector<std::string>& labels) {
+    ProgressBarLayout layout;
+    ProgressBarLayoutMetrics metrics = Metrics(false);
+    layout.Update(metrics, labels, MeasureLabel);
+
+    size_t rounds = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    size_t sink = 0;
+    while (elapsed < std::chrono::milliseconds(200)) {
+        for (int i = 0; i < 1000; i++) {
+            sink += layout.Update(metrics, labels, MeasureLabel).size();
+        }
+        rounds += 1000;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    if (sink != 0) {
+        abort();
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+int main() {
+    const std::vector<Case> cases = {
+        { "first layout", false, {
+            { {}, { "resize 400x90", "move message 20,20 360x20", "move progress 20,50 360x20" } },
+            { {}, {} },
+        } },
+        { "grow", false, {
+            { {}, { "resize 400x90", "move message 20,20 360x20", "move progress 20,50 360x20" } },
+            { { "OK", "Cancel" }, { "resize 400x130", "create 0 210,80 80x30", "create 1 300,80 80x30" } },
+            { { "OK", "Cancel" }, {} },
+        } },
+        { "button count change", false, {
+            { { "OK", "Cancel" }, { "resize 400x130", "move message 20,20 360x20",
+                                    "move progress 20,50 360x20", "create 0 210,80 80x30",
+                                    "create 1 300,80 80x30" } },
+            { { "OK", "Cancel", "Retry" }, { "move 0 120,80 80x30", "move 1 210,80 80x30",
+                                             "create 2 300,80 80x30" } },
+            { { "OK", "Cancel" }, { "move 0 210,80 80x30", "move 1 300,80 80x30", "destroy 2" } },
+        } },
+        { "button count change, first rightmost", true, {
+            { { "OK" }, { "resize 400x130", "move message 20,20 360x20",
+                          "move progress 20,50 360x20", "create 0 300,80 80x30" } },
+            { { "OK", "Cancel" }, { "create 1 210,80 80x30" } },
+        } },
+        { "relabel", false, {
+            { { "OK", "Cancel", "Retry" }, { "resize 400x130", "move message 20,20 360x20",
+                                             "move progress 20,50 360x20", "create 0 120,80 80x30",
+                                             "create 1 210,80 80x30", "create 2 300,80 80x30" } },
+            { { "Stop", "Cancel", "Retry" }, { "relabel 0 120,80 80x30" } },
+            { { "Stop", "Cancel", "Retry now" }, { "move 0 90,80 80x30", "move 1 180,80 80x30",
+                                                   "relabel 2 270,80 110x30" } },
+        } },
+        { "relabel moves the others", true, {
+            { { "OK", "Cancel" }, { "resize 400x130", "move message 20,20 360x20",
+                                    "move progress 20,50 360x20", "create 0 300,80 80x30",
+                                    "create 1 210,80 80x30" } },
+            { { "Try again", "Cancel" }, { "move 1 180,80 80x30", "relabel 0 270,80 110x30" } },
+        } },
+        { "relabel and create", false, {
+            { { "OK" }, { "resize 400x130", "move message 20,20 360x20",
+                          "move progress 20,50 360x20", "create 0 300,80 80x30" } },
+            { { "Stop", "Cancel" }, { "create 1 300,80 80x30", "relabel 0 210,80 80x30" } },
+        } },
+        { "shrink", false, {
+            { { "Try again", "Cancel", "Retry" }, { "resize 400x130", "move message 20,20 360x20",
+                                                    "move progress 20,50 360x20",
+                                                    "create 0 90,80 110x30", "create 1 210,80 80x30",
+                                                    "create 2 300,80 80x30" } },
+            { { "Stop" }, { "relabel 0 300,80 80x30", "destroy 2", "destroy 1" } },
+            { {}, { "resize 400x90", "destroy 0" } },
+            { {}, {} },
+        } },
+    };
+
+    bool ok = true;
+    for (const Case& test : cases) {
+        ok = Check(test) && ok;
+    }
+    if (!ok) {
+        return 1;
+    }
+    printf("%zu cases ok\n", cases.size());
+
+    const std::pair<const char*, std::vector<std::string>> inputs[] = {
+        { "no buttons", {} },
+        { "two buttons", { "Pause", "Cancel" } },
+        { "four buttons", { "Pause", "Skip", "Retry", "Cancel" } },
+    };
+    for (const auto& input : inputs) {
+        printf("%-12s %8.1f ns per unchanged update\n", input.first, Measure(input.second));
+    }
+    return 0;
+}
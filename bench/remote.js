@@ -0,0 +1,131 @@
+// Checks that a bar shows what another process writes with RemoteProgress,
+// with two plain Node processes and the headless backend. Runs against
+// lib/, so it builds the TypeScript first:
+//
+//   npm run test:remote
+//
+// The parent shows a bar and forks a writer, which opens the bar by its
+// sharedMemoryName. They take turns over IPC: the writer writes a step, the
+// parent checks what the headless window shows, then asks for the next.
+
+const { fork } = require("child_process");
+const assert = require("assert");
+const { ProgressBar, RemoteProgress, headless } = require("..");
+
+// What the writer does in each step, in order
+const steps = {
+  "progress and message"(remote) {
+    remote.update({ progress: 42.5, message: "From another process ✓" });
+  },
+  "message alone"(remote) {
+    remote.message = "Only the message";
+  },
+  "many writes"(remote) {
+    for (let i = 0; i <= 100000; i++) {
+      remote.progress = i / 1000;
+    }
+  },
+  "long message"(remote) {
+    remote.message = "x".repeat(1023) + "é";
+  },
+};
+
+// The parent's side of each step
+const checks = {
+  "progress and message"(state) {
+    assert.strictEqual(state.progress, 42.5);
+    assert.strictEqual(state.message, "From another process ✓");
+  },
+  "message alone"(state) {
+    assert.strictEqual(state.progress, 42.5);
+    assert.strictEqual(state.message, "Only the message");
+  },
+  "many writes"(state) {
+    assert.strictEqual(state.progress, 100);
+  },
+  // Cut at 1024 bytes, before the character that doesn't fit
+  "long message"(state) {
+    assert.strictEqual(state.message, "x".repeat(1023));
+  },
+};
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+function writer(name) {
+  const remote = RemoteProgress.open(name);
+  if (!remote) {
+    process.send({ error: `Couldn't open ${name}` });
+    return;
+  }
+
+  const names = Object.keys(steps);
+  let next = 0;
+  const step = () => {
+    if (next === names.length) {
+      remote.close();
+      process.disconnect();
+      return;
+    }
+    steps[names[next]](remote);
+    process.send({ step: names[next++] });
+  };
+  process.on("message", step);
+  step();
+}
+
+// Resolves with the writer's next message
+function receive(child) {
+  return new Promise((resolve, reject) => {
+    const onExit = (code) => reject(new Error(`The writer exited with ${code}`));
+    child.once("exit", onExit);
+    child.once("message", (message) => {
+      child.off("exit", onExit);
+      resolve(message);
+    });
+  });
+}
+
+async function main() {
+  if (!ProgressBar.backends.includes("headless")) {
+    console.error("The remote tests need the headless backend, which is only available on Linux.");
+    process.exit(1);
+  }
+  ProgressBar.backend = "headless";
+
+  const bar = new ProgressBar({ title: "Remote", message: "Waiting" });
+  const name = bar.sharedMemoryName;
+  assert.ok(name);
+  assert.strictEqual(RemoteProgress.open("npb-0-0"), null);
+
+  const child = fork(__filename, ["writer", name]);
+  for (const expected of Object.keys(checks)) {
+    const { step, error } = await receive(child);
+    if (error) {
+      throw new Error(error);
+    }
+    assert.strictEqual(step, expected);
+
+    // The bar samples the segment once per frame
+    await sleep(50);
+    ProgressBar.flush();
+    checks[step](headless.getState(bar));
+    child.send("next");
+  }
+  await new Promise((resolve) => child.once("exit", resolve));
+  assert.strictEqual(child.exitCode, 0);
+
+  bar.close();
+  assert.strictEqual(RemoteProgress.open(name), null);
+  console.log(`${Object.keys(checks).length} steps ok`);
+}
+
+if (process.argv[2] === "writer") {
+  writer(process.argv[3]);
+} else {
+  main().catch((error) => {
+    console.error(`FAIL ${error.message}`);
+    process.exit(1);
+  });
+}
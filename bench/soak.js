@@ -0,0 +1,434 @@
+// Soak test for the lifecycle of progress bars. Shows, updates and closes
+// bars in every way there is - closeProgress(), garbage collection, a
+// closing worker's environment teardown - from the main thread and from
+// worker threads at once, against the headless backend. Every round ends
+// with everything closed and collected; the test fails if anything is still
+// alive then, or if the heap keeps growing:
+//
+//   npm run soak -- [--seconds=60] [--cycles=N] [--workers=4]
+//                   [--max-heap-growth=4] [--max-rss-growth=MB] [--json]
+//
+// The heap is what malloc has handed out and not gotten back, see
+// `heapInUse` in the diagnostics. RSS also counts memory that was freed but
+// that the allocator keeps, which grows with every worker's threads and
+// doesn't settle within a minute, so it is only reported. Without
+// `heapInUse`, RSS is checked instead, against 32 MB.
+//
+// To run it under a sanitizer, build the addon with one and preload its
+// runtime into Node, which isn't built with it. Sanitizers bring their own
+// allocator, so only the live counters mean anything then:
+//
+//   node-gyp rebuild --sanitize=address
+//   ASAN_OPTIONS=detect_leaks=0 LD_PRELOAD=$(cc -print-file-name=libasan.so) \
+//     node --expose-gc bench/soak.js --max-heap-growth=Infinity --max-rss-growth=Infinity
+//
+//   node-gyp rebuild --sanitize=thread
+//   TSAN_OPTIONS=suppressions=bench/tsan.supp LD_PRELOAD=$(cc -print-file-name=libtsan.so) \
+//     node --expose-gc bench/soak.js --max-heap-growth=Infinity --max-rss-growth=Infinity
+//
+// Node itself doesn't free everything at exit, hence detect_leaks=0: leaks
+// of ours show up in the live counters instead.
+
+const { Worker, isMainThread, parentPort, workerData } = require("worker_threads");
+const native = require("bindings")("progress_bar");
+
+// Fields of a native.updateProgress() call, mirrored in src/progress_bar.cpp
+const UPDATE_PROGRESS = 1 << 0;
+const UPDATE_MESSAGE = 1 << 1;
+const UPDATE_BUTTONS = 1 << 2;
+
+// Cycles between yields to the event loop, which lets frames, clicks and
+// finalizers run
+const BATCH = 200;
+// Bars left open across batches, closed later or by teardown
+const OPEN_BARS = 32;
+// Heap growth allowed for every worker: what Node keeps of an environment
+// that went away with externals still alive, see runWorker(). About 40 bytes
+// for each of the bars left open and, if it was terminated, its last batch.
+const WORKER_HEAP_ALLOWANCE = 8 * 1024;
+
+const noop = () => {};
+const BUTTONS = [
+  { label: "Pause", click: noop },
+  { label: "Cancel", click: noop },
+];
+
+function getNumber(args, name, fallback) {
+  const arg = args.find((value) => value.startsWith(`--${name}=`));
+  return arg ? Number(arg.slice(name.length + 3)) : fallback;
+}
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+function yieldToLoop() {
+  return new Promise((resolve) => setImmediate(resolve));
+}
+
+/**
+ * One bar's life: show it, put it through a few features, and end it in
+ * one of several ways. `open` holds bars that outlive the cycle.
+ */
+function cycle(i, open, pending) {
+  const handle = native.showProgressBar("Soak", "Starting", "default", i % 3 === 0 ? BUTTONS : []);
+  native.setProgress(handle, i % 100);
+  native.updateProgress(handle, UPDATE_PROGRESS | UPDATE_MESSAGE, (i * 7) % 100, `Step ${i}`);
+
+  switch (i % 7) {
+    case 0:
+      native.setBytes(handle, i * 1024, 1024 * 1024 * 1024);
+      native.setMessageFormat(handle, "{done} of {total} ({rate}, {eta} left)");
+      break;
+    case 1:
+      native.animateTo(handle, 100, 5, "ease-out");
+      break;
+    case 2: {
+      const task = native.addTask(handle, 0, "download", 2);
+      const leaf = native.addTask(handle, task, "part", 1);
+      native.addTask(handle, 0, "extract", 1);
+      native.setTaskProgress(handle, leaf, 50);
+      break;
+    }
+    case 3: {
+      const cells = new Int32Array(new SharedArrayBuffer(16));
+      native.attachSharedProgress(handle, cells);
+      Atomics.store(cells, 1, 420000);
+      Atomics.add(cells, 0, 1);
+      if (i % 2) {
+        native.attachSharedProgress(handle, null);
+      }
+      break;
+    }
+    case 4: {
+      const writer = native.openSharedSegment(native.createSharedSegment(handle));
+      native.writeSharedSegment(writer, 33, "From a writer");
+      // Half of the writers are left to the garbage collector
+      if (i % 2) {
+        native.closeSharedSegment(writer);
+      }
+      break;
+    }
+    case 5:
+      native.setIndeterminate(handle, true);
+      native.setSparkline(handle, true);
+      native.getProgressHistory(handle);
+      break;
+    case 6:
+      native.updateProgress(handle, UPDATE_BUTTONS, 0, "", i % 2 ? BUTTONS : []);
+      break;
+  }
+
+  if (i % 3 === 0 && native.clickHeadlessButton) {
+    native.clickHeadlessButton(handle, i % 2);
+  }
+
+  switch (i % 5) {
+    case 0:
+    case 1:
+      native.closeProgress(handle);
+      break;
+    case 2:
+      // Closed by FinalizeProgressBar once it is collected
+      break;
+    case 3:
+      // Closed in a later cycle, or by environment teardown
+      open.push(handle);
+      if (open.length > OPEN_BARS) {
+        native.closeProgress(open.shift());
+      }
+      break;
+    case 4:
+      // Closed while the UI thread may still be showing it
+      pending.push(native.syncProgressBar(handle).then(() => native.closeProgress(handle)));
+      native.closeProgress(handle);
+      break;
+  }
+
+  if (i % 50 === 0) {
+    const group = native.showProgressGroup("Soak group", "default");
+    native.addProgressGroupRow(group, 1, 10, "one");
+    native.addProgressGroupRow(group, 2, 20, "two");
+    native.updateProgressGroupRow(group, 1, UPDATE_PROGRESS | UPDATE_MESSAGE, 60, "one, later");
+    native.removeProgressGroupRow(group, 2);
+    if (i % 100 === 0) {
+      native.closeProgress(group);
+    }
+  }
+}
+
+/**
+ * Runs cycles until `done()` says so, counting them in `counter`, and
+ * collects garbage every `gcEvery` cycles
+ */
+async function runCycles(counter, done, gcEvery) {
+  const open = [];
+  let pending = [];
+  let i = 0;
+
+  while (!done()) {
+    for (let end = i + BATCH; i < end; i++) {
+      cycle(i, open, pending);
+    }
+    Atomics.add(counter, 0, BATCH);
+
+    await Promise.all(pending);
+    pending = [];
+    await yieldToLoop();
+    if (i % gcEvery === 0) {
+      global.gc();
+    }
+  }
+
+  return open;
+}
+
+async function runWorker() {
+  const counter = new Int32Array(workerData.counter);
+  const deadline = Date.now() + workerData.lifetime;
+  // Leaves its open bars to the environment's cleanup hook, unless it is
+  // terminated first. Collects garbage every batch and once more at the end:
+  // Node never frees the 40 bytes it keeps for every external, with or
+  // without a finalizer, that is still alive when its environment goes
+  // away, which would drown out anything of ours. This way only the bars
+  // left open on purpose, and a terminated worker's last batch, are still
+  // alive then.
+  const open = await runCycles(counter, () => Date.now() > deadline || Atomics.load(counter, 1) !== 0, BATCH);
+  global.gc();
+  parentPort.postMessage(open.length);
+}
+
+// Closed handles still hold their context until they are collected. Not in
+// main(): a suspended async function keeps its locals, loop variables
+// included, reachable until it returns.
+function closeAll(handles) {
+  for (const handle of handles) {
+    native.closeProgress(handle);
+  }
+  handles.length = 0;
+}
+
+// Samples once the garbage collector has had a chance to run the finalizers
+// and the live counters have dropped to zero, or after five seconds
+async function settle(start, counter) {
+  let value;
+  for (let attempt = 0; attempt < 50; attempt++) {
+    await sleep(attempt === 0 ? 10 : 100);
+    value = sample(start, counter);
+    if (value.liveContexts === 0 && value.liveReferences === 0 && value.liveSharedSegments === 0) {
+      break;
+    }
+  }
+  return value;
+}
+
+function sample(start, counter) {
+  global.gc();
+  native.flush();
+  const diagnostics = native.getDiagnostics();
+  return {
+    seconds: (Date.now() - start) / 1000,
+    cycles: Atomics.load(counter, 0),
+    rss: process.memoryUsage().rss,
+    heapInUse: diagnostics.heapInUse,
+    heapUsed: process.memoryUsage().heapUsed,
+    liveContexts: diagnostics.liveContexts,
+    liveReferences: diagnostics.liveReferences,
+    liveSharedSegments: diagnostics.liveSharedSegments,
+    openHandles: diagnostics.openHandles,
+  };
+}
+
+function formatSample(value) {
+  return (
+    `${value.seconds.toFixed(0).padStart(6)} s ${String(value.cycles).padStart(10)} cycles ` +
+    `${(value.rss / 1048576).toFixed(1).padStart(8)} MB rss ` +
+    (value.heapInUse !== undefined ? `${(value.heapInUse / 1048576).toFixed(1).padStart(7)} MB in use ` : "") +
+    `${(value.heapUsed / 1048576).toFixed(1).padStart(7)} MB heap ` +
+    `${String(value.liveContexts).padStart(6)} contexts ${String(value.liveReferences).padStart(6)} refs ` +
+    `${String(value.liveSharedSegments).padStart(4)} segments ${String(value.openHandles).padStart(5)} open`
+  );
+}
+
+// Least squares slope of RSS over time, in MB per hour
+function rssSlope(samples) {
+  const n = samples.length;
+  if (n < 2) {
+    return 0;
+  }
+
+  const meanX = samples.reduce((sum, value) => sum + value.seconds, 0) / n;
+  const meanY = samples.reduce((sum, value) => sum + value.rss, 0) / n;
+  let covariance = 0;
+  let variance = 0;
+  for (const value of samples) {
+    covariance += (value.seconds - meanX) * (value.rss - meanY);
+    variance += (value.seconds - meanX) ** 2;
+  }
+  return variance > 0 ? ((covariance / variance) * 3600) / 1048576 : 0;
+}
+
+// glibc gives threads their own malloc arenas, up to eight per core, and
+// keeps what they freed for reuse. Every worker brings three new threads, so
+// RSS would grow with the number of arenas they went through rather than
+// with anything that leaked. Reruns the test with two arenas, unless the
+// caller picked a number.
+function rerunWithBoundedArenas() {
+  if (process.platform !== "linux" || process.env.MALLOC_ARENA_MAX !== undefined) {
+    return false;
+  }
+
+  const { spawnSync } = require("child_process");
+  const result = spawnSync(process.execPath, [...process.execArgv, __filename, ...process.argv.slice(2)], {
+    stdio: "inherit",
+    env: { ...process.env, MALLOC_ARENA_MAX: "2" },
+  });
+  process.exitCode = result.status ?? 1;
+  return true;
+}
+
+async function main() {
+  if (rerunWithBoundedArenas()) {
+    return;
+  }
+
+  const args = process.argv.slice(2);
+  const json = args.includes("--json");
+  const seconds = getNumber(args, "seconds", 60);
+  const maxCycles = getNumber(args, "cycles", Infinity);
+  const workerCount = getNumber(args, "workers", 4);
+  const measuresHeap = native.getDiagnostics().heapInUse !== undefined;
+  const maxHeapGrowth = getNumber(args, "max-heap-growth", 4) * 1048576;
+  const maxRssGrowth = getNumber(args, "max-rss-growth", measuresHeap ? Infinity : 32) * 1048576;
+  const log = json ? noop : console.log;
+
+  if (typeof global.gc !== "function") {
+    console.error("The soak test needs to collect garbage: run it with `node --expose-gc`.");
+    process.exit(1);
+  }
+  if (!native.getBackends().includes("headless")) {
+    console.error("The soak test needs the headless backend, which is only available on Linux.");
+    process.exit(1);
+  }
+  native.setBackend("headless");
+  native.setHeadlessRecording(false);
+  // Frames as often as possible, so they race with everything else
+  native.setMaxFrameRate(0);
+
+  // [0] counts cycles across threads, [1] tells workers to stop
+  const counter = new Int32Array(new SharedArrayBuffer(8));
+  const start = Date.now();
+  const deadline = start + seconds * 1000;
+  const done = () => Date.now() > deadline || Atomics.load(counter, 0) >= maxCycles;
+  const roundLength = Math.max(1000, (seconds * 1000) / 20);
+
+  // Workers come and go for the whole round. Every other one is terminated
+  // mid-cycle instead of finishing on its own.
+  const workers = new Set();
+  let workersStarted = 0;
+  function startWorker(roundEnd) {
+    const lifetime = 200 + Math.random() * 800;
+    const worker = new Worker(__filename, {
+      workerData: { counter: counter.buffer, lifetime },
+    });
+    const exited = new Promise((resolve) => worker.on("exit", resolve));
+    worker.on("error", (error) => {
+      console.error("Worker failed:", error);
+      process.exitCode = 1;
+    });
+    if (workersStarted++ % 2) {
+      setTimeout(() => worker.terminate(), lifetime / 2);
+    }
+    workers.add(exited);
+    exited.then(() => {
+      workers.delete(exited);
+      if (Date.now() < roundEnd && !done()) {
+        startWorker(roundEnd);
+      }
+    });
+  }
+
+  // Each round ends with everything closed and collected, so that samples
+  // compare the same state: anything still alive then has leaked.
+  const samples = [];
+  const failures = [];
+  while (!done()) {
+    const roundEnd = Date.now() + roundLength;
+    Atomics.store(counter, 1, 0);
+    for (let i = 0; i < workerCount; i++) {
+      startWorker(roundEnd);
+    }
+
+    closeAll(await runCycles(counter, () => Date.now() > roundEnd || done(), BATCH * 50));
+    Atomics.store(counter, 1, 1);
+    while (workers.size > 0) {
+      await Promise.all([...workers]);
+    }
+
+    const value = await settle(start, counter);
+    value.workersStarted = workersStarted;
+    samples.push(value);
+    log(formatSample(value));
+    for (const name of ["liveContexts", "liveReferences", "liveSharedSegments", "openHandles"]) {
+      if (value[name] !== 0) {
+        failures.push(`${name} is ${value[name]} after closing everything at ${value.seconds.toFixed(0)} s`);
+      }
+    }
+  }
+
+  // The first quarter warms up allocators, JIT and the window pool
+  const final = samples[samples.length - 1];
+  const steady = samples.slice(Math.floor(samples.length / 4));
+  const growth = final.rss - steady[0].rss;
+  if (growth > maxRssGrowth) {
+    failures.push(
+      `RSS grew by ${(growth / 1048576).toFixed(1)} MB after warming up, ` +
+        `more than ${(maxRssGrowth / 1048576).toFixed(0)} MB`,
+    );
+  }
+  const heapGrowth = measuresHeap ? final.heapInUse - steady[0].heapInUse : null;
+  const allowedHeapGrowth =
+    maxHeapGrowth + (final.workersStarted - steady[0].workersStarted) * WORKER_HEAP_ALLOWANCE;
+  if (measuresHeap && heapGrowth > allowedHeapGrowth) {
+    failures.push(
+      `Heap in use grew by ${(heapGrowth / 1048576).toFixed(1)} MB after warming up, ` +
+        `more than ${(allowedHeapGrowth / 1048576).toFixed(1)} MB`,
+    );
+  }
+
+  const result = {
+    date: new Date().toISOString(),
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cycles: final.cycles,
+    workersStarted,
+    rssGrowth: growth,
+    heapGrowth,
+    rssSlopeMBPerHour: rssSlope(steady),
+    passed: failures.length === 0,
+    failures,
+    samples,
+  };
+
+  if (json) {
+    console.log(JSON.stringify(result, null, 2));
+  } else {
+    log(
+      `\n${result.cycles} cycles, ${workersStarted} workers, RSS ${(growth / 1048576).toFixed(1)} MB ` +
+        `after warming up (${result.rssSlopeMBPerHour.toFixed(1)} MB/h)` +
+        (measuresHeap ? `, heap in use ${(heapGrowth / 1048576).toFixed(1)} MB` : ""),
+    );
+    log(result.passed ? "PASS" : `FAIL\n  ${failures.join("\n  ")}`);
+  }
+
+  if (!result.passed) {
+    process.exitCode = 1;
+  }
+}
+
+if (isMainThread) {
+  main();
+} else {
+  runWorker();
+}
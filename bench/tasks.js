@@ -0,0 +1,158 @@
+// Checks how task progress adds up, see progressBar.addTask(), against the
+// headless backend:
+//
+//   npm run test:tasks
+//
+// Every case builds a fresh bar's task tree and compares the progress and
+// message the headless window ends up with.
+
+const assert = require("assert");
+const native = require("bindings")("progress_bar");
+
+const SEPARATOR = " › ";
+
+function show() {
+  return native.showProgressBar("Tasks", "", "default", []);
+}
+
+// Progress and message as the headless window has them, after every
+// pending frame went out
+function shown(handle) {
+  native.flush();
+  const { progress, message } = native.getHeadlessState(handle);
+  return { progress, message };
+}
+
+const cases = {
+  "weighted siblings"() {
+    const handle = show();
+    const download = native.addTask(handle, 0, "download", 3);
+    const extract = native.addTask(handle, 0, "extract", 1);
+
+    assert.strictEqual(native.setTaskProgress(handle, download, 50), 37.5);
+    assert.deepStrictEqual(shown(handle), { progress: 37.5, message: "download" });
+
+    assert.strictEqual(native.setTaskProgress(handle, extract, 100), 62.5);
+    assert.deepStrictEqual(shown(handle), { progress: 62.5, message: "extract" });
+
+    assert.strictEqual(native.setTaskProgress(handle, download, 100), 100);
+    assert.deepStrictEqual(shown(handle), { progress: 100, message: "download" });
+
+    // Going back from done counts again
+    assert.strictEqual(native.setTaskProgress(handle, extract, 0), 75);
+    native.closeProgress(handle);
+  },
+
+  "zero-weight siblings"() {
+    const handle = show();
+    const cleanup = native.addTask(handle, 0, "cleanup", 0);
+    const copy = native.addTask(handle, 0, "copy", 1);
+
+    // Worth nothing next to a sibling with weight
+    assert.strictEqual(native.setTaskProgress(handle, cleanup, 100), 0);
+    assert.strictEqual(native.setTaskProgress(handle, copy, 50), 50);
+    assert.strictEqual(native.setTaskProgress(handle, cleanup, 0), 50);
+    assert.strictEqual(native.setTaskProgress(handle, copy, 100), 100);
+    assert.deepStrictEqual(shown(handle), { progress: 100, message: "copy" });
+    native.closeProgress(handle);
+  },
+
+  "only zero-weight subtasks"() {
+    const handle = show();
+    const first = native.addTask(handle, 0, "first", 0);
+    const second = native.addTask(handle, 0, "second", 0);
+
+    assert.strictEqual(native.setTaskProgress(handle, first, 100), 0);
+    assert.strictEqual(native.setTaskProgress(handle, second, 100), 100);
+    assert.deepStrictEqual(shown(handle), { progress: 100, message: "second" });
+    native.closeProgress(handle);
+  },
+
+  "nested tasks"() {
+    const handle = show();
+    const react = native.addTask(handle, 0, "react", 1);
+    const download = native.addTask(handle, react, "download", 1);
+    const build = native.addTask(handle, react, "build", 3);
+    const docs = native.addTask(handle, 0, "docs", 1);
+    const unnamed = native.addTask(handle, docs, "", 1);
+    const pages = native.addTask(handle, unnamed, "pages", 1);
+
+    assert.strictEqual(native.setTaskProgress(handle, download, 100), 12.5);
+    assert.deepStrictEqual(shown(handle), { progress: 12.5, message: `react${SEPARATOR}download` });
+
+    assert.strictEqual(native.setTaskProgress(handle, build, 100), 50);
+    assert.strictEqual(native.setTaskProgress(handle, pages, 50), 75);
+    // Unnamed tasks are left out of the path
+    assert.deepStrictEqual(shown(handle), { progress: 75, message: `docs${SEPARATOR}pages` });
+
+    assert.strictEqual(native.setTaskProgress(handle, pages, 100), 100);
+    native.closeProgress(handle);
+  },
+
+  "a task gets subtasks"() {
+    const handle = show();
+    const download = native.addTask(handle, 0, "download", 1);
+    native.addTask(handle, 0, "extract", 1);
+    assert.strictEqual(native.setTaskProgress(handle, download, 80), 40);
+
+    // Starts over from its subtasks
+    const part = native.addTask(handle, download, "part 1", 1);
+    native.addTask(handle, download, "part 2", 1);
+    assert.strictEqual(shown(handle).progress, 0);
+    assert.strictEqual(native.setTaskProgress(handle, part, 100), 25);
+    native.closeProgress(handle);
+  },
+
+  "setTaskProgress on a task with subtasks"() {
+    const handle = show();
+    const download = native.addTask(handle, 0, "download", 1);
+    const part = native.addTask(handle, download, "part", 1);
+    native.setTaskProgress(handle, part, 40);
+
+    assert.throws(() => native.setTaskProgress(handle, download, 100), {
+      message: "Only tasks without subtasks report progress",
+    });
+    assert.throws(() => native.setTaskProgress(handle, 0, 100), RangeError);
+    assert.throws(() => native.setTaskProgress(handle, 99, 100), RangeError);
+
+    // Nothing changed
+    assert.deepStrictEqual(shown(handle), { progress: 40, message: `download${SEPARATOR}part` });
+    native.closeProgress(handle);
+  },
+
+  "negative and non-finite weights"() {
+    const handle = show();
+    for (const weight of [Infinity, NaN, -1]) {
+      assert.throws(() => native.addTask(handle, 0, "a", weight), RangeError);
+    }
+
+    // None of them made it into the tree
+    const b = native.addTask(handle, 0, "b", 1);
+    assert.strictEqual(native.setTaskProgress(handle, b, 100), 100);
+    native.closeProgress(handle);
+  },
+};
+
+function main() {
+  if (!native.getBackends().includes("headless")) {
+    console.error("The task tests need the headless backend, which is only available on Linux.");
+    process.exit(1);
+  }
+  native.setBackend("headless");
+
+  let failed = 0;
+  for (const [name, run] of Object.entries(cases)) {
+    try {
+      run();
+    } catch (error) {
+      failed++;
+      console.error(`FAIL ${name}: ${error.message}`);
+    }
+  }
+  if (failed > 0) {
+    process.exit(1);
+  }
+  console.log(`${Object.keys(cases).length} cases ok`);
+}
+
+main();
@@ -0,0 +1,134 @@
+// Checks and measures the transfer rate and message in src/transfer_rate.h,
+// which progressBar.setBytes() uses. Plain C++, so it runs anywhere:
+//
+//   npm run bench:transfer
+//
+// Each case reports byte counts to a fresh TransferRate on a fixed clock,
+// starting from 0 bytes at second 0, then checks the message a format
+// expands to at `now` and the rate behind it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "transfer_rate.h"
+
+static TransferRate::Clock::time_point At(double seconds) {
+    return TransferRate::Clock::time_point(std::chrono::duration_cast<TransferRate::Clock::duration>(
+        std::chrono::duration<double>(seconds)));
+}
+
+struct Count {
+    double seconds;
+    uint64_t done;
+};
+
+struct Case {
+    const char* name;
+    std::vector<Count> counts;
+    double now;
+    uint64_t done;
+    uint64_t total;
+    const char* format;
+    const char* expected;
+    // BytesPerSecond() at `now`
+    double bytesPerSecond;
+};
+
+static bool Check(const Case& test) {
+    TransferRate rate;
+    rate.Reset(0, At(0));
+    for (const Count& count : test.counts) {
+        rate.Sample(count.done, At(count.seconds));
+    }
+
+    std::string message;
+    FormatTransferMessage(message, test.format, test.done, test.total, rate, At(test.now));
+    double bytesPerSecond = rate.BytesPerSecond(At(test.now));
+    if (message == test.expected && std::fabs(bytesPerSecond - test.bytesPerSecond) < 1e-3) {
+        return true;
+    }
+
+    fprintf(stderr, "FAIL %s:\n  \"%s\", %.3f B/s\n", test.name, message.c_str(), bytesPerSecond);
+    return false;
+}
+
+// How long expanding a typical format takes, which a bar pays on every
+// setBytes() that changes the count
+static double Measure() {
+    TransferRate rate;
+    rate.Reset(0, At(0));
+    rate.Sample(1500000, At(1));
+    const std::string format = "{done} of {total} at {rate}, {eta} left";
+
+    std::string message;
+    size_t rounds = 0;
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    while (elapsed < std::chrono::milliseconds(200)) {
+        for (int i = 0; i < 1000; i++) {
+            FormatTransferMessage(message, format, 1500000 + i, 40000000, rate, At(1.5));
+            sink += message.size();
+        }
+        rounds += 1000;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    if (sink == 0) {
+        abort();
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+int main() {
+    const char* all = "{done} of {total} at {rate}, {eta} left";
+    const std::vector<Case> cases = {
+        { "no count yet", {}, 1, 0, 10000, "{rate} {eta}", "0 B/s --:--", 0 },
+        { "first count sets the rate", { { 1, 1000 } }, 1, 1000, 10000, all,
+          "1.0 kB of 10.0 kB at 1.0 kB/s, 0:09 left", 1000 },
+
+        // 1000 + (1 - e^(-1/3)) * (3000 - 1000)
+        { "moving average", { { 1, 1000 }, { 2, 4000 } }, 2, 4000, 10000, all,
+          "4.0 kB of 10.0 kB at 1.6 kB/s, 0:04 left", 1566.937 },
+        // Over twice as long, the new rate weighs more: 1 - e^(-2/3)
+        { "moving average over time", { { 1, 1000 }, { 3, 7000 } }, 3, 7000, 10000, all,
+          "7.0 kB of 10.0 kB at 2.0 kB/s, 0:02 left", 1973.166 },
+        { "counts closer than 50 ms fold", { { 1, 1000 }, { 1.04, 2000 } }, 1.04, 2000, 10000, "{rate}",
+          "1.0 kB/s", 1000 },
+        { "going back starts over", { { 1, 1000 }, { 2, 500 } }, 2, 500, 10000, "{rate} {eta}",
+          "0 B/s --:--", 0 },
+
+        { "stalled within the grace", { { 1, 1000 } }, 2.5, 1000, 10000, "{rate} {eta}",
+          "1.0 kB/s 0:09", 1000 },
+        // Three seconds past the grace: 1000 * e^-1
+        { "stall decays the rate", { { 1, 1000 } }, 5.5, 1000, 10000, "{rate} {eta}", "368 B/s 0:24",
+          367.879 },
+        // 1000 * e^-7, under kMinBytesPerSecond
+        { "too slow for an eta", { { 1, 1000 } }, 23.5, 1000, 10000, "{rate} {eta}", "1 B/s --:--",
+          0.912 },
+        { "done needs no rate", {}, 1, 10000, 10000, "{percent} {eta}", "100% 0:00", 0 },
+        { "eta in hours", { { 1, 1000 } }, 1, 1000, 3846000, "{eta}", "1:04:05", 1000 },
+
+        { "units", {}, 1, 123456789, 1500000000000, "{done} of {total}", "123 MB of 1.5 TB", 0 },
+        { "unknown placeholders", {}, 1, 1000, 10000, "{done} {speed} {} {{percent}",
+          "1.0 kB {speed} {} {{percent}", 0 },
+        { "unclosed brace", {}, 1, 1000, 10000, "{percent} {eta", "10% {eta", 0 },
+        { "total of 0", { { 1, 1000 } }, 1, 1000, 0, "{done} of {total}, {percent}, {eta}",
+          "1.0 kB of ?, 0%, --:--", 1000 },
+        { "done past the total", { { 1, 12000 } }, 1, 12000, 10000, "{percent} {eta}", "100% --:--",
+          12000 },
+    };
+
+    bool ok = true;
+    for (const Case& test : cases) {
+        ok = Check(test) && ok;
+    }
+    if (!ok) {
+        return 1;
+    }
+    printf("%zu cases ok\n", cases.size());
+
+    printf("format %8.1f ns\n", Measure());
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Checks and measures the UTF-8 to UTF-16 conversion in src/utf16.h, which
+// the Windows backend uses for every title, message and label. Needs no
+// window system, so it runs anywhere:
+//
+//   npm run bench:utf16
+//
+// Every input is first checked against a plain code point by code point
+// conversion, then timed against it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "utf16.h"
+
+// What AssignUtf8AsUtf16() must produce, without the ASCII fast path
+static std::u16string Reference(const std::string& text) {
+    std::u16string out;
+    size_t i = 0;
+    while (i < text.size()) {
+        char32_t codePoint = DecodeUtf8(text.data(), text.size(), &i);
+        if (codePoint >= 0x10000) {
+            out.push_back(static_cast<char16_t>(0xd800 | ((codePoint - 0x10000) >> 10)));
+            out.push_back(static_cast<char16_t>(0xdc00 | ((codePoint - 0x10000) & 0x3ff)));
+        } else {
+            out.push_back(static_cast<char16_t>(codePoint));
+        }
+    }
+    return out;
+}
+
+struct Case {
+    const char* name;
+    std::string utf8;
+    // Empty if the reference is good enough
+    std::u16string expected;
+};
+
+static bool Check(const Case& test) {
+    std::u16string actual;
+    AssignUtf8AsUtf16(actual, test.utf8.data(), test.utf8.size());
+    std::u16string expected = test.expected.empty() ? Reference(test.utf8) : test.expected;
+    if (actual == expected) {
+        return true;
+    }
+
+    fprintf(stderr, "FAIL %s:", test.name);
+    for (char16_t unit : actual) {
+        fprintf(stderr, " %04x", static_cast<unsigned>(unit));
+    }
+    fprintf(stderr, "\n");
+    return false;
+}
+
+static double Measure(const std::string& text, bool fast) {
+    std::u16string out;
+    size_t rounds = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    size_t sink = 0;
+    while (elapsed < std::chrono::milliseconds(200)) {
+        for (int i = 0; i < 1000; i++) {
+            if (fast) {
+                AssignUtf8AsUtf16(out, text.data(), text.size());
+            } else {
+                out = Reference(text);
+            }
+            sink += out.size();
+        }
+        rounds += 1000;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    if (sink == 0 && !text.empty()) {
+        abort();
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+int main() {
+    std::string longAscii;
+    for (int i = 0; i < 20; i++) {
+        longAscii += "Downloading file_" + std::to_string(i) + ".zip ";
+    }
+
+    std::vector<Case> cases = {
+        { "empty", "", u"" },
+        { "ascii", "Copying 3 of 7 files", u"Copying 3 of 7 files" },
+        { "ascii 16", "0123456789abcdef", u"0123456789abcdef" },
+        { "ascii long", longAscii, {} },
+        { "latin", "K\xc3\xb6ln \xe2\x80\x93 Stra\xc3\x9f" "e.txt", u"Köln – Straße.txt" },
+        { "ascii then cjk", "0123456789abcdef\xe4\xb8\xad\xe6\x96\x87.docx", u"0123456789abcdef中文.docx" },
+        { "emoji", "done \xf0\x9f\x8e\x89", u"done \U0001f389" },
+        { "truncated", "abc\xe4\xb8", u"abc�" },
+        { "truncated emoji", "\xf0\x9f\x8e", u"�" },
+        { "interrupted", "\xe4\xb8" "x\xf0\x9f" "y", u"�x�y" },
+        { "lead after lead", "\xe4\xe4\xb8\xad", u"�中" },
+        { "stray continuation", "a\x80" "b", u"a�" "b" },
+        { "overlong", "\xc0\xaf", u"��" },
+        { "surrogate", "\xed\xa0\x80", u"���" },
+        { "beyond U+10FFFF", "\xf4\x90\x80\x80", u"����" },
+        { "invalid leads", "\xc1\xf5\xff", u"���" },
+        { "high byte in ascii block", "0123456789abcd\xc3\xa9" "f", u"0123456789abcdé" "f" },
+    };
+
+    // Every split of a mixed string, so non-ASCII lands on each offset of a
+    // 16-byte block
+    std::string mixed = longAscii + "\xc3\xa9\xf0\x9f\x8e\x89" + longAscii;
+    for (size_t i = 0; i <= mixed.size(); i++) {
+        cases.push_back({ "prefix", mixed.substr(0, i), {} });
+    }
+
+    bool ok = true;
+    for (const Case& test : cases) {
+        ok = Check(test) && ok;
+    }
+    if (!ok) {
+        return 1;
+    }
+    printf("%zu cases ok\n", cases.size());
+
+    std::string cjk;
+    for (int i = 0; i < 66; i++) {
+        cjk += "\xe4\xb8\xad";
+    }
+
+    const std::pair<const char*, std::string> inputs[] = {
+        { "short ascii", "Copying 3 of 7 files" },
+        { "long ascii", longAscii },
+        { "mixed", mixed },
+        { "cjk", cjk },
+    };
+    for (const auto& input : inputs) {
+        double fast = Measure(input.second, true);
+        double plain = Measure(input.second, false);
+        printf("%-12s %5zu bytes  %8.1f ns  (%.1fx the per-code-point loop)\n", input.first,
+               input.second.size(), fast, plain / fast);
+    }
+    return 0;
+}
@@ -1,12 +1,36 @@
 {
+  "variables": {
+    # Count the addon's heap allocations, for bench/. Enable with
+    # `node-gyp rebuild --alloc_stats=1`
+    "alloc_stats%": 0,
+    # Build with a sanitizer, for bench/soak.js. Enable with
+    # `node-gyp rebuild --sanitize=address` (or thread, or undefined)
+    "sanitize%": ""
+  },
   "targets": [
     {
       "target_name": "progress_bar",
       "conditions": [
+        ['alloc_stats==1', {
+          "sources": [ "src/progress_bar_alloc_stats.cpp" ],
+          # _GLIBCXX_ASSERTIONS stops libstdc++ from using its prebuilt
+          # std::string, whose allocations we would not see
+          "defines": [ "PROGRESS_BAR_ALLOC_STATS", "_GLIBCXX_ASSERTIONS" ],
+          "ldflags": [ "-Wl,-Bsymbolic-functions" ]
+        }],
+        ['sanitize!=""', {
+          "cflags_cc": [ "-fsanitize=<(sanitize)", "-fno-omit-frame-pointer", "-g" ],
+          "ldflags": [ "-fsanitize=<(sanitize)" ],
+          "xcode_settings": {
+            "OTHER_CFLAGS": [ "-fsanitize=<(sanitize)", "-fno-omit-frame-pointer", "-g" ],
+            "OTHER_LDFLAGS": [ "-fsanitize=<(sanitize)" ]
+          }
+        }],
         ['OS=="mac"', {
           "sources": [ 
             "src/progress_bar.cpp",
-            "src/progress_bar_macos.mm"
+            "src/progress_bar_macos.mm",
+            "src/shared_segment.cpp"
           ],
           "libraries": ["-framework Cocoa"],
           "xcode_settings": {
@@ -21,7 +45,8 @@
         ['OS=="win"', {
           "sources": [
             "src/progress_bar.cpp",
-            "src/progress_bar_windows.cpp"
+            "src/progress_bar_windows.cpp",
+            "src/shared_segment.cpp"
           ],
           "msvs_settings": {
             "VCCLCompilerTool": {
@@ -30,8 +55,21 @@
             }
           },
           "libraries": [
-            "Shcore.lib"
+            "Shcore.lib",
+            "Comctl32.lib"
           ]
+        }],
+        ['OS=="linux"', {
+          "sources": [
+            "src/progress_bar.cpp",
+            "src/progress_bar_linux.cpp",
+            "src/progress_bar_terminal.cpp",
+            "src/shared_segment.cpp"
+          ],
+          # shm_open() lives in librt on glibc before 2.34
+          "libraries": ["-lrt"],
+          "cflags_cc": ["-std=c++17"],
+          "cflags_cc!": ["-fno-exceptions", "-fno-rtti", "-std=gnu++17"]
         }]
       ]
     }
@@ -0,0 +1,129 @@
+#ifndef HANDLE_TABLE_H
+#define HANDLE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// Slab-allocated table of generational handles. Insert, lookup and remove
+// are O(1), and slots are recycled, so memory is bounded by the peak number
+// of live entries rather than by how many were ever inserted.
+//
+// A handle is a slot index in the low 32 bits and the slot's generation
+// above it. Removing an entry bumps the generation, so a stale handle never
+// resolves to whatever reuses its slot. Handles are never 0 and stay below
+// 2^53, so they survive a round trip through a JS number.
+//
+// Not thread-safe; callers bring their own lock.
+template <typename T>
+class HandleTable {
+public:
+    static const uint64_t kInvalidHandle = 0;
+
+    uint64_t Insert(T* value) {
+        uint32_t index;
+        if (freeHead_ != kNoSlot) {
+            index = freeHead_;
+            freeHead_ = At(index).nextFree;
+        } else {
+            if (used_ == chunks_.size() * kChunkSize) {
+                chunks_.emplace_back(new Slot[kChunkSize]);
+            }
+            index = used_++;
+        }
+
+        Slot& slot = At(index);
+        slot.value = value;
+        if (++size_ > peak_) {
+            peak_ = size_;
+        }
+        return MakeHandle(index, slot.generation);
+    }
+
+    T* Lookup(uint64_t handle) const {
+        const Slot* slot = Find(handle);
+        return slot ? slot->value : nullptr;
+    }
+
+    // Returns the value that was stored, or nullptr for a stale handle
+    T* Remove(uint64_t handle) {
+        Slot* slot = const_cast<Slot*>(Find(handle));
+        if (!slot) {
+            return nullptr;
+        }
+
+        T* value = slot->value;
+        slot->value = nullptr;
+        slot->generation = (slot->generation + 1) & kGenerationMask;
+        if (slot->generation == 0) {
+            slot->generation = 1;
+        }
+
+        uint32_t index = static_cast<uint32_t>(handle);
+        slot->nextFree = freeHead_;
+        freeHead_ = index;
+        size_--;
+        return value;
+    }
+
+    template <typename Fn>
+    void ForEach(Fn fn) const {
+        for (uint32_t index = 0; index < used_; index++) {
+            const Slot& slot = At(index);
+            if (slot.value) {
+                fn(MakeHandle(index, slot.generation), slot.value);
+            }
+        }
+    }
+
+    size_t Size() const { return size_; }
+    size_t Peak() const { return peak_; }
+    size_t Capacity() const { return chunks_.size() * kChunkSize; }
+
+private:
+    static const size_t kChunkSize = 1024;
+    static const uint32_t kNoSlot = UINT32_MAX;
+    // 21 bits of generation keep handles within 2^53
+    static const uint32_t kGenerationMask = (1u << 21) - 1;
+
+    struct Slot {
+        T* value = nullptr;
+        uint32_t generation = 1;
+        uint32_t nextFree = kNoSlot;
+    };
+
+    static uint64_t MakeHandle(uint32_t index, uint32_t generation) {
+        return (static_cast<uint64_t>(generation) << 32) | index;
+    }
+
+    Slot& At(uint32_t index) {
+        return chunks_[index / kChunkSize][index % kChunkSize];
+    }
+
+    const Slot& At(uint32_t index) const {
+        return chunks_[index / kChunkSize][index % kChunkSize];
+    }
+
+    const Slot* Find(uint64_t handle) const {
+        uint32_t index = static_cast<uint32_t>(handle);
+        uint32_t generation = static_cast<uint32_t>(handle >> 32);
+        if (index >= used_ || generation == 0) {
+            return nullptr;
+        }
+
+        const Slot& slot = At(index);
+        if (slot.generation != generation || !slot.value) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> chunks_;
+    uint32_t freeHead_ = kNoSlot;
+    uint32_t used_ = 0;
+    size_t size_ = 0;
+    size_t peak_ = 0;
+};
+
+#endif // HANDLE_TABLE_H
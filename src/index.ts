@@ -1,7 +1,19 @@
 import bindings from "bindings";
+import { SharedProgress, createSharedProgressBuffer } from "./shared-progress.js";
+
+export { SharedProgress, createSharedProgressBuffer } from "./shared-progress.js";
 
 const native = bindings("progress_bar");
-const activeProgressBars = new Set<ProgressBar>();
+const activeProgressBars = new Set<ProgressBar | ProgressGroup>();
+// Backends that can't draw a sparkline say so once per process
+let sparklineWarned = false;
+
+/**
+ * Opaque pointer to the native API table described in `src/progress_bar_api.h`.
+ * Pass it to your own native addon, together with a progress bar's `handle`,
+ * to update the progress bar from native threads.
+ */
+export const nativeApi: unknown = native.nativeApi;
 
 process.on("exit", () => {
   // Attempt to close any remaining progress bars
@@ -21,16 +33,244 @@ process.on("exit", () => {
 });
 
 type ProgressBarStyle = "default" | "hud" | "utility";
+export type ProgressBarEasing = "linear" | "ease-in" | "ease-out" | "ease-in-out";
+
+/**
+ * Everything a progress bar shown with the "headless" backend has recorded.
+ * Timestamps are milliseconds on the same clock as `process.hrtime()`.
+ */
+export interface HeadlessProgressBarState {
+  title: string;
+  message: string;
+  style: string;
+  progress: number;
+  indeterminate: boolean;
+  // The frame a 30 ms animation would be on, counted from when the bar last
+  // became indeterminate
+  animationFrame: number;
+  buttons: string[];
+  // Levels between 0 and 1 of the sparkline under the bar, oldest first
+  sparkline: number[];
+  updateCount: number;
+  messageUpdateCount: number;
+  buttonUpdateCount: number;
+  sparklineUpdateCount: number;
+  // Height a window would have, and how many controls it would have
+  // created, moved, relabeled or destroyed so far
+  contentHeight: number;
+  layoutOpCount: number;
+  shownAt: number;
+  lastUpdateAt: number;
+  // Only filled while `headless.recording` is enabled
+  history: Array<{
+    timestamp: number;
+    progress: number;
+    message?: string;
+    updateButtons: boolean;
+  }>;
+}
+
+/**
+ * The rows of a progress group shown with the "headless" backend, in display
+ * order. Like a native list, the headless group only draws rows that fit in
+ * its window: `renderedRowCount` counts how often one of the first
+ * `visibleRowCount` rows was drawn.
+ */
+export interface HeadlessProgressGroupState {
+  title: string;
+  style: string;
+  rows: Array<{ id: number; progress: number; message: string }>;
+  updateCount: number;
+  renderedRowCount: number;
+  visibleRowCount: number;
+}
+
+/**
+ * Helpers for progress bars shown with the "headless" backend, which keeps
+ * state in memory instead of showing a window. Only available on Linux.
+ */
+export const headless = {
+  getState(progressBar: ProgressBar): HeadlessProgressBarState | null {
+    if (!native.getHeadlessState || !progressBar.handle) {
+      return null;
+    }
+
+    return native.getHeadlessState(progressBar.handle);
+  },
+
+  getGroupState(progressGroup: ProgressGroup): HeadlessProgressGroupState | null {
+    if (!native.getHeadlessGroupState || !progressGroup.handle) {
+      return null;
+    }
+
+    return native.getHeadlessGroupState(progressGroup.handle);
+  },
+
+  /**
+   * Simulates a click on a button, as if the user had pressed it
+   */
+  clickButton(progressBar: ProgressBar, index: number): boolean {
+    if (!native.clickHeadlessButton || !progressBar.handle) {
+      return false;
+    }
+
+    return native.clickHeadlessButton(progressBar.handle, index);
+  },
+
+  /**
+   * Whether every update is appended to the state's `history`
+   */
+  set recording(value: boolean) {
+    native.setHeadlessRecording?.(value);
+  },
+
+  /**
+   * The width in pixels headless bars shown from now on pretend to have, so
+   * that updates which wouldn't move the fill are dropped like on a real
+   * display. 0, the default, applies every update.
+   */
+  set pixelWidth(value: number) {
+    native.setHeadlessPixelWidth?.(value);
+  },
+};
+
+export interface ProgressBarDiagnostics {
+  // Button click handlers currently kept alive
+  liveCallbackReferences: number;
+  // Every napi_ref the native side holds: click handlers and SharedArrayBuffers
+  liveReferences: number;
+  // Shared memory segments mapped by this process, see `sharedMemoryName`
+  liveSharedSegments: number;
+  // Native progress bar states that have not been freed yet, open or closed
+  liveContexts: number;
+  // Progress bars and groups that are open
+  openHandles: number;
+  peakOpenHandles: number;
+  // Slots in the native handle table, which grows with the peak
+  handleCapacity: number;
+  // Progress changes dropped because they wouldn't have moved the fill by a pixel
+  suppressedUpdates: number;
+  // Bytes the whole process got from malloc and hasn't freed, Node's included.
+  // Unlike RSS, it doesn't count freed memory the allocator holds on to. Only
+  // on Linux with glibc.
+  heapInUse?: number;
+}
+
+/**
+ * Runtime statistics of one progress bar or group, see `progressBar.stats`.
+ * Times are in milliseconds.
+ */
+export interface ProgressBarStats {
+  // Progress, message and button changes that reached the native side
+  updatesReceived: number;
+  // Changes replaced by a newer one before they made it to the window
+  updatesCoalesced: number;
+  // Progress changes dropped because they wouldn't have moved the fill by a pixel
+  updatesSuppressed: number;
+  // Bytes of strings copied into the native side
+  stringBytes: number;
+  // Calls to the native update functions, and the time spent in them
+  nativeCalls: number;
+  nativeTime: number;
+  // Updates handed to the platform's window
+  backendDispatches: number;
+  // From the oldest change in a frame until it was handed to the backend.
+  // Backends draw on their own schedule, so this doesn't include painting.
+  latency: ProgressBarLatency;
+}
+
+/**
+ * Totals across all progress bars and groups, see `ProgressBar.stats`
+ */
+export interface ProgressBarGlobalStats extends ProgressBarStats {
+  // Calls into the platform's window code. Lower than `backendDispatches`
+  // where many bars are updated in one call.
+  backendCalls: number;
+  // See `ProgressBar.prewarm()`. Missing if the backend has no pool.
+  windowPool?: ProgressBarWindowPoolStats;
+}
+
+export interface ProgressBarWindowPoolStats {
+  // Hidden windows ready to be shown, and how many the pool keeps ready
+  idle: number;
+  size: number;
+  // Shows that got a window from the pool, and shows that had to build one
+  // while the pool was in use
+  hits: number;
+  misses: number;
+  // Milliseconds it took to build the windows handed out by the pool, which
+  // their shows didn't have to spend
+  savedTime: number;
+}
+
+export interface ProgressBarLatency {
+  count: number;
+  mean: number;
+  max: number;
+  // Upper estimates, from the histogram
+  p50: number;
+  p90: number;
+  p99: number;
+  // Sample counts per bucket, and each bucket's exclusive upper limit. Limits
+  // double from one bucket to the next; the last one is Infinity.
+  buckets: number[];
+  bucketLimits: number[];
+}
+
+/**
+ * Where a transfer reported with `setBytes()` stands. Counts are numbers, so
+ * they lose precision beyond 2^53 bytes.
+ */
+export interface ProgressBarTransfer {
+  done: number;
+  // 0 if the size is unknown
+  total: number;
+  // Smoothed over the last few seconds, and decaying while no counts come in
+  bytesPerSecond: number;
+  // null until there is a rate to go by, or if the size is unknown
+  secondsRemaining: number | null;
+}
+
+/**
+ * A bar's progress over time, in at most 120 equally long buckets. Once the
+ * job outgrows them, neighbouring buckets are merged and `interval` doubles.
+ * The arrays share one buffer and have one entry per bucket.
+ */
+export interface ProgressBarHistory {
+  // Length of a bucket in seconds
+  interval: number;
+  // When each bucket starts, in seconds since the bar first showed progress
+  time: Float64Array;
+  // Progress at the end of each bucket, and the lowest and highest in it
+  progress: Float64Array;
+  minimum: Float64Array;
+  maximum: Float64Array;
+  // Percent per second
+  rate: Float64Array;
+}
 
 export interface ProgressBarUpdateArguments {
   progress?: number;
   message?: string;
   buttons?: ProgressBarButtonArguments[];
 }
+export interface ProgressBarBatchUpdate {
+  progressBar: ProgressBar;
+  progress?: number;
+  message?: string;
+}
+
 export interface ProgressBarArguments extends ProgressBarUpdateArguments {
   title?: string;
   style?: ProgressBarStyle;
   onClose?: (progressBar: ProgressBar) => void;
+  // Starts the bar in byte mode with this total, see setBytes()
+  total?: number | bigint;
+  messageFormat?: string;
+  // Starts the bar animating instead of showing progress, see `indeterminate`
+  indeterminate?: boolean;
+  // Shows how fast the bar moves under it, see `sparkline`
+  sparkline?: boolean;
 }
 
 export interface ProgressBarButtonArguments {
@@ -44,7 +284,12 @@ export interface InternalProgressBarButtonArguments {
   source: ProgressBarButtonArguments;
 }
 
-const DEFAULT_ARGUMENTS: Required<ProgressBarArguments> = {
+// Fields of a native.updateProgress() call, mirrored in src/progress_bar.cpp
+const UPDATE_PROGRESS = 1 << 0;
+const UPDATE_MESSAGE = 1 << 1;
+const UPDATE_BUTTONS = 1 << 2;
+
+const DEFAULT_ARGUMENTS: Required<Omit<ProgressBarArguments, "total" | "messageFormat" | "indeterminate" | "sparkline">> = {
   title: "Progress",
   message: "",
   style: "default",
@@ -54,9 +299,174 @@ const DEFAULT_ARGUMENTS: Required<ProgressBarArguments> = {
 };
 
 export class ProgressBar {
+  /**
+   * The maximum number of times per second updates are applied to the native
+   * progress bars. Updates arriving in between are coalesced, so only the
+   * latest state is shown. Set to 0 to apply updates as soon as possible.
+   */
+  public static get maxFrameRate(): number {
+    return native.getMaxFrameRate();
+  }
+  public static set maxFrameRate(value: number) {
+    if (!Number.isFinite(value) || value < 0) {
+      throw new Error("Frame rate must be a positive number or 0");
+    }
+
+    native.setMaxFrameRate(value);
+  }
+
+  /**
+   * The native backend new progress bars are shown with. Bars that are
+   * already open keep their backend. Defaults to the platform's native
+   * windows, or the `NATIVE_PROGRESS_BAR_BACKEND` environment variable.
+   */
+  public static get backend(): string {
+    return native.getBackend();
+  }
+  public static set backend(value: string) {
+    native.setBackend(value);
+  }
+
+  /**
+   * The backends available on this platform
+   */
+  public static get backends(): string[] {
+    return native.getBackends();
+  }
+
+  /**
+   * Counters for resources held by the native side, useful for spotting
+   * leaks. Counts are across all progress bars and groups.
+   */
+  public static get diagnostics(): ProgressBarDiagnostics {
+    return native.getDiagnostics();
+  }
+
+  /**
+   * What the native side has done so far, summed up across all progress bars
+   * and groups. Cheap enough to leave on in production.
+   */
+  public static get stats(): ProgressBarGlobalStats {
+    return native.getStats();
+  }
+
+  /**
+   * Records what the native side spends its time on: the native calls,
+   * string conversion, frames, calls into the platform's window code and
+   * button clicks, per thread. Off by default. Turning it on drops whatever
+   * was recorded before.
+   */
+  public static get tracing(): boolean {
+    return native.getTracing();
+  }
+  public static set tracing(value: boolean) {
+    native.setTracing(value);
+  }
+
+  /**
+   * What has been recorded since `tracing` was turned on, as Chrome
+   * trace_event JSON. Save it to a file and load it into chrome://tracing
+   * or https://ui.perfetto.dev. Only the most recent events of each thread
+   * are kept.
+   */
+  public static getTrace(): string {
+    return native.getTrace();
+  }
+
+  /**
+   * Applies all pending updates right away, instead of on the next frame
+   */
+  public static flush() {
+    native.flush();
+  }
+
+  /**
+   * Builds `count` windows of the given style ahead of time and keeps them
+   * hidden, so that the next progress bars appear right away instead of
+   * after their window is built. Closed bars give their window back while
+   * the pool has room. Call with 0 to free the pool. See
+   * `ProgressBar.stats.windowPool` for how well it does.
+   */
+  public static prewarm(count: number, style: ProgressBarStyle = "default") {
+    native.prewarm(count, style);
+  }
+
+  /**
+   * Like `new ProgressBar()`, but resolves once the window is actually on
+   * screen. The constructor only queues the window for the UI thread.
+   */
+  public static async show(args: ProgressBarArguments = DEFAULT_ARGUMENTS): Promise<ProgressBar> {
+    const progressBar = new ProgressBar(args);
+    if (!(await native.syncProgressBar(progressBar.handle))) {
+      progressBar.close();
+      throw new Error("Failed to show progress bar");
+    }
+
+    return progressBar;
+  }
+
+  /**
+   * Updates many progress bars with a single call into the native side,
+   * which is much cheaper than setting `progress` on each of them when
+   * hundreds of bars are open. Like the setters, only changed values are
+   * sent.
+   */
+  public static updateMany(updates: ProgressBarBatchUpdate[]) {
+    // Checked before any bar is touched, so a bad entry leaves all of them
+    // as they were
+    for (const update of updates) {
+      if (update.progress !== undefined && (update.progress < 0 || update.progress > 100)) {
+        throw new Error("Progress must be between 0 and 100");
+      }
+    }
+
+    if (ProgressBar._batch.length < updates.length * 2) {
+      ProgressBar._batch = new Float64Array(updates.length * 2);
+    }
+
+    const batch = ProgressBar._batch;
+    const messages: Array<number | string> = [];
+    let pairs = 0;
+
+    for (const update of updates) {
+      const progressBar = update.progressBar;
+      if (!progressBar.validateHandle()) {
+        continue;
+      }
+
+      // NaN leaves the progress as it is
+      let progress = NaN;
+      if (update.progress !== undefined && update.progress !== progressBar._progress) {
+        progressBar._progress = update.progress;
+        progress = update.progress;
+      }
+
+      const messageChanged = update.message !== undefined && update.message !== progressBar._message;
+      if (messageChanged) {
+        progressBar._message = update.message!;
+        messages.push(pairs, update.message!);
+      } else if (Number.isNaN(progress)) {
+        continue;
+      }
+
+      batch[pairs * 2] = progressBar.id;
+      batch[pairs * 2 + 1] = progress;
+      pairs++;
+    }
+
+    if (pairs > 0) {
+      native.updateMany(batch.subarray(0, pairs * 2), messages);
+    }
+  }
+  private static _batch = new Float64Array(0);
+
   public readonly title: string;
   public readonly style: string;
   public handle: number | null = null;
+  /**
+   * Identifies the progress bar in batched native updates
+   */
+  public readonly id: number;
   public isClosed: boolean = false;
   public onClose?: (progressBar: ProgressBar) => void;
 
@@ -76,7 +486,10 @@ export class ProgressBar {
     }
 
     this._progress = value;
-    this.update();
+
+    if (this.validateHandle()) {
+      native.setProgress(this.handle, value);
+    }
   }
   private _progress: number = 0;
 
@@ -92,7 +505,10 @@ export class ProgressBar {
     }
 
     this._message = value;
-    this.update();
+
+    if (this.validateHandle()) {
+      native.setMessage(this.handle, value);
+    }
   }
   private _message: string = "";
 
@@ -113,6 +529,148 @@ export class ProgressBar {
   private _buttons: ProgressBarButtonArguments[] = [];
   private _internalButtons: InternalProgressBarButtonArguments[] = [];
 
+  /**
+   * A SharedArrayBuffer that worker threads can write progress into with
+   * `SharedProgress`, without posting a message to this thread for every
+   * tick. The native side samples it once per frame. Created on first access.
+   */
+  public get sharedProgress(): SharedArrayBuffer {
+    if (!this._sharedProgress) {
+      this._sharedProgress = new SharedProgress(createSharedProgressBuffer());
+
+      if (this.validateHandle()) {
+        native.attachSharedProgress(this.handle, this._sharedProgress.array);
+      }
+    }
+
+    return this._sharedProgress.array.buffer as SharedArrayBuffer;
+  }
+  private _sharedProgress?: SharedProgress;
+
+  /**
+   * The name of a shared memory segment that another process can write this
+   * bar's progress and message into with `RemoteProgress.open()`, without a
+   * message to this process for every tick. The native side samples it once
+   * per frame. Created on first access; null once the bar is closed.
+   */
+  public get sharedMemoryName(): string | null {
+    if (!this.validateHandle()) {
+      return null;
+    }
+
+    return native.createSharedSegment(this.handle);
+  }
+
+  /**
+   * A message built natively from the byte counts each time they change,
+   * instead of setting `message` on every tick. Supports `{done}`,
+   * `{total}`, `{percent}`, `{rate}` and `{eta}`, as in
+   * "{done} of {total} ({rate}, {eta} left)". Set to null to show `message`
+   * again.
+   */
+  public get messageFormat(): string | null {
+    return this._messageFormat;
+  }
+  public set messageFormat(value: string | null) {
+    if (value === this._messageFormat) {
+      return;
+    }
+
+    this._messageFormat = value;
+
+    if (this.validateHandle()) {
+      native.setMessageFormat(this.handle, value);
+    }
+  }
+  private _messageFormat: string | null = null;
+
+  /**
+   * Whether the bar shows an animation for work of unknown length instead of
+   * its progress. The animation runs natively, without any timers in JS.
+   * Progress set in the meantime is shown once this is turned off again.
+   */
+  public get indeterminate(): boolean {
+    return this._indeterminate;
+  }
+  public set indeterminate(value: boolean) {
+    if (value === this._indeterminate) {
+      return;
+    }
+
+    this._indeterminate = value;
+
+    if (this.validateHandle()) {
+      native.setIndeterminate(this.handle, value);
+    }
+  }
+  private _indeterminate: boolean = false;
+
+  /**
+   * Whether a sparkline of how fast the bar moved is drawn under it, natively
+   * from `history`. Only the "terminal" and "headless" backends draw one; the
+   * macOS and Windows windows have no room for it yet. Turning it on there
+   * emits a process warning, once, and leaves the bar as it is.
+   */
+  public get sparkline(): boolean {
+    return this._sparkline;
+  }
+  public set sparkline(value: boolean) {
+    if (value === this._sparkline) {
+      return;
+    }
+
+    this._sparkline = value;
+
+    if (this.validateHandle() && !native.setSparkline(this.handle, value) && value && !sparklineWarned) {
+      sparklineWarned = true;
+      process.emitWarning(
+        "This progress bar's backend doesn't draw sparklines; progressBar.history still works",
+        "ProgressBarWarning",
+      );
+    }
+  }
+  private _sparkline: boolean = false;
+
+  /**
+   * The bar's progress over time, up to now, or null once it is closed. Its
+   * size is fixed however long the job runs.
+   */
+  public get history(): ProgressBarHistory | null {
+    if (!this.validateHandle()) {
+      return null;
+    }
+
+    return native.getProgressHistory(this.handle);
+  }
+
+  /**
+   * Throughput and remaining time of the transfer reported with
+   * `setBytes()`, or null if the bar isn't in byte mode
+   */
+  public get transfer(): ProgressBarTransfer | null {
+    if (!this.validateHandle()) {
+      return null;
+    }
+
+    const transfer = native.getTransferStats(this.handle);
+    if (transfer && transfer.secondsRemaining < 0) {
+      transfer.secondsRemaining = null;
+    }
+    return transfer;
+  }
+
+  /**
+   * What the native side has done for this bar so far, or null once it is
+   * closed. See `ProgressBar.stats` for the totals.
+   */
+  public get stats(): ProgressBarStats | null {
+    if (!this.validateHandle()) {
+      return null;
+    }
+
+    return native.getStats(this.handle);
+  }
+
   constructor(args: ProgressBarArguments = DEFAULT_ARGUMENTS) {
     const title = args.title || DEFAULT_ARGUMENTS.title;
     const style = args.style || DEFAULT_ARGUMENTS.style;
@@ -126,31 +684,145 @@ export class ProgressBar {
       style,
       this.getButtons(this._buttons),
     );
+    this.id = native.getProgressBarId(this.handle);
+
+    if (args.total !== undefined) {
+      this.setBytes(0, args.total);
+    }
+    if (args.messageFormat !== undefined) {
+      this.messageFormat = args.messageFormat;
+    }
+    if (args.indeterminate) {
+      this.indeterminate = true;
+    }
+    if (args.sparkline) {
+      this.sparkline = true;
+    }
 
     // Prevent general GC from closing the progress bar
     activeProgressBars.add(this);
   }
 
+  /**
+   * Updates several properties at once. Only properties that changed are
+   * sent to the native side. Without arguments, the current progress and
+   * message are sent again.
+   */
   public update(args?: ProgressBarUpdateArguments) {
     if (!this.validateHandle()) {
       return;
     }
 
-    this._progress = args?.progress || this._progress;
-    this._message = args?.message || this._message;
+    let fields = args ? 0 : UPDATE_PROGRESS | UPDATE_MESSAGE;
+
+    if (args?.progress !== undefined && args.progress !== this._progress) {
+      this._progress = args.progress;
+      fields |= UPDATE_PROGRESS;
+    }
+
+    if (args?.message !== undefined && args.message !== this._message) {
+      this._message = args.message;
+      fields |= UPDATE_MESSAGE;
+    }
 
     const shouldUpdateButtons = this.getButtonsUpdateNecessary(args?.buttons);
-    const buttons = shouldUpdateButtons ? this.getButtons(args?.buttons) : [];
+    if (shouldUpdateButtons) {
+      fields |= UPDATE_BUTTONS;
+    }
+
+    if (fields === 0) {
+      return;
+    }
 
     native.updateProgress(
       this.handle,
+      fields,
       this._progress,
       this._message,
-      shouldUpdateButtons,
-      buttons,
+      shouldUpdateButtons ? this.getButtons(args?.buttons) : undefined,
     );
   }
 
+  /**
+   * Switches the progress bar to byte counts. Progress, throughput and the
+   * remaining time are then derived natively, so a transfer only needs to
+   * report how far along it is, as often as it likes. Pass BigInts for
+   * transfers beyond 2^53 bytes. A total of 0 means the size is unknown; if
+   * the total is left out, the previous one is kept.
+   */
+  public setBytes(done: number | bigint, total: number | bigint = this._bytesTotal) {
+    if (!this.validateHandle()) {
+      return;
+    }
+
+    if (done < 0 || total < 0) {
+      throw new Error("Byte counts can't be negative");
+    }
+
+    this._bytesTotal = total;
+    this._progress = total > 0 ? Math.min(100, (Number(done) * 100) / Number(total)) : 0;
+    native.setBytes(this.handle, done, total);
+  }
+  private _bytesTotal: number | bigint = 0;
+
+  /**
+   * Moves the progress to `progress` over `durationMs`, animated natively at
+   * the frame rate. One call replaces the many small updates it would take
+   * to get the same motion from JS, and keeps the bar moving while the JS
+   * thread is busy. Progress set while the animation runs becomes its new
+   * target, reached by the time the animation would have ended.
+   */
+  public animateTo(progress: number, durationMs: number, easing: ProgressBarEasing = "linear") {
+    if (!(progress >= 0 && progress <= 100)) {
+      throw new Error("Progress must be between 0 and 100");
+    }
+    if (!(durationMs >= 0 && Number.isFinite(durationMs))) {
+      throw new Error("Duration must be a finite number of milliseconds, 0 or more");
+    }
+
+    if (!this.validateHandle()) {
+      return;
+    }
+
+    this._progress = progress;
+    native.animateTo(this.handle, progress, durationMs, easing);
+  }
+
+  /**
+   * Adds a step to the bar's work, or to `parent`'s. Once a bar has tasks,
+   * its progress is their weighted average, kept natively, and its message
+   * the names of the task that reported last, as in "react › download".
+   * Steps can have steps of their own; only steps without any report
+   * progress.
+   */
+  public addTask(args: ProgressTaskArguments = {}, parent?: ProgressTask): ProgressTask {
+    if (!this.validateHandle()) {
+      return new ProgressTask(this, 0);
+    }
+
+    const weight = args.weight ?? 1;
+    if (!(weight >= 0 && Number.isFinite(weight))) {
+      throw new Error("Task weights must be finite and not negative");
+    }
+
+    const id = native.addTask(this.handle, parent?.id ?? 0, args.name ?? "", weight);
+    return new ProgressTask(this, id);
+  }
+
+  /**
+   * Sets the progress of a task without subtasks, between 0 and 100. Costs
+   * one step per level of the task tree, however large it is.
+   */
+  public setTaskProgress(task: ProgressTask, progress: number) {
+    validateProgress(progress);
+
+    if (!this.validateHandle() || task.bar !== this) {
+      return;
+    }
+
+    this._progress = native.setTaskProgress(this.handle, task.id, progress);
+  }
+
   public close() {
     if (!this.isClosed && this.handle) {
       native.closeProgress(this.handle);
@@ -163,6 +835,18 @@ export class ProgressBar {
     }
   }
 
+  /**
+   * Like `close()`, but resolves once the window is gone
+   */
+  public async closeAsync(): Promise<void> {
+    const handle = this.handle;
+    this.close();
+
+    if (handle) {
+      await native.syncProgressBar(handle);
+    }
+  }
+
   private validateHandle() {
     if (this.isClosed || !this.handle) {
       return false;
@@ -215,3 +899,357 @@ export class ProgressBar {
     return false;
   }
 }
+
+export interface ProgressTaskArguments {
+  // Shown in the bar's message while the task is current
+  name?: string;
+  // The task's share of its parent, relative to its siblings. Defaults to 1.
+  weight?: number;
+}
+
+/**
+ * A step of a progress bar's work, see `progressBar.addTask()`. Only holds
+ * an id: the task tree itself is native, so even very large ones cost the
+ * JS heap nothing.
+ */
+export class ProgressTask {
+  public readonly bar: ProgressBar;
+  public readonly id: number;
+
+  constructor(bar: ProgressBar, id: number) {
+    this.bar = bar;
+    this.id = id;
+  }
+
+  public addTask(args: ProgressTaskArguments = {}): ProgressTask {
+    return this.bar.addTask(args, this);
+  }
+
+  public setProgress(progress: number) {
+    this.bar.setTaskProgress(this, progress);
+  }
+
+  public complete() {
+    this.bar.setTaskProgress(this, 100);
+  }
+}
+
+export interface RemoteProgressUpdate {
+  progress?: number;
+  message?: string;
+}
+
+/**
+ * Writes progress and message into a progress bar shown by another process,
+ * named by that bar's `sharedMemoryName`. Writes never block on the bar's
+ * process; the bar shows the latest of them on its next frame. Messages
+ * longer than 1024 bytes of UTF-8 are cut short.
+ *
+ * @example
+ * ```
+ * // In the child process
+ * const remote = RemoteProgress.open(process.env.PROGRESS_NAME);
+ * remote.update({ progress: 50, message: "Halfway there" });
+ * remote.close();
+ * ```
+ */
+export class RemoteProgress {
+  /**
+   * Returns null if no open progress bar goes by `name`
+   */
+  public static open(name: string): RemoteProgress | null {
+    const segment = native.openSharedSegment(name);
+    return segment ? new RemoteProgress(segment) : null;
+  }
+
+  private segment: unknown;
+  private _progress = 0;
+  private _message = "";
+
+  private constructor(segment: unknown) {
+    this.segment = segment;
+  }
+
+  public get progress() {
+    return this._progress;
+  }
+
+  public set progress(value: number) {
+    this.update({ progress: value });
+  }
+
+  public get message() {
+    return this._message;
+  }
+
+  public set message(value: string) {
+    this.update({ message: value });
+  }
+
+  /**
+   * Writes progress and message together, so the bar never shows one
+   * without the other
+   */
+  public update({ progress, message }: RemoteProgressUpdate) {
+    if (progress !== undefined) {
+      validateProgress(progress);
+      this._progress = progress;
+    }
+
+    if (message !== undefined) {
+      this._message = message;
+    }
+
+    if (this.segment) {
+      native.writeSharedSegment(this.segment, progress, message);
+    }
+  }
+
+  /**
+   * Stops writing. The bar keeps showing what was written last.
+   */
+  public close() {
+    if (this.segment) {
+      native.closeSharedSegment(this.segment);
+      this.segment = null;
+    }
+  }
+}
+
+export interface ProgressGroupArguments {
+  title?: string;
+  style?: ProgressBarStyle;
+  onClose?: (progressGroup: ProgressGroup) => void;
+}
+
+export interface ProgressGroupRowArguments {
+  /**
+   * A positive integer that identifies the row within its group. Picked
+   * automatically if not given.
+   */
+  id?: number;
+  progress?: number;
+  message?: string;
+}
+
+/**
+ * One row of a `ProgressGroup`
+ */
+export class ProgressGroupRow {
+  public readonly id: number;
+  public readonly group: ProgressGroup;
+
+  /**
+   * The progress of the row, between 0 and 100
+   */
+  public get progress() {
+    return this._progress;
+  }
+  public set progress(value: number) {
+    this.update({ progress: value });
+  }
+  private _progress: number;
+
+  /**
+   * The message shown in the row
+   */
+  public get message() {
+    return this._message;
+  }
+  public set message(value: string) {
+    this.update({ message: value });
+  }
+  private _message: string;
+
+  /**
+   * Whether the row has been removed from its group, or the group is closed
+   */
+  public get isRemoved() {
+    return this.group.isClosed || this.group.getRow(this.id) !== this;
+  }
+
+  constructor(group: ProgressGroup, id: number, progress: number, message: string) {
+    this.group = group;
+    this.id = id;
+    this._progress = progress;
+    this._message = message;
+  }
+
+  /**
+   * Updates several properties at once. Only properties that changed are
+   * sent to the native side.
+   */
+  public update(args: Omit<ProgressGroupRowArguments, "id">) {
+    if (this.isRemoved) {
+      return;
+    }
+
+    let fields = 0;
+
+    if (args.progress !== undefined && args.progress !== this._progress) {
+      validateProgress(args.progress);
+      this._progress = args.progress;
+      fields |= UPDATE_PROGRESS;
+    }
+
+    if (args.message !== undefined && args.message !== this._message) {
+      this._message = args.message;
+      fields |= UPDATE_MESSAGE;
+    }
+
+    if (fields === 0) {
+      return;
+    }
+
+    native.updateProgressGroupRow(
+      this.group.handle,
+      this.id,
+      fields,
+      this._progress,
+      this._message,
+    );
+  }
+
+  public remove() {
+    this.group.removeRow(this.id);
+  }
+}
+
+/**
+ * A single window that hosts a list of progress rows, for many parallel
+ * tasks. Rows can be added, updated and removed at any time; changes are
+ * applied once per frame, and only rows that are scrolled into view are
+ * drawn.
+ */
+export class ProgressGroup {
+  public readonly title: string;
+  public readonly style: string;
+  public handle: number | null = null;
+  public isClosed: boolean = false;
+  public onClose?: (progressGroup: ProgressGroup) => void;
+
+  private _rows = new Map<number, ProgressGroupRow>();
+  private _nextId = 1;
+
+  /**
+   * The rows of the group, in the order they were added
+   */
+  public get rows(): ProgressGroupRow[] {
+    return Array.from(this._rows.values());
+  }
+
+  /**
+   * What the native side has done for this group so far, or null once it is
+   * closed
+   */
+  public get stats(): ProgressBarStats | null {
+    if (this.isClosed || !this.handle) {
+      return null;
+    }
+
+    return native.getStats(this.handle);
+  }
+
+  constructor(args: ProgressGroupArguments = {}) {
+    this.title = args.title || DEFAULT_ARGUMENTS.title;
+    this.style = args.style || DEFAULT_ARGUMENTS.style;
+    this.onClose = args.onClose;
+
+    this.handle = native.showProgressGroup(this.title, this.style);
+
+    // Prevent general GC from closing the window
+    activeProgressBars.add(this);
+  }
+
+  /**
+   * Like `new ProgressGroup()`, but resolves once the window is actually on
+   * screen
+   */
+  public static async show(args: ProgressGroupArguments = {}): Promise<ProgressGroup> {
+    const progressGroup = new ProgressGroup(args);
+    if (!(await native.syncProgressBar(progressGroup.handle))) {
+      progressGroup.close();
+      throw new Error("Failed to show progress group");
+    }
+
+    return progressGroup;
+  }
+
+  /**
+   * Adds a row at the bottom of the group
+   */
+  public addRow(args: ProgressGroupRowArguments = {}): ProgressGroupRow {
+    if (this.isClosed || !this.handle) {
+      throw new Error("Progress group is closed");
+    }
+
+    const id = args.id ?? this._nextId;
+    if (!Number.isInteger(id) || id < 1 || id > 0xffffffff) {
+      throw new Error("Row id must be a positive 32-bit integer");
+    }
+    if (this._rows.has(id)) {
+      throw new Error(`A row with id ${id} already exists`);
+    }
+    this._nextId = Math.max(this._nextId, id + 1);
+
+    const progress = args.progress ?? 0;
+    const message = args.message ?? "";
+    validateProgress(progress);
+
+    const row = new ProgressGroupRow(this, id, progress, message);
+    this._rows.set(id, row);
+    native.addProgressGroupRow(this.handle, id, progress, message);
+
+    return row;
+  }
+
+  public getRow(id: number): ProgressGroupRow | undefined {
+    return this._rows.get(id);
+  }
+
+  public updateRow(id: number, args: Omit<ProgressGroupRowArguments, "id">) {
+    this._rows.get(id)?.update(args);
+  }
+
+  public removeRow(id: number) {
+    if (!this._rows.has(id)) {
+      return;
+    }
+
+    this._rows.delete(id);
+
+    if (!this.isClosed && this.handle) {
+      native.removeProgressGroupRow(this.handle, id);
+    }
+  }
+
+  public close() {
+    if (!this.isClosed && this.handle) {
+      native.closeProgress(this.handle);
+      this.isClosed = true;
+      this.handle = null;
+      this.onClose?.(this);
+
+      // Allow general GC to close the window
+      activeProgressBars.delete(this);
+    }
+  }
+
+  /**
+   * Like `close()`, but resolves once the window is gone
+   */
+  public async closeAsync(): Promise<void> {
+    const handle = this.handle;
+    this.close();
+
+    if (handle) {
+      await native.syncProgressBar(handle);
+    }
+  }
+}
+
+function validateProgress(value: number) {
+  if (!(value >= 0 && value <= 100)) {
+    throw new Error("Progress must be between 0 and 100");
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef PROGRESS_ANIMATION_H
+#define PROGRESS_ANIMATION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Easing curves for animateTo(), named after their CSS counterparts
+enum class ProgressEasing {
+    kLinear,
+    kEaseIn,
+    kEaseOut,
+    kEaseInOut,
+};
+
+// Returns false if the name is unknown
+inline bool ParseProgressEasing(const char* name, ProgressEasing* easing) {
+    if (strcmp(name, "linear") == 0) {
+        *easing = ProgressEasing::kLinear;
+    } else if (strcmp(name, "ease-in") == 0) {
+        *easing = ProgressEasing::kEaseIn;
+    } else if (strcmp(name, "ease-out") == 0) {
+        *easing = ProgressEasing::kEaseOut;
+    } else if (strcmp(name, "ease-in-out") == 0) {
+        *easing = ProgressEasing::kEaseInOut;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Maps the share of the time that has passed to the share of the distance
+// covered, both between 0 and 1. Cubic, so motion starts and ends softly.
+inline double ApplyEasing(ProgressEasing easing, double t) {
+    switch (easing) {
+        case ProgressEasing::kEaseIn:
+            return t * t * t;
+        case ProgressEasing::kEaseOut: {
+            double rest = 1 - t;
+            return 1 - rest * rest * rest;
+        }
+        case ProgressEasing::kEaseInOut: {
+            if (t < 0.5) {
+                return 4 * t * t * t;
+            }
+            double rest = 2 - 2 * t;
+            return 1 - rest * rest * rest / 2;
+        }
+        case ProgressEasing::kLinear:
+        default:
+            return t;
+    }
+}
+
+// Progress moving toward a target over a fixed time. The frame flush samples
+// it once per frame, so it moves at the display rate however rarely the
+// caller says anything.
+class ProgressAnimation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Start(double from, double to, Clock::duration duration, ProgressEasing easing,
+               Clock::time_point now) {
+        from_ = from;
+        to_ = to;
+        start_ = now;
+        end_ = now + duration;
+        easing_ = easing;
+        active_ = true;
+    }
+
+    // Heads for a new target from wherever the animation is now, arriving
+    // when it would have arrived at the old one
+    void Retarget(double to, Clock::time_point now) {
+        from_ = ValueAt(now);
+        to_ = to;
+        start_ = now;
+        end_ = std::max(end_, now);
+    }
+
+    void Stop() {
+        active_ = false;
+    }
+
+    bool Active() const {
+        return active_;
+    }
+
+    bool FinishedAt(Clock::time_point now) const {
+        return now >= end_;
+    }
+
+    double ValueAt(Clock::time_point now) const {
+        if (now >= end_) {
+            return to_;
+        }
+        if (now <= start_) {
+            return from_;
+        }
+
+        double t = std::chrono::duration<double>(now - start_).count() /
+                   std::chrono::duration<double>(end_ - start_).count();
+        return from_ + (to_ - from_) * ApplyEasing(easing_, t);
+    }
+
+private:
+    double from_ = 0;
+    double to_ = 0;
+    Clock::time_point start_;
+    Clock::time_point end_;
+    ProgressEasing easing_ = ProgressEasing::kLinear;
+    bool active_ = false;
+};
+
+#endif // PROGRESS_ANIMATION_H
@@ -1,9 +1,20 @@
-#define NAPI_VERSION 3
+#define NAPI_VERSION 6
 #include <node_api.h>
+#include <uv.h>
 #include <vector>
+#include <string>
 #include <mutex>
 #include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdlib>
 #include <cstring>
+#include <cmath>
 
 #define NAPI_CALL(env, call)                                                   \
   do {                                                                         \
@@ -23,298 +34,3917 @@
     }                                                                          \
   } while (0)
 
+#include "handle_table.h"
+#include "progress_animation.h"
+#include "progress_bar_api.h"
+#include "progress_bar_update.h"
+#include "progress_group.h"
+#include "progress_history.h"
+#include "progress_stats.h"
+#include "shared_segment.h"
+#include "task_tree.h"
+#include "trace_events.h"
+#include "transfer_rate.h"
+#include "window_pool.h"
+
+#ifdef PROGRESS_BAR_ALLOC_STATS
+#include "progress_bar_alloc_stats.h"
+#endif
+
 #ifdef __APPLE__
 #include "progress_bar_macos.h"
 #elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
 #include "progress_bar_windows.h"
+#elif defined(__linux__)
+#include "progress_bar_linux.h"
+#include "progress_bar_terminal.h"
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define PROGRESS_BAR_HAS_MALLINFO2
+#endif
+
+// The native implementation behind a progress bar. A platform may offer more
+// than one; each bar keeps the backend it was shown with. Button clicks are
+// reported with the `userData` the bar was shown with.
+struct ProgressBarBackend {
+    const char* name;
+    void* (*show)(const char* title, const char* message, const char* style,
+                  const char** buttonLabels, size_t buttonCount,
+                  void (*callback)(void* userData, int buttonIndex), void* userData);
+    void (*update)(void* handle, double progress, const char* message, bool updateButtons,
+                   const char** buttonLabels, size_t buttonCount,
+                   void (*callback)(void* userData, int buttonIndex));
+    // Optional. Applies the updates of every bar in a frame at once.
+    void (*updateBatch)(const ProgressBarUpdate* updates, size_t count);
+    void (*close)(void* handle);
+    // Optional. Width of the bar's fill in device pixels, DPI scaling
+    // included, or 0 if unknown. Progress changes that don't move the fill
+    // by a pixel are dropped.
+    double (*getPixelWidth)(void* handle);
+    // Optional. Switches a bar between showing its progress and an animation
+    // for work of unknown length. The backend animates it on its own.
+    void (*setIndeterminate)(void* handle, bool indeterminate);
+
+    // Progress groups, see progress_group.h
+    void* (*showGroup)(const char* title, const char* style);
+    void (*updateGroup)(void* handle, const ProgressGroupRowUpdate* updates, size_t count);
+    void (*closeGroup)(void* handle);
+
+    // Optional. Called once the core is done handing the backend changes:
+    // at the end of every frame that had any, and after showing or closing.
+    // Lets a backend draw everything at once.
+    void (*endFrame)(void);
+
+    // Optional. Keeps `count` windows of `style` built and hidden, so that
+    // shows only have to fill one in. See window_pool.h.
+    void (*prewarm)(size_t count, const char* style);
+    void (*getPoolStats)(WindowPoolStats* stats);
+
+    // Optional. Draws a sparkline of how fast the bar moved under it, one
+    // level between 0 and 1 per ProgressHistory bucket, oldest first. A count
+    // of 0 removes it.
+    void (*setSparkline)(void* handle, const float* levels, size_t count);
+};
+
+#ifdef __APPLE__
+static void* ShowMacOS(const char* title, const char* message, const char* style,
+                       const char** buttonLabels, size_t buttonCount, ButtonCallback callback,
+                       void* userData) {
+    return ShowProgressBarMacOS(title, message, style, buttonLabels, static_cast<int>(buttonCount),
+                                callback, userData);
+}
+
+static void UpdateMacOS(void* handle, double progress, const char* message, bool updateButtons,
+                        const char** buttonLabels, size_t buttonCount, ButtonCallback callback) {
+    UpdateProgressBarMacOS(handle, progress, message, updateButtons, buttonLabels,
+                           static_cast<int>(buttonCount), callback);
+}
+
+// AppKit only works on the main thread, which is the JS thread in Electron.
+// The backend is called from there and defers to the main queue itself.
+static const bool kUseUiThread = false;
+
+static const ProgressBarBackend kBackends[] = {
+    { "macos", ShowMacOS, UpdateMacOS, UpdateProgressBarsMacOS, CloseProgressBarMacOS,
+      GetProgressBarPixelWidthMacOS, SetProgressBarIndeterminateMacOS, ShowProgressGroupMacOS, UpdateProgressGroupMacOS, CloseProgressGroupMacOS,
+      nullptr, PrewarmProgressBarsMacOS, GetProgressBarPoolStatsMacOS, nullptr },
+};
+#elif defined(_WIN32)
+// Windows belong to the thread that created them, which pumps their messages
+static const bool kUseUiThread = true;
+
+static const ProgressBarBackend kBackends[] = {
+    { "windows", ShowProgressBarWindows, UpdateProgressBarWindows, nullptr, CloseProgressBarWindows,
+      GetProgressBarPixelWidthWindows, SetProgressBarIndeterminateWindows, ShowProgressGroupWindows, UpdateProgressGroupWindows, CloseProgressGroupWindows,
+      nullptr, PrewarmProgressBarsWindows, GetProgressBarPoolStatsWindows, nullptr },
+};
+#elif defined(__linux__)
+static const bool kUseUiThread = true;
+
+static const ProgressBarBackend kBackends[] = {
+    { "headless", ShowProgressBarLinux, UpdateProgressBarLinux, nullptr, CloseProgressBarLinux,
+      GetProgressBarPixelWidthLinux, SetProgressBarIndeterminateLinux, ShowProgressGroupLinux, UpdateProgressGroupLinux, CloseProgressGroupLinux,
+      nullptr, PrewarmProgressBarsLinux, GetProgressBarPoolStatsLinux, SetProgressBarSparklineLinux },
+    { "terminal", ShowProgressBarTerminal, UpdateProgressBarTerminal, nullptr, CloseProgressBarTerminal,
+      GetProgressBarPixelWidthTerminal, SetProgressBarIndeterminateTerminal, ShowProgressGroupTerminal,
+      UpdateProgressGroupTerminal, CloseProgressGroupTerminal, EndFrameTerminal, nullptr, nullptr,
+      SetProgressBarSparklineTerminal },
+};
+#endif
+
+static const ProgressBarBackend* FindBackend(const char* name) {
+    for (const ProgressBarBackend& backend : kBackends) {
+        if (strcmp(backend.name, name) == 0) {
+            return &backend;
+        }
+    }
+    return nullptr;
+}
+
+// The backend new bars are shown with. Defaults to the first one, unless
+// NATIVE_PROGRESS_BAR_BACKEND names another.
+static std::atomic<const ProgressBarBackend*> current_backend{nullptr};
+
+static const ProgressBarBackend* GetCurrentBackend() {
+    const ProgressBarBackend* backend = current_backend.load();
+    if (!backend) {
+        const char* name = getenv("NATIVE_PROGRESS_BAR_BACKEND");
+        backend = name ? FindBackend(name) : nullptr;
+        if (!backend) {
+            backend = &kBackends[0];
+        }
+        current_backend.store(backend);
+    }
+    return backend;
+}
+
+class FrameScheduler;
+
+// Latest-wins state slot. Producers overwrite it as often as they like, the
+// frame flush consumes whatever is there when it runs.
+struct PendingState {
+    double progress = 0;
+    std::string message;
+    std::vector<std::string> buttonLabels;
+    // Click handlers, index-aligned with buttonLabels. Only created, swapped
+    // and deleted on the JS thread.
+    std::vector<napi_ref> buttonCallbacks;
+    bool progressDirty = false;
+    bool messageDirty = false;
+    bool buttonsDirty = false;
+};
+
+// Byte-count progress, see setBytes(). Progress is derived from the counts,
+// and the message from `format` if one is set.
+struct TransferState {
+    bool active = false;
+    uint64_t done = 0;
+    uint64_t total = 0;
+    TransferRate rate;
+    std::string format;
+    bool formatDirty = false;
+};
+
+// Row flags of a progress group, on top of kUpdateProgress/kUpdateMessage
+enum RowField : uint32_t {
+    kRowAdded = 1 << 8,
+    kRowRemoved = 1 << 9,
+};
+
+// A row change waiting for the next frame. A row that is removed and added
+// again within one frame carries both flags; the removal is applied first.
+struct PendingRow {
+    uint32_t id = 0;
+    uint32_t fields = 0;
+    double progress = 0;
+    std::string message;
+};
+
+// Latest-wins state of a progress group: one entry per touched row, in the
+// order the rows were first touched.
+struct ProgressGroupState {
+    std::vector<PendingRow> pending;
+    std::unordered_map<uint32_t, size_t> pendingIndex;
+    // Only touched by the frame flush
+    std::vector<PendingRow> applying;
+    std::vector<ProgressGroupRowUpdate> updates;
+};
+
+// Why the pacer queues a bar on every tick, even if nothing was set on it.
+// See FrameScheduler::SetTicking().
+enum TickReason : uint32_t {
+    // Its message shows a transfer's rate, which decays while it stalls
+    kTickTransfer = 1 << 0,
+    // It shows a sparkline, which should flatten out while it stalls
+    kTickSparkline = 1 << 1,
+};
+
+// Used to tell our externals apart from anyone else's in the native API
+static const uint32_t kProgressBarContextTag = 0x50524f47;
+
+struct ProgressBarContext {
+    uint32_t tag = kProgressBarContextTag;
+    // Handle in open_contexts while the bar is open, see updateMany()
+    uint64_t id = HandleTable<ProgressBarContext>::kInvalidHandle;
+    napi_env env = nullptr;
+    // The backend's handle, only used on the thread that owns the backends.
+    // Null until the bar is shown, and again once it is closed.
+    std::atomic<void*> handle{nullptr};
+    const ProgressBarBackend* backend = nullptr;
+    // See ProgressBarBackend::getPixelWidth. 0 turns the pixel filter off.
+    // Set when shown.
+    double pixelWidth = 0;
+    std::atomic<bool> isValid{true};
+    FrameScheduler* scheduler = nullptr;
+
+    // One reference is held by the JS external, one by open_contexts while
+    // the bar is open, one by the scheduler while the bar is queued, and one
+    // per ProgressBarRef handed to native addons.
+    std::atomic<int> refs{1};
+
+    std::mutex stateMutex;
+    PendingState pending;
+    // Reused across updates so that steady-state updates don't allocate.
+    // `incomingMessage` is only touched on the JS thread, `applied` by the
+    // frame flush.
+    std::string incomingMessage;
+    // What the backend currently shows, including the click handlers of the
+    // buttons it shows
+    PendingState applied;
+    std::vector<const char*> appliedButtonLabels;
+    // Guarded by stateMutex
+    TransferState transfer;
+    // See animateTo(). Guarded by stateMutex.
+    ProgressAnimation animation;
+    // See addTask(). Created with the first task, guarded by stateMutex.
+    std::unique_ptr<TaskTree> tasks;
+    // The task whose path the message shows, TaskTree::kRoot if none
+    uint32_t messageTask = TaskTree::kRoot;
+    // The message built from transfer.format, only touched by the frame flush
+    std::string formattedMessage;
+    // Set while the context sits in the scheduler's dirty list, so a bar
+    // never has more than one pending frame.
+    std::atomic<bool> queued{false};
+    // Latest-wins switch to indeterminate (1) or back (0), -1 if there is
+    // none pending. Outside of stateMutex, as it is rarely set.
+    std::atomic<int> indeterminateChange{-1};
+    // When the oldest change the backend hasn't seen yet came in, or the
+    // epoch if there is none. Guarded by stateMutex.
+    std::chrono::steady_clock::time_point pendingSince;
+    // Progress over time, sampled by the frame flush. Guarded by stateMutex.
+    ProgressHistory history;
+    // Latest-wins switch to showing a sparkline (1) or not (0), -1 if there
+    // is none pending, like indeterminateChange
+    std::atomic<int> sparklineChange{-1};
+    // Only touched by the frame flush
+    bool sparkline = false;
+    uint64_t sparklineVersion = 0;
+    float sparklineLevels[ProgressHistory::kCapacity];
+
+    ProgressStats stats;
+
+    // Optional Int32Array over a SharedArrayBuffer that other threads write
+    // progress into. Guarded by the scheduler's mutex.
+    napi_ref sharedProgressRef = nullptr;
+    std::atomic<int32_t>* sharedProgress = nullptr;
+    int32_t sharedSequence = 0;
+    // Optional segment that other processes write progress and message into,
+    // see createSharedSegment(). Owned by the JS thread, sampled like
+    // sharedProgress while the scheduler lists the bar as a channel.
+    std::unique_ptr<SharedSegment> segment;
+    SharedSegmentReader segmentReader;
+    // Scaled like sharedProgress, -1 until the first progress comes in
+    int32_t segmentProgress = -1;
+    // Reused by the pacer thread so that sampled messages don't allocate
+    std::string segmentMessage;
+    // TickReason flags. Guarded by the scheduler's mutex.
+    uint32_t tickReasons = 0;
+
+    // Set if this context is a progress group rather than a single bar.
+    // Groups share the bars' lifetime and scheduling; their state lives here
+    // and is guarded by stateMutex.
+    std::unique_ptr<ProgressGroupState> group;
+};
+
+// Times in a ProgressHistory, in seconds on the steady clock
+static double HistorySeconds(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration<double>(time.time_since_epoch()).count();
+}
+
+// Layout of the shared progress channel, mirrored in src/shared-progress.ts.
+// Writers store the progress, then bump the sequence.
+static const size_t kSharedProgressSequence = 0;
+static const size_t kSharedProgressValue = 1;
+static const size_t kSharedProgressLength = 4;
+static const double kSharedProgressScale = 10000.0;
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t),
+              "Shared progress cells must map onto plain int32 slots");
+
+// Fields passed to updateProgress(), mirrored in src/index.ts. Only the
+// fields in the mask are decoded.
+enum UpdateField : uint32_t {
+    kUpdateProgress = 1 << 0,
+    kUpdateMessage = 1 << 1,
+    kUpdateButtons = 1 << 2,
+};
+
+static void RetainContext(ProgressBarContext* context);
+static void ReleaseContext(ProgressBarContext* context);
+
+// Every open bar and group, across environments. Holds a reference on each
+// context from show until close, so that contexts can be looked up by id and
+// closed when their environment goes away.
+static HandleTable<ProgressBarContext> open_contexts;
+static std::mutex handles_mutex;
+
+// Contexts that have not been freed yet, open or not
+static std::atomic<int64_t> live_contexts{0};
+
+// Stats of freed bars, and those that aren't tied to a bar. Bars keep their
+// own until they are freed, as an in-flight frame may still count on a
+// closed one. They are folded in under handles_mutex, so that CollectStats()
+// counts each bar exactly once.
+static ProgressStats retired_stats;
+// Bars that are closed but not freed yet. Guarded by handles_mutex.
+static std::unordered_set<ProgressBarContext*> closed_contexts;
+
+// napi_refs held for button click handlers, across all bars
+static std::atomic<int64_t> live_callback_refs{0};
+
+// napi_refs held on buffers attached with attachSharedProgress()
+static std::atomic<int64_t> live_buffer_refs{0};
+
+// Shared segments mapped by this process, as their bar's owner or as a writer
+static std::atomic<int64_t> live_segments{0};
+
+static napi_status CreateCallbackRef(napi_env env, napi_value callback, napi_ref* result) {
+    napi_status status = napi_create_reference(env, callback, 1, result);
+    if (status == napi_ok) {
+        live_callback_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return status;
+}
+
+static void DeleteCallbackRefs(napi_env env, std::vector<napi_ref>& callbacks) {
+    for (napi_ref callback : callbacks) {
+        napi_delete_reference(env, callback);
+    }
+    live_callback_refs.fetch_sub(static_cast<int64_t>(callbacks.size()), std::memory_order_relaxed);
+    callbacks.clear();
+}
+
+// Counts a change landing in a bar's pending state. `overwrites` is whether
+// it replaces one the backend hasn't seen yet. Called with stateMutex held.
+static void CountPendingChange(ProgressBarContext* context, bool overwrites) {
+    if (context->pendingSince == std::chrono::steady_clock::time_point()) {
+        context->pendingSince = std::chrono::steady_clock::now();
+    } else if (overwrites) {
+        Count(context->stats.updatesCoalesced);
+    }
+}
+
+// Takes the time the oldest pending change came in. Called with stateMutex
+// held, when the pending state is consumed.
+static std::chrono::steady_clock::time_point TakePendingSince(ProgressBarContext* context) {
+    std::chrono::steady_clock::time_point since = context->pendingSince;
+    context->pendingSince = std::chrono::steady_clock::time_point();
+    return since;
+}
+
+// Runs the click handler of a button the backend currently shows. Runs on
+// the JS thread.
+static void DispatchButtonClick(ProgressBarContext* context, int buttonIndex) {
+    if (!context->isValid.load()) {
+        return;
+    }
+
+    TraceSpan span("DispatchButtonClick", "button", buttonIndex);
+    napi_env env = context->env;
+    napi_handle_scope scope;
+    napi_open_handle_scope(env, &scope);
+
+    // The frame flush may swap the handlers on the UI thread. Replaced
+    // handlers are only deleted on this thread, so the one we got stays
+    // valid after unlocking.
+    napi_value callback = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        const std::vector<napi_ref>& callbacks = context->applied.buttonCallbacks;
+        if (buttonIndex >= 0 && static_cast<size_t>(buttonIndex) < callbacks.size()) {
+            napi_get_reference_value(env, callbacks[buttonIndex], &callback);
+        }
+    }
+
+    if (callback) {
+        napi_value global;
+        napi_get_global(env, &global);
+
+        napi_value result;
+        napi_call_function(env, global, callback, 0, nullptr, &result);
+    }
+
+    napi_close_handle_scope(env, scope);
+}
+
+static void ButtonClickCallback(void* userData, int buttonIndex);
+
+// Work for the UI thread. Commands are intrusive, so they can live wherever
+// suits the caller: on the heap, in the scheduler, or on the stack of a
+// caller that waits for them.
+struct UiCommand {
+    enum Kind {
+        kShow,
+        kClose,
+        kFlush,
+        kSync,
+        kPrewarm,
+    };
+
+    explicit UiCommand(Kind kind) : kind(kind) {}
+
+    Kind kind;
+    std::atomic<UiCommand*> next{nullptr};
+    // Deleted by the UI thread once it has run
+    bool owned = true;
+    FrameScheduler* scheduler = nullptr;
+    // Holds a reference, dropped once the command has run
+    ProgressBarContext* context = nullptr;
+
+    // kShow
+    std::string title;
+    std::string message;
+    std::string style;
+    std::vector<std::string> buttonLabels;
+
+    // kSync
+    napi_deferred deferred = nullptr;
+
+    // kPrewarm, which also uses `style`
+    const ProgressBarBackend* backend = nullptr;
+    size_t count = 0;
+
+    // Set once the command has run, for callers that wait on it. Guarded by
+    // the UI thread's doneMutex_.
+    bool done = false;
+};
+
+// Intrusive multi-producer, single-consumer queue, after Dmitry Vyukov's.
+// Push() is wait-free and may be called from any thread; Pop() and Empty()
+// are only called by the consumer. A popped command is no longer referenced
+// by the queue and may be reused right away.
+class UiCommandQueue {
+public:
+    UiCommandQueue() : stub_(UiCommand::kFlush), head_(&stub_), tail_(&stub_) {}
+
+    void Push(UiCommand* command) {
+        command->next.store(nullptr, std::memory_order_relaxed);
+        UiCommand* prev = head_.exchange(command, std::memory_order_acq_rel);
+        prev->next.store(command, std::memory_order_seq_cst);
+    }
+
+    // Returns nullptr if the queue is empty, or while a producer is halfway
+    // through a push
+    UiCommand* Pop() {
+        UiCommand* tail = tail_;
+        UiCommand* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        Push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    // False while a push is in flight
+    bool Empty() const {
+        return tail_ == &stub_ && !stub_.next.load(std::memory_order_seq_cst);
+    }
+
+private:
+    UiCommand stub_;
+    std::atomic<UiCommand*> head_;
+    // Only touched by the consumer
+    UiCommand* tail_;
+};
+
+// The thread that owns the backends, where kUseUiThread is set. Producers
+// post commands and return right away; the thread sleeps while there is
+// nothing to do. On Windows it also pumps the messages of the windows it
+// created.
+class UiThread {
+public:
+    using Handler = void (*)(UiCommand* command);
+
+    bool Start(Handler handler) {
+        handler_ = handler;
+#ifdef _WIN32
+        event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        if (!event_) {
+            return false;
+        }
+#endif
+        thread_ = std::thread(&UiThread::Run, this);
+        return true;
+    }
+
+    // Runs whatever is still queued, then joins the thread
+    void Stop() {
+        if (!thread_.joinable()) {
+            return;
+        }
+
+        stopping_.store(true);
+        Wake();
+        thread_.join();
+
+        while (UiCommand* command = queue_.Pop()) {
+            Complete(command);
+        }
+#ifdef _WIN32
+        CloseHandle(event_);
+        event_ = nullptr;
+#endif
+    }
+
+    // Any thread
+    void Post(UiCommand* command) {
+        queue_.Push(command);
+        if (sleeping_.load(std::memory_order_seq_cst)) {
+            Wake();
+        }
+    }
+
+    // Posts a command and blocks until it has run. Must not be called on the
+    // UI thread.
+    void PostAndWait(UiCommand* command) {
+        command->owned = false;
+        command->done = false;
+        Post(command);
+
+        std::unique_lock<std::mutex> lock(doneMutex_);
+        doneCv_.wait(lock, [command] { return command->done; });
+    }
+
+private:
+    void Run() {
+        TraceSetThreadName("ProgressBar UI");
+        while (true) {
+            while (UiCommand* command = queue_.Pop()) {
+                Complete(command);
+            }
+            PumpMessages();
+
+            if (stopping_.load() && queue_.Empty()) {
+                break;
+            }
+
+            // Either we see a command pushed meanwhile, or its producer sees
+            // that we are about to sleep and wakes us
+            sleeping_.store(true, std::memory_order_seq_cst);
+            if (queue_.Empty() && !stopping_.load()) {
+                WaitForWork();
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void Complete(UiCommand* command) {
+        handler_(command);
+        if (command->owned) {
+            delete command;
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(doneMutex_);
+            command->done = true;
+        }
+        doneCv_.notify_all();
+    }
+
+#ifdef _WIN32
+    void Wake() {
+        SetEvent(event_);
+    }
+
+    void WaitForWork() {
+        MsgWaitForMultipleObjectsEx(1, &event_, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+    }
+
+    void PumpMessages() {
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+    }
+#else
+    void Wake() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            signaled_ = true;
+        }
+        wakeCv_.notify_one();
+    }
+
+    void WaitForWork() {
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wakeCv_.wait(lock, [this] { return signaled_; });
+        signaled_ = false;
+    }
+
+    void PumpMessages() {}
+#endif
+
+    Handler handler_ = nullptr;
+    UiCommandQueue queue_;
+    std::thread thread_;
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> stopping_{false};
+#ifdef _WIN32
+    HANDLE event_ = nullptr;
+#else
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    bool signaled_ = false;
 #endif
+    std::mutex doneMutex_;
+    std::condition_variable doneCv_;
+};
+
+// Work the UI thread hands back to the JS thread
+struct JsTask {
+    enum Kind {
+        kClick,
+        kSync,
+    };
+
+    Kind kind;
+    // Holds a reference
+    ProgressBarContext* context = nullptr;
+    int buttonIndex = 0;
+    napi_deferred deferred = nullptr;
+    bool result = false;
+};
+
+static void RunUiCommand(UiCommand* command);
+
+// Paces backend updates. Producers drop their latest state into the bar's
+// PendingState and call Schedule(); a pacer thread waits for the next frame
+// slot and wakes the thread that owns the backends, at most once per frame.
+// Everything that piled up in between is applied in a single flush.
+//
+// Where kUseUiThread is set, the scheduler also owns the UI thread: shows,
+// closes and frames are posted to it, and it hands button clicks and other
+// results back to the JS thread through a threadsafe function. Otherwise
+// the JS thread owns the backends, and the threadsafe function runs the
+// flush there.
+class FrameScheduler {
+public:
+    static constexpr double kDefaultFrameRate = 60.0;
+
+    bool Start(napi_env env) {
+        napi_value name;
+        if (napi_create_string_utf8(env, "ProgressBarFrame", NAPI_AUTO_LENGTH, &name) != napi_ok) {
+            return false;
+        }
+
+        env_ = env;
+        jsThread_ = std::this_thread::get_id();
+        TraceSetThreadName("JavaScript");
+        frameCommand_.owned = false;
+        frameCommand_.scheduler = this;
+        if (kUseUiThread && !ui_.Start(RunUiCommand)) {
+            return false;
+        }
+
+        if (napi_create_threadsafe_function(env, nullptr, nullptr, name, 0, 1, nullptr,
+                                            nullptr, this, CallOnJsThread, &tsfn_) != napi_ok) {
+            ui_.Stop();
+            return false;
+        }
+
+        // The scheduler must never keep the process alive on its own
+        napi_unref_threadsafe_function(env, tsfn_);
+
+        frameStart_ = std::chrono::steady_clock::now();
+        thread_ = std::thread(&FrameScheduler::Run, this);
+        return true;
+    }
+
+    void Stop() {
+        std::vector<ProgressBarContext*> frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+            frame.swap(dirty_);
+        }
+        cv_.notify_all();
+
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        {
+            // The UI thread may still be posting results
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tsfn_) {
+                napi_release_threadsafe_function(tsfn_, napi_tsfn_abort);
+                tsfn_ = nullptr;
+            }
+        }
+
+        for (ProgressBarContext* context : frame) {
+            context->queued.store(false);
+            ReleaseContext(context);
+        }
+    }
+
+    // Thread-safe and non-blocking apart from a short critical section. The
+    // dirty list holds a reference, so producers on other threads may drop
+    // theirs right after scheduling.
+    void Schedule(ProgressBarContext* context) {
+        if (context->queued.exchange(true)) {
+            return;
+        }
+
+        RetainContext(context);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!stopping_) {
+                dirty_.push_back(context);
+                context = nullptr;
+            }
+        }
+
+        if (context) {
+            context->queued.store(false);
+            ReleaseContext(context);
+            return;
+        }
+        cv_.notify_one();
+    }
+
+    // Called on the JS thread when a bar closes.
+    void Cancel(ProgressBarContext* context) {
+        bool wasQueued = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = std::find(dirty_.begin(), dirty_.end(), context);
+            if (it != dirty_.end()) {
+                dirty_.erase(it);
+                wasQueued = true;
+            }
+            channels_.erase(std::remove(channels_.begin(), channels_.end(), context), channels_.end());
+            animating_.erase(std::remove(animating_.begin(), animating_.end(), context), animating_.end());
+            if (context->tickReasons) {
+                ticking_.erase(std::remove(ticking_.begin(), ticking_.end(), context), ticking_.end());
+                context->tickReasons = 0;
+            }
+            context->sharedProgress = nullptr;
+        }
+
+        if (wasQueued) {
+            context->queued.store(false);
+            ReleaseContext(context);
+        }
+    }
+
+    // Starts sampling a shared progress channel once per frame. Passing
+    // nullptr stops sampling. Called on the JS thread.
+    void SetSharedProgress(ProgressBarContext* context, std::atomic<int32_t>* cells) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+
+            bool sampled = context->sharedProgress || context->segment;
+            context->sharedProgress = cells;
+            UpdateChannel(context, sampled);
+            // Pick up whatever is already in the buffer on the next frame
+            context->sharedSequence = cells ? cells[kSharedProgressSequence].load() - 1 : 0;
+        }
+        cv_.notify_one();
+    }
+
+    // Starts sampling the bar's shared segment once per frame. Called on the
+    // JS thread right after the segment is created; Cancel() stops it.
+    void AddSharedSegment(ProgressBarContext* context) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || !context->segment) {
+                return;
+            }
+            UpdateChannel(context, context->sharedProgress != nullptr);
+        }
+        cv_.notify_one();
+    }
+
+    // Queues the bar on every frame until its animation is done. Called on
+    // the JS thread, with the animation already started.
+    void Animate(ProgressBarContext* context) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            if (std::find(animating_.begin(), animating_.end(), context) == animating_.end()) {
+                animating_.push_back(context);
+            }
+        }
+        Schedule(context);
+    }
+
+    // Queues the bar every kTickInterval for as long as it has any reason
+    // to, so that what changes with time alone is redrawn. Called on the JS
+    // thread; Cancel() stops it.
+    void SetTicking(ProgressBarContext* context, TickReason reason, bool enabled) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+
+            bool wasTicking = context->tickReasons != 0;
+            if (enabled) {
+                context->tickReasons |= reason;
+            } else {
+                context->tickReasons &= ~static_cast<uint32_t>(reason);
+            }
+
+            if (context->tickReasons && !wasTicking) {
+                ticking_.push_back(context);
+            } else if (!context->tickReasons && wasTicking) {
+                ticking_.erase(std::remove(ticking_.begin(), ticking_.end(), context), ticking_.end());
+            }
+        }
+        cv_.notify_one();
+    }
+
+    // Runs whatever the UI thread still has queued and stops it. Called on
+    // the JS thread, after Stop().
+    void StopUiThread() {
+        ui_.Stop();
+        DrainStaleRefs(env_);
+    }
+
+    // Runs `command` on the thread that owns the backends: posted to the UI
+    // thread, or right away if the JS thread owns them. Called on the JS
+    // thread.
+    void RunOnUiThread(UiCommand* command) {
+        command->scheduler = this;
+        if (kUseUiThread) {
+            ui_.Post(command);
+            return;
+        }
+
+        RunUiCommand(command);
+        if (command->owned) {
+            delete command;
+        }
+    }
+
+    // Applies all pending state before returning. Called on the JS thread.
+    void FlushNow() {
+        if (!kUseUiThread) {
+            Flush();
+            return;
+        }
+
+        UiCommand command(UiCommand::kFlush);
+        command.scheduler = this;
+        ui_.PostAndWait(&command);
+    }
+
+    // Waits until the UI thread has run everything queued so far, and drops
+    // the click handlers it replaced. Doesn't flush. For diagnostics and the
+    // headless helpers, which want to see what the backend has been told.
+    // Called on the JS thread.
+    void CatchUp() {
+        if (kUseUiThread) {
+            UiCommand command(UiCommand::kSync);
+            command.scheduler = this;
+            ui_.PostAndWait(&command);
+        }
+        DrainStaleRefs(env_);
+    }
+
+    void RunFlushCommand(UiCommand* command) {
+        if (command == &frameCommand_) {
+            frameQueued_.store(false);
+        }
+        Flush();
+    }
+
+    // Click handlers that were replaced by the frame flush. They can only be
+    // deleted on the JS thread, so off it they are queued up for it.
+    void ReleaseCallbackRefs(napi_env env, std::vector<napi_ref>& refs) {
+        if (refs.empty()) {
+            return;
+        }
+
+        if (!kUseUiThread) {
+            DeleteCallbackRefs(env, refs);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        staleRefs_.insert(staleRefs_.end(), refs.begin(), refs.end());
+        refs.clear();
+        if (tsfn_) {
+            napi_call_threadsafe_function(tsfn_, nullptr, napi_tsfn_nonblocking);
+        }
+    }
+
+    // Runs a button's click handler on the JS thread. Called on the thread
+    // that owns the backends, or on the JS thread for simulated clicks.
+    void PostButtonClick(ProgressBarContext* context, int buttonIndex) {
+        if (!kUseUiThread || std::this_thread::get_id() == jsThread_) {
+            DispatchButtonClick(context, buttonIndex);
+            return;
+        }
+
+        JsTask* task = new JsTask();
+        task->kind = JsTask::kClick;
+        task->context = context;
+        task->buttonIndex = buttonIndex;
+        RetainContext(context);
+        PostToJsThread(task);
+    }
+
+    // Resolves `deferred` once the UI thread has caught up with everything
+    // queued for the context so far. Called on the JS thread.
+    void Sync(napi_env env, ProgressBarContext* context, napi_deferred deferred) {
+        // A pending promise alone doesn't keep the event loop alive
+        if (kUseUiThread && pendingSyncs_++ == 0) {
+            napi_ref_threadsafe_function(env, tsfn_);
+        }
+
+        UiCommand* command = new UiCommand(UiCommand::kSync);
+        command->context = context;
+        command->deferred = deferred;
+        RetainContext(context);
+        RunOnUiThread(command);
+    }
+
+    // The other half of Sync(), called on the thread that owns the backends
+    void PostSyncResult(ProgressBarContext* context, napi_deferred deferred, bool result) {
+        if (!kUseUiThread) {
+            ResolveSync(context->env, deferred, result);
+            return;
+        }
+
+        JsTask* task = new JsTask();
+        task->kind = JsTask::kSync;
+        task->context = context;
+        task->deferred = deferred;
+        task->result = result;
+        RetainContext(context);
+        PostToJsThread(task);
+    }
+
+    // Applies all pending state to the backends. Runs on the thread that owns
+    // them.
+    void Flush() {
+        TraceSpan span("Flush");
+        auto now = std::chrono::steady_clock::now();
+        std::vector<ProgressBarContext*> frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame.swap(dirty_);
+            framePending_ = false;
+            frameStart_ = std::chrono::steady_clock::now();
+        }
+        cv_.notify_one();
+        span.SetArg("bars", static_cast<int64_t>(frame.size()));
+
+        // Bars are handed to their backend in one batch, so their applied
+        // state must stay alive until the batch is out
+        const ProgressBarBackend* backend = nullptr;
+        for (ProgressBarContext* context : frame) {
+            // Clear first so that writes racing with this flush reschedule
+            context->queued.store(false);
+
+            if (context->group) {
+                ApplyGroupState(context);
+                continue;
+            }
+
+            ApplyIndeterminate(context);
+            AdvanceAnimation(context, now);
+
+            ProgressBarUpdate update;
+            std::chrono::steady_clock::time_point since;
+            bool changed = CollectPendingState(context, now, &update, &since);
+            ApplySparkline(context, now);
+            if (!changed) {
+                continue;
+            }
+
+            if (backend != context->backend) {
+                SubmitBatch(backend);
+                backend = context->backend;
+            }
+            batch_.push_back(update);
+            batchSources_.push_back({ context, since });
+        }
+        SubmitBatch(backend);
+        EndFrame(frame);
+
+        for (ProgressBarContext* context : frame) {
+            ReleaseContext(context);
+        }
+    }
+
+    // Hands a switch to or from indeterminate to the backend. Runs on the
+    // thread that owns the backends.
+    static void ApplyIndeterminate(ProgressBarContext* context) {
+        int change = context->indeterminateChange.exchange(-1);
+        void* handle = context->handle;
+        if (change < 0 || !handle || !context->backend->setIndeterminate) {
+            return;
+        }
+
+        TraceSpan span("Backend setIndeterminate");
+        context->backend->setIndeterminate(handle, change == 1);
+        Count(context->stats.backendDispatches);
+    }
+
+    // Hands a bar's sparkline to the backend when it is switched on or off,
+    // or its history changed since. Runs on the thread that owns the backends.
+    static void ApplySparkline(ProgressBarContext* context, std::chrono::steady_clock::time_point now) {
+        int change = context->sparklineChange.exchange(-1);
+        void* handle = context->handle;
+        const ProgressBarBackend* backend = context->backend;
+        if (!handle || !backend->setSparkline) {
+            return;
+        }
+
+        if (change >= 0) {
+            context->sparkline = change == 1;
+            if (!context->sparkline) {
+                TraceSpan span("Backend setSparkline");
+                backend->setSparkline(handle, nullptr, 0);
+                Count(context->stats.backendDispatches);
+                return;
+            }
+        }
+        if (!context->sparkline) {
+            return;
+        }
+
+        // Levels are relative to the fastest bucket, so the line uses its
+        // whole height whatever the job's pace
+        float* levels = context->sparklineLevels;
+        size_t count;
+        {
+            std::lock_guard<std::mutex> lock(context->stateMutex);
+            // Ticks bring the bar here while its progress stands still
+            ProgressHistory& history = context->history;
+            history.Advance(HistorySeconds(now));
+            if (change < 0 && history.version() == context->sparklineVersion) {
+                return;
+            }
+            context->sparklineVersion = history.version();
+
+            count = history.size();
+            double fastest = 0;
+            for (size_t i = 0; i < count; i++) {
+                fastest = std::max(fastest, history.RateAt(i));
+            }
+            for (size_t i = 0; i < count; i++) {
+                double rate = std::max(0.0, history.RateAt(i));
+                levels[i] = fastest > 0 ? static_cast<float>(rate / fastest) : 0.0f;
+            }
+        }
+
+        TraceSpan span("Backend setSparkline", "buckets", static_cast<int64_t>(count));
+        backend->setSparkline(handle, levels, count);
+        Count(context->stats.backendDispatches);
+    }
+
+    // Moves an animated bar's pending progress to where the animation is at
+    // `now`. A progress update that came in since the last frame becomes the
+    // animation's new target. Runs on the thread that owns the backends.
+    static void AdvanceAnimation(ProgressBarContext* context, std::chrono::steady_clock::time_point now) {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        ProgressAnimation& animation = context->animation;
+        if (!animation.Active()) {
+            return;
+        }
+
+        // The flush never leaves progressDirty set, so this came from a caller
+        PendingState& pending = context->pending;
+        if (pending.progressDirty) {
+            animation.Retarget(pending.progress, now);
+        }
+
+        double progress = animation.ValueAt(now);
+        bool finished = animation.FinishedAt(now);
+        if (finished) {
+            animation.Stop();
+        } else if (FillsSamePixels(context->applied.progress, progress, context->pixelWidth)) {
+            return;
+        }
+
+        if (context->pendingSince == std::chrono::steady_clock::time_point()) {
+            context->pendingSince = now;
+        }
+        pending.progress = progress;
+        pending.progressDirty = true;
+    }
+
+    // Lets every backend that had a bar in the frame draw it
+    static void EndFrame(const std::vector<ProgressBarContext*>& frame) {
+        const ProgressBarBackend* ended = nullptr;
+        for (ProgressBarContext* context : frame) {
+            const ProgressBarBackend* backend = context->backend;
+            if (backend->endFrame && backend != ended) {
+                backend->endFrame();
+                // Frames rarely mix backends, so only skip repeats in a row
+                ended = backend;
+            }
+        }
+    }
+
+    // Whether two progress values fill the same number of pixels. Always
+    // false if the width is unknown.
+    static bool FillsSamePixels(double a, double b, double pixelWidth) {
+        if (pixelWidth <= 0) {
+            return false;
+        }
+        return std::floor(a * pixelWidth / 100) == std::floor(b * pixelWidth / 100);
+    }
+
+    // Moves a bar's pending state into its applied state and describes what
+    // changed, and when the oldest of those changes came in. Returns false if
+    // there is nothing to hand to the backend. Runs on the thread that owns
+    // the backends.
+    static bool CollectPendingState(ProgressBarContext* context, std::chrono::steady_clock::time_point now,
+                                    ProgressBarUpdate* update, std::chrono::steady_clock::time_point* since) {
+        PendingState& state = context->applied;
+        std::vector<napi_ref> replaced;
+        {
+            std::lock_guard<std::mutex> lock(context->stateMutex);
+            PendingState& pending = context->pending;
+            TransferState& transfer = context->transfer;
+            *since = TakePendingSince(context);
+            if (!pending.progressDirty && !pending.messageDirty && !pending.buttonsDirty &&
+                !transfer.formatDirty) {
+                return false;
+            }
+
+            // Sampled ahead of the pixel filter, which only cares about drawing
+            if (pending.progressDirty) {
+                context->history.Record(HistorySeconds(now), pending.progress);
+            }
+
+            bool messageDirty = pending.messageDirty;
+            if (transfer.active && !transfer.format.empty()) {
+                // A message format takes precedence over messages set directly
+                messageDirty = false;
+                if (pending.progressDirty || transfer.formatDirty) {
+                    std::string& formatted = context->formattedMessage;
+                    FormatTransferMessage(formatted, transfer.format, transfer.done, transfer.total,
+                                          transfer.rate, now);
+                    if (formatted != state.message) {
+                        state.message.swap(formatted);
+                        messageDirty = true;
+                    }
+                }
+            } else if (messageDirty) {
+                // A message the bar already shows isn't sent again
+                messageDirty = pending.message != state.message;
+                if (messageDirty) {
+                    state.message.assign(pending.message);
+                }
+            }
+
+            // Long jobs report far more often than their bar can show
+            if (!messageDirty && !pending.buttonsDirty &&
+                (!pending.progressDirty || FillsSamePixels(state.progress, pending.progress, context->pixelWidth))) {
+                if (pending.progressDirty) {
+                    Count(context->stats.updatesSuppressed);
+                }
+                pending.progressDirty = false;
+                pending.messageDirty = false;
+                transfer.formatDirty = false;
+                return false;
+            }
+            state.progress = pending.progress;
+            if (pending.buttonsDirty) {
+                state.buttonLabels.swap(pending.buttonLabels);
+                // The labels being replaced take their click handlers with them
+                replaced.swap(state.buttonCallbacks);
+                state.buttonCallbacks.swap(pending.buttonCallbacks);
+            }
+            state.messageDirty = messageDirty;
+            state.buttonsDirty = pending.buttonsDirty;
+
+            pending.progressDirty = false;
+            pending.messageDirty = false;
+            pending.buttonsDirty = false;
+            transfer.formatDirty = false;
+        }
+        context->scheduler->ReleaseCallbackRefs(context->env, replaced);
+
+        if (!context->isValid.load() || !context->handle) {
+            return false;
+        }
+
+        std::vector<const char*>& labels = context->appliedButtonLabels;
+        labels.clear();
+        if (state.buttonsDirty) {
+            for (const std::string& label : state.buttonLabels) {
+                labels.push_back(label.c_str());
+            }
+        }
+
+        update->handle = context->handle;
+        update->progress = state.progress;
+        update->message = state.messageDirty ? state.message.c_str() : nullptr;
+        update->updateButtons = state.buttonsDirty;
+        update->buttonLabels = labels.data();
+        update->buttonCount = labels.size();
+        update->callback = state.buttonsDirty ? ButtonClickCallback : nullptr;
+        return true;
+    }
+
+    void SubmitBatch(const ProgressBarBackend* backend) {
+        if (batch_.empty()) {
+            return;
+        }
+
+        TraceSpan span("Backend update", "bars", static_cast<int64_t>(batch_.size()));
+        if (backend->updateBatch) {
+            backend->updateBatch(batch_.data(), batch_.size());
+            Count(retired_stats.backendCalls);
+        } else {
+            for (const ProgressBarUpdate& update : batch_) {
+                backend->update(update.handle, update.progress, update.message, update.updateButtons,
+                                update.buttonLabels, update.buttonCount, update.callback);
+            }
+            Count(retired_stats.backendCalls, batch_.size());
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (const BatchSource& source : batchSources_) {
+            Count(source.context->stats.backendDispatches);
+            source.context->stats.latency.Record(now - source.since);
+        }
+        batch_.clear();
+        batchSources_.clear();
+    }
+
+    // Hands a group's row changes to its backend in one batch. Runs on the
+    // thread that owns the backends.
+    static void ApplyGroupState(ProgressBarContext* context) {
+        ProgressGroupState& group = *context->group;
+        group.applying.clear();
+        std::chrono::steady_clock::time_point since;
+        {
+            std::lock_guard<std::mutex> lock(context->stateMutex);
+            group.applying.swap(group.pending);
+            group.pendingIndex.clear();
+            since = TakePendingSince(context);
+        }
+
+        if (!context->isValid.load() || !context->handle) {
+            return;
+        }
+
+        group.updates.clear();
+        for (const PendingRow& row : group.applying) {
+            if (row.fields & kRowRemoved) {
+                group.updates.push_back({ row.id, PROGRESS_GROUP_ROW_REMOVE, false, 0, nullptr });
+            }
+            if (row.fields & kRowAdded) {
+                group.updates.push_back({ row.id, PROGRESS_GROUP_ROW_ADD, true, row.progress, row.message.c_str() });
+            } else if (row.fields & (kUpdateProgress | kUpdateMessage)) {
+                group.updates.push_back({
+                    row.id,
+                    PROGRESS_GROUP_ROW_UPDATE,
+                    (row.fields & kUpdateProgress) != 0,
+                    row.progress,
+                    (row.fields & kUpdateMessage) ? row.message.c_str() : nullptr,
+                });
+            }
+        }
+
+        if (!group.updates.empty()) {
+            TraceSpan span("Backend updateGroup", "rows", static_cast<int64_t>(group.updates.size()));
+            context->backend->updateGroup(context->handle, group.updates.data(), group.updates.size());
+            Count(retired_stats.backendCalls);
+            Count(context->stats.backendDispatches);
+            context->stats.latency.Record(std::chrono::steady_clock::now() - since);
+        }
+    }
+
+    // A rate of zero or less disables pacing: updates are applied on the next
+    // turn of the event loop, but are still coalesced.
+    void SetMaxFrameRate(double hz) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frameInterval_ = hz > 0
+            ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(1.0 / hz))
+            : std::chrono::steady_clock::duration::zero();
+        cv_.notify_one();
+    }
+
+    // Contexts keep their scheduler alive: their finalizers can run after the
+    // environment's cleanup hook has already stopped it.
+    void AddRef() {
+        refs_.fetch_add(1);
+    }
+
+    void Release() {
+        if (refs_.fetch_sub(1) == 1) {
+            delete this;
+        }
+    }
+
+    double GetMaxFrameRate() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frameInterval_.count() == 0) {
+            return 0;
+        }
+        return 1.0 / std::chrono::duration<double>(frameInterval_).count();
+    }
+
+private:
+    // `data` is a JsTask, or nullptr to just drain stale click handlers (and
+    // to flush, if the JS thread owns the backends)
+    static void CallOnJsThread(napi_env env, napi_value js_callback, void* context, void* data) {
+        FrameScheduler* scheduler = static_cast<FrameScheduler*>(context);
+        JsTask* task = static_cast<JsTask*>(data);
+        if (env == nullptr) {
+            // Torn down before it ran
+            if (task) {
+                ReleaseContext(task->context);
+                delete task;
+            }
+            return;
+        }
+
+        scheduler->DrainStaleRefs(env);
+        if (!task) {
+            if (!kUseUiThread) {
+                scheduler->Flush();
+            }
+            return;
+        }
+
+        switch (task->kind) {
+        case JsTask::kClick:
+            DispatchButtonClick(task->context, task->buttonIndex);
+            break;
+        case JsTask::kSync:
+            ResolveSync(env, task->deferred, task->result);
+            if (--scheduler->pendingSyncs_ == 0 && scheduler->tsfn_) {
+                napi_unref_threadsafe_function(env, scheduler->tsfn_);
+            }
+            break;
+        }
+
+        ReleaseContext(task->context);
+        delete task;
+    }
+
+    static void ResolveSync(napi_env env, napi_deferred deferred, bool result) {
+        napi_value value;
+        napi_get_boolean(env, result, &value);
+        napi_resolve_deferred(env, deferred, value);
+    }
+
+    void PostToJsThread(JsTask* task) {
+        napi_status status = napi_closing;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tsfn_) {
+                status = napi_call_threadsafe_function(tsfn_, task, napi_tsfn_nonblocking);
+            }
+        }
+
+        if (status != napi_ok) {
+            ReleaseContext(task->context);
+            delete task;
+        }
+    }
+
+    void DrainStaleRefs(napi_env env) {
+        std::vector<napi_ref> refs;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            refs.swap(staleRefs_);
+        }
+        DeleteCallbackRefs(env, refs);
+    }
+
+    void PostFrame() {
+        if (!frameQueued_.exchange(true)) {
+            ui_.Post(&frameCommand_);
+        }
+    }
+
+    // Queues every bar that is still animating, and forgets the rest. Runs
+    // on the pacer thread with mutex_ held.
+    void QueueAnimations() {
+        auto it = std::remove_if(animating_.begin(), animating_.end(), [](ProgressBarContext* context) {
+            std::lock_guard<std::mutex> lock(context->stateMutex);
+            return !context->animation.Active();
+        });
+        animating_.erase(it, animating_.end());
+
+        for (ProgressBarContext* context : animating_) {
+            if (!context->queued.exchange(true)) {
+                RetainContext(context);
+                dirty_.push_back(context);
+            }
+        }
+    }
+
+    // Queues every ticking bar, if a tick is due. A transfer's message is
+    // formatted again, to pick up its decaying rate. Runs on the pacer thread
+    // with mutex_ held.
+    void QueueTicks(std::chrono::steady_clock::time_point now) {
+        if (ticking_.empty() || now < nextTick_) {
+            return;
+        }
+        nextTick_ = now + kTickInterval;
+
+        for (ProgressBarContext* context : ticking_) {
+            if (context->tickReasons & kTickTransfer) {
+                std::lock_guard<std::mutex> lock(context->stateMutex);
+                TransferState& transfer = context->transfer;
+                if (transfer.active && !transfer.format.empty()) {
+                    transfer.formatDirty = true;
+                }
+            }
+
+            if (!context->queued.exchange(true)) {
+                RetainContext(context);
+                dirty_.push_back(context);
+            }
+        }
+    }
+
+    // Lists the bar in channels_ if it has anything to sample, and takes it
+    // out if not. `wasSampled` is whether it had before. Called with mutex_
+    // held.
+    void UpdateChannel(ProgressBarContext* context, bool wasSampled) {
+        bool sampled = context->sharedProgress || context->segment;
+        if (sampled && !wasSampled) {
+            channels_.push_back(context);
+        } else if (!sampled && wasSampled) {
+            channels_.erase(std::remove(channels_.begin(), channels_.end(), context), channels_.end());
+        }
+    }
+
+    // Reads every attached shared channel and segment and queues the bars
+    // that changed. Runs on the pacer thread with mutex_ held.
+    void SampleSharedProgress() {
+        for (ProgressBarContext* context : channels_) {
+            bool changed = context->segment && SampleSharedSegment(context);
+            if (context->sharedProgress && SampleSharedChannel(context)) {
+                changed = true;
+            }
+
+            if (changed && !context->queued.exchange(true)) {
+                RetainContext(context);
+                dirty_.push_back(context);
+            }
+        }
+    }
+
+    // Returns whether the channel's sequence moved
+    bool SampleSharedChannel(ProgressBarContext* context) {
+        int32_t sequence = context->sharedProgress[kSharedProgressSequence].load(std::memory_order_acquire);
+        if (sequence == context->sharedSequence) {
+            return false;
+        }
+        context->sharedSequence = sequence;
+
+        double progress = context->sharedProgress[kSharedProgressValue].load(std::memory_order_relaxed) /
+                          kSharedProgressScale;
+        Count(context->stats.updatesReceived);
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        if (context->pending.progress != progress) {
+            CountPendingChange(context, context->pending.progressDirty);
+            context->pending.progress = progress;
+            context->pending.progressDirty = true;
+        }
+        return true;
+    }
+
+    // Returns whether another process wrote to the segment. Only what it
+    // wrote since the last frame is applied, so a message alone leaves the
+    // progress to whoever set it last.
+    bool SampleSharedSegment(ProgressBarContext* context) {
+        int32_t scaled;
+        bool messageChanged;
+        if (!ReadSharedSegment(context->segment->layout(), &context->segmentReader, &scaled,
+                               &context->segmentMessage, &messageChanged)) {
+            return false;
+        }
+
+        bool progressChanged = scaled != context->segmentProgress && scaled >= 0;
+        context->segmentProgress = scaled;
+        if (!progressChanged && !messageChanged) {
+            return false;
+        }
+
+        Count(context->stats.updatesReceived);
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        double progress = scaled / kSharedProgressScale;
+        if (progressChanged && context->pending.progress != progress) {
+            CountPendingChange(context, context->pending.progressDirty);
+            context->pending.progress = progress;
+            context->pending.progressDirty = true;
+        }
+        if (messageChanged && context->pending.message != context->segmentMessage) {
+            CountPendingChange(context, context->pending.messageDirty);
+            context->pending.message.assign(context->segmentMessage);
+            context->pending.messageDirty = true;
+        }
+        return true;
+    }
+
+    void Run() {
+        TraceSetThreadName("ProgressBar pacer");
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            cv_.wait(lock, [this] {
+                return stopping_ || (!framePending_ && (!dirty_.empty() || !channels_.empty() ||
+                                                        !animating_.empty() || !ticking_.empty()));
+            });
+            if (stopping_) {
+                break;
+            }
+
+            // Wait out the rest of the current frame; the interval may change
+            // meanwhile. Shared channels and animations still run at the
+            // default rate when pacing is disabled. Bars that only tick wait
+            // for the next tick instead.
+            auto frameEnd = [this] {
+                if (dirty_.empty() && channels_.empty() && animating_.empty()) {
+                    return nextTick_;
+                }
+                if (frameInterval_.count() == 0 && (!channels_.empty() || !animating_.empty())) {
+                    return frameStart_ + kDefaultFrameInterval;
+                }
+                return frameStart_ + frameInterval_;
+            };
+            while (!stopping_ && std::chrono::steady_clock::now() < frameEnd()) {
+                cv_.wait_until(lock, frameEnd());
+            }
+            if (stopping_) {
+                break;
+            }
+
+            SampleSharedProgress();
+            QueueAnimations();
+            QueueTicks(std::chrono::steady_clock::now());
+            if (dirty_.empty()) {
+                frameStart_ = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            framePending_ = true;
+            lock.unlock();
+            if (kUseUiThread) {
+                PostFrame();
+                lock.lock();
+                continue;
+            }
+            if (napi_call_threadsafe_function(tsfn_, nullptr, napi_tsfn_nonblocking) != napi_ok) {
+                lock.lock();
+                framePending_ = false;
+                continue;
+            }
+            lock.lock();
+        }
+    }
+
+    std::atomic<int> refs_{1};
+    napi_env env_ = nullptr;
+    std::thread::id jsThread_;
+    napi_threadsafe_function tsfn_ = nullptr;
+    UiThread ui_;
+    // Posted by the pacer, at most once at a time
+    UiCommand frameCommand_{UiCommand::kFlush};
+    std::atomic<bool> frameQueued_{false};
+    // Only touched on the JS thread
+    int pendingSyncs_ = 0;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<ProgressBarContext*> dirty_;
+    std::vector<ProgressBarContext*> channels_;
+    // Bars with an animation running, see animateTo(). Like channels_, they
+    // hold no reference: closing a bar takes it out.
+    std::vector<ProgressBarContext*> animating_;
+    // Bars with any TickReason, see SetTicking(). No references either.
+    std::vector<ProgressBarContext*> ticking_;
+    std::chrono::steady_clock::time_point nextTick_;
+    std::vector<napi_ref> staleRefs_;
+    // Only touched by Flush(). batchSources_ is index-aligned with batch_.
+    struct BatchSource {
+        ProgressBarContext* context;
+        std::chrono::steady_clock::time_point since;
+    };
+    std::vector<ProgressBarUpdate> batch_;
+    std::vector<BatchSource> batchSources_;
+    bool framePending_ = false;
+    bool stopping_ = false;
+    std::chrono::steady_clock::time_point frameStart_;
+    static constexpr std::chrono::steady_clock::duration kDefaultFrameInterval =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / kDefaultFrameRate));
+    std::chrono::steady_clock::duration frameInterval_ = kDefaultFrameInterval;
+    // Ticks are for things measured in seconds, so a few per second will do
+    static constexpr std::chrono::milliseconds kTickInterval{250};
+};
+
+// Called by backends on the thread that owns them
+static void ButtonClickCallback(void* userData, int buttonIndex) {
+    TraceSpan span("ButtonClickCallback", "button", buttonIndex);
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(userData);
+    if (context && context->isValid.load()) {
+        context->scheduler->PostButtonClick(context, buttonIndex);
+    }
+}
+
+static void RetainContext(ProgressBarContext* context) {
+    context->refs.fetch_add(1);
+}
+
+static void ReleaseContext(ProgressBarContext* context) {
+    if (context->refs.fetch_sub(1) == 1) {
+        {
+            // Nothing can count on the bar anymore
+            std::lock_guard<std::mutex> lock(handles_mutex);
+            closed_contexts.erase(context);
+            context->stats.AddTo(retired_stats);
+        }
+        context->scheduler->Release();
+        delete context;
+        live_contexts.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+static ProgressBarContext* CreateContext(napi_env env, FrameScheduler* scheduler,
+                                         const ProgressBarBackend* backend) {
+    ProgressBarContext* context = new ProgressBarContext();
+    context->env = env;
+    context->scheduler = scheduler;
+    context->backend = backend;
+    scheduler->AddRef();
+    live_contexts.fetch_add(1, std::memory_order_relaxed);
+    return context;
+}
+
+// Adds a context that has just been shown to open_contexts
+static void OpenContext(ProgressBarContext* context) {
+    RetainContext(context);
+    std::lock_guard<std::mutex> lock(handles_mutex);
+    context->id = open_contexts.Insert(context);
+}
+
+// Overwrite the latest state; the scheduler picks it up on the next frame.
+// Safe to call from any thread.
+static void SetPendingProgress(ProgressBarContext* context, double progress) {
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        if (context->pending.progress != progress) {
+            CountPendingChange(context, context->pending.progressDirty);
+            context->pending.progress = progress;
+            context->pending.progressDirty = true;
+        }
+    }
+    context->scheduler->Schedule(context);
+}
+
+// Records a byte count and derives the progress from it. Safe to call from
+// any thread.
+static void SetPendingBytes(ProgressBarContext* context, uint64_t done, uint64_t total) {
+    auto now = TransferRate::Clock::now();
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        TransferState& transfer = context->transfer;
+        if (!transfer.active) {
+            transfer.rate.Reset(done, now);
+            transfer.active = true;
+        } else {
+            transfer.rate.Sample(done, now);
+        }
+        transfer.done = done;
+        transfer.total = total;
+
+        // Computed in double, so transfers of any size resolve to well below
+        // a pixel
+        double progress = total > 0 ? std::min(100.0, 100.0 * done / total) : 0;
+        CountPendingChange(context, context->pending.progressDirty);
+        context->pending.progress = progress;
+        context->pending.progressDirty = true;
+    }
+    context->scheduler->Schedule(context);
+}
+
+// Hands the task tree's progress, and the path of its current task, to the
+// next frame. Called with stateMutex held.
+static void SetPendingTaskState(ProgressBarContext* context) {
+    const TaskTree& tasks = *context->tasks;
+    PendingState& pending = context->pending;
+
+    double progress = tasks.Progress() * 100;
+    if (pending.progress != progress) {
+        CountPendingChange(context, pending.progressDirty);
+        pending.progress = progress;
+        pending.progressDirty = true;
+    }
+
+    uint32_t current = tasks.Current();
+    if (current != context->messageTask) {
+        context->messageTask = current;
+        std::string& message = context->incomingMessage;
+        message.clear();
+        tasks.AppendPath(message, current, " \xe2\x80\xba ");
+        if (message != pending.message) {
+            CountPendingChange(context, pending.messageDirty);
+            pending.message.assign(message);
+            pending.messageDirty = true;
+        }
+    }
+}
+
+static void SetPendingMessage(ProgressBarContext* context, const char* message, size_t length) {
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        std::string& pending = context->pending.message;
+        if (pending.size() == length && memcmp(pending.data(), message, length) == 0) {
+            return;
+        }
+        CountPendingChange(context, context->pending.messageDirty);
+        pending.assign(message, length);
+        context->pending.messageDirty = true;
+    }
+    context->scheduler->Schedule(context);
+}
+
+static napi_status ReadString(napi_env env, napi_value value, std::string* result) {
+    size_t length;
+    napi_status status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+    if (status != napi_ok) return status;
+
+    result->resize(length);
+    return napi_get_value_string_utf8(env, value, &(*result)[0], length + 1, nullptr);
+}
+
+// Decodes a JS string into the context's reusable buffer in a single call,
+// unless it is longer than anything seen before.
+static napi_status ReadMessage(napi_env env, napi_value value, ProgressBarContext* context) {
+    TraceSpan span("ReadMessage");
+    std::string& buffer = context->incomingMessage;
+    buffer.resize(buffer.capacity());
+
+    size_t copied;
+    napi_status status = napi_get_value_string_utf8(env, value, &buffer[0], buffer.size() + 1, &copied);
+    if (status != napi_ok) return status;
+
+    // V8 never writes a partial character, so anything within 4 bytes of the
+    // end may have been cut short
+    if (copied + 4 > buffer.size()) {
+        size_t length;
+        status = napi_get_value_string_utf8(env, value, nullptr, 0, &length);
+        if (status != napi_ok) return status;
+
+        if (length > copied) {
+            buffer.resize(length);
+            status = napi_get_value_string_utf8(env, value, &buffer[0], length + 1, &copied);
+            if (status != napi_ok) return status;
+        }
+    }
+
+    buffer.resize(copied);
+    Count(context->stats.stringBytes, copied);
+    span.SetArg("bytes", static_cast<int64_t>(copied));
+    return napi_ok;
+}
+
+// Native API, see progress_bar_api.h. ProgressBarRef is a ProgressBarContext
+// that the caller holds a reference on.
+static ProgressBarContext* ContextFromRef(ProgressBarRef* bar) {
+    return reinterpret_cast<ProgressBarContext*>(bar);
+}
+
+static ProgressBarRef* NativeApiAcquire(napi_env env, napi_value handle) {
+    void* data;
+    if (napi_get_value_external(env, handle, &data) != napi_ok || data == nullptr) {
+        return nullptr;
+    }
+
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+    if (context->tag != kProgressBarContextTag || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    RetainContext(context);
+    return reinterpret_cast<ProgressBarRef*>(context);
+}
+
+static void NativeApiRelease(ProgressBarRef* bar) {
+    if (bar) {
+        ReleaseContext(ContextFromRef(bar));
+    }
+}
+
+static ProgressBarStatus NativeApiSetProgress(ProgressBarRef* bar, double progress) {
+    if (!bar || !(progress >= 0 && progress <= 100)) {
+        return PROGRESS_BAR_INVALID_ARGUMENT;
+    }
+
+    ProgressBarContext* context = ContextFromRef(bar);
+    if (!context->isValid.load()) {
+        return PROGRESS_BAR_CLOSED;
+    }
+
+    SetPendingProgress(context, progress);
+    return PROGRESS_BAR_OK;
+}
+
+static ProgressBarStatus NativeApiSetMessage(ProgressBarRef* bar, const char* message, size_t length) {
+    if (!bar || (!message && length > 0)) {
+        return PROGRESS_BAR_INVALID_ARGUMENT;
+    }
+
+    ProgressBarContext* context = ContextFromRef(bar);
+    if (!context->isValid.load()) {
+        return PROGRESS_BAR_CLOSED;
+    }
+
+    Count(context->stats.stringBytes, length);
+    SetPendingMessage(context, message ? message : "", length);
+    return PROGRESS_BAR_OK;
+}
+
+static int NativeApiIsClosed(ProgressBarRef* bar) {
+    return !bar || !ContextFromRef(bar)->isValid.load();
+}
+
+static ProgressBarStatus NativeApiSetBytes(ProgressBarRef* bar, uint64_t done, uint64_t total) {
+    if (!bar) {
+        return PROGRESS_BAR_INVALID_ARGUMENT;
+    }
+
+    ProgressBarContext* context = ContextFromRef(bar);
+    if (!context->isValid.load()) {
+        return PROGRESS_BAR_CLOSED;
+    }
+
+    SetPendingBytes(context, done, total);
+    return PROGRESS_BAR_OK;
+}
+
+static const ProgressBarApi kNativeApi = {
+    PROGRESS_BAR_API_VERSION,
+    sizeof(ProgressBarApi),
+    NativeApiAcquire,
+    NativeApiRelease,
+    NativeApiSetProgress,
+    NativeApiSetMessage,
+    NativeApiIsClosed,
+    NativeApiSetBytes,
+};
+
+static void ReleaseButtonCallbacks(napi_env env, ProgressBarContext* context) {
+    std::lock_guard<std::mutex> lock(context->stateMutex);
+    DeleteCallbackRefs(env, context->pending.buttonCallbacks);
+    DeleteCallbackRefs(env, context->applied.buttonCallbacks);
+}
+
+// Reads an array of { label, click } objects
+static napi_status ReadButtons(napi_env env, napi_value value, std::vector<std::string>& labels,
+                               std::vector<napi_ref>& callbacks) {
+    TraceSpan span("ReadButtons");
+    bool isArray;
+    napi_status status = napi_is_array(env, value, &isArray);
+    if (status != napi_ok || !isArray) return status;
+
+    uint32_t length;
+    status = napi_get_array_length(env, value, &length);
+    if (status != napi_ok) return status;
+
+    labels.reserve(length);
+    callbacks.reserve(length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        napi_value buttonObj;
+        status = napi_get_element(env, value, i, &buttonObj);
+        if (status != napi_ok) return status;
+
+        // Get label
+        napi_value labelProp;
+        status = napi_get_named_property(env, buttonObj, "label", &labelProp);
+        if (status != napi_ok) return status;
+
+        size_t labelSize;
+        status = napi_get_value_string_utf8(env, labelProp, nullptr, 0, &labelSize);
+        if (status != napi_ok) return status;
+        std::string label(labelSize, '\0');
+        status = napi_get_value_string_utf8(env, labelProp, &label[0], labelSize + 1, nullptr);
+        if (status != napi_ok) return status;
+
+        // Get callback
+        napi_value clickProp;
+        status = napi_get_named_property(env, buttonObj, "click", &clickProp);
+        if (status != napi_ok) return status;
+
+        napi_ref callbackRef;
+        status = CreateCallbackRef(env, clickProp, &callbackRef);
+        if (status != napi_ok) return status;
+
+        labels.push_back(std::move(label));
+        callbacks.push_back(callbackRef);
+    }
+
+    return napi_ok;
+}
+
+static void ReleaseSharedProgress(napi_env env, ProgressBarContext* context) {
+    if (context->sharedProgressRef) {
+        napi_delete_reference(env, context->sharedProgressRef);
+        context->sharedProgressRef = nullptr;
+        live_buffer_refs.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// Shows the window behind a bar or group
+static void ShowBackendHandle(ProgressBarContext* context, const UiCommand* command) {
+    // Closed before it made it to the screen
+    if (!context->isValid.load()) {
+        return;
+    }
+
+    TraceSpan span("Backend show");
+    const ProgressBarBackend* backend = context->backend;
+    if (context->group) {
+        context->handle = backend->showGroup(command->title.c_str(), command->style.c_str());
+        return;
+    }
+
+    std::vector<const char*> labels;
+    labels.reserve(command->buttonLabels.size());
+    for (const std::string& label : command->buttonLabels) {
+        labels.push_back(label.c_str());
+    }
+
+    void* handle = backend->show(command->title.c_str(), command->message.c_str(), command->style.c_str(),
+                                 labels.data(), labels.size(), ButtonClickCallback, context);
+    if (handle && backend->getPixelWidth) {
+        context->pixelWidth = backend->getPixelWidth(handle);
+    }
+    context->handle = handle;
+}
+
+// Closes the window behind a bar or group
+static void CloseBackendHandle(ProgressBarContext* context) {
+    void* handle = context->handle.exchange(nullptr);
+    if (!handle) {
+        return;
+    }
+
+    TraceSpan span("Backend close");
+    if (context->group) {
+        context->backend->closeGroup(handle);
+    } else {
+        context->backend->close(handle);
+    }
+}
+
+// Runs on the thread that owns the backends
+static void RunUiCommand(UiCommand* command) {
+    ProgressBarContext* context = command->context;
+    switch (command->kind) {
+    case UiCommand::kShow:
+        ShowBackendHandle(context, command);
+        if (context->backend->endFrame) {
+            context->backend->endFrame();
+        }
+        break;
+    case UiCommand::kClose:
+        CloseBackendHandle(context);
+        if (context->backend->endFrame) {
+            context->backend->endFrame();
+        }
+        break;
+    case UiCommand::kFlush:
+        command->scheduler->RunFlushCommand(command);
+        break;
+    case UiCommand::kSync:
+        // Without a context, only there to be waited for
+        if (context) {
+            command->scheduler->PostSyncResult(context, command->deferred, context->handle.load() != nullptr);
+        }
+        break;
+    case UiCommand::kPrewarm: {
+        TraceSpan span("Backend prewarm", "windows", static_cast<int64_t>(command->count));
+        command->backend->prewarm(command->count, command->style.c_str());
+        break;
+    }
+    }
+
+    if (context) {
+        command->context = nullptr;
+        ReleaseContext(context);
+    }
+}
+
+// A command about a context for the thread that owns the backends
+static UiCommand* CreateUiCommand(UiCommand::Kind kind, ProgressBarContext* context) {
+    UiCommand* command = new UiCommand(kind);
+    command->context = context;
+    RetainContext(context);
+    return command;
+}
+
+// Closes a bar or group and drops everything it holds on to, apart from the
+// JS external's reference. Closing twice is harmless. Runs on the JS thread.
+static void CloseContext(napi_env env, ProgressBarContext* context) {
+    if (!context->isValid.exchange(false)) {
+        return;
+    }
+
+    context->scheduler->Cancel(context);
+    ReleaseSharedProgress(env, context);
+    // Writers that still have it open keep writing into their own mapping
+    if (context->segment) {
+        context->segment.reset();
+        live_segments.fetch_sub(1, std::memory_order_relaxed);
+    }
+    ReleaseButtonCallbacks(env, context);
+    context->scheduler->RunOnUiThread(CreateUiCommand(UiCommand::kClose, context));
+
+    bool removed;
+    {
+        std::lock_guard<std::mutex> lock(handles_mutex);
+        removed = open_contexts.Remove(context->id) != nullptr;
+        if (removed) {
+            closed_contexts.insert(context);
+        }
+    }
+    if (removed) {
+        ReleaseContext(context);
+    }
+}
+
+static void FinalizeProgressBar(napi_env env, void* finalize_data, void* finalize_hint) {
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(finalize_data);
+    if (context) {
+        CloseContext(env, context);
+        ReleaseContext(context);
+    }
+}
+
+// Closes whatever the environment still has open
+static void CleanupProgressBars(void* arg) {
+    FrameScheduler* scheduler = static_cast<FrameScheduler*>(arg);
+    scheduler->Stop();
+
+    std::vector<ProgressBarContext*> open;
+    {
+        std::lock_guard<std::mutex> lock(handles_mutex);
+        open_contexts.ForEach([&](uint64_t id, ProgressBarContext* context) {
+            if (context->scheduler == scheduler) {
+                RetainContext(context);
+                open.push_back(context);
+            }
+        });
+    }
+
+    for (ProgressBarContext* context : open) {
+        CloseContext(context->env, context);
+        ReleaseContext(context);
+    }
+
+    scheduler->StopUiThread();
+    scheduler->Release();
+}
+
+// showProgressBar(title, message, style, buttons): queues the window to be
+// shown and returns right away. See syncProgressBar() to wait for it.
+static napi_value ShowProgressBar(napi_env env, napi_callback_info info) {
+    TraceSpan span("ShowProgressBar");
+    size_t argc = 4;
+    napi_value args[4];
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    if (argc < 4) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    std::unique_ptr<UiCommand> command(new UiCommand(UiCommand::kShow));
+    NAPI_CALL(env, ReadString(env, args[0], &command->title));
+    NAPI_CALL(env, ReadString(env, args[1], &command->message));
+    NAPI_CALL(env, ReadString(env, args[2], &command->style));
+
+    // Handle buttons array
+    std::vector<napi_ref> buttonCallbacks;
+    napi_status buttons_status = ReadButtons(env, args[3], command->buttonLabels, buttonCallbacks);
+    if (buttons_status != napi_ok) {
+        DeleteCallbackRefs(env, buttonCallbacks);
+        NAPI_CALL(env, buttons_status);
+    }
+
+    ProgressBarContext* context = CreateContext(env, scheduler, GetCurrentBackend());
+    context->pending.message = command->message;
+    context->applied.message = command->message;
+    context->applied.buttonLabels = command->buttonLabels;
+    context->applied.buttonCallbacks.swap(buttonCallbacks);
+    OpenContext(context);
+
+    command->context = context;
+    RetainContext(context);
+    scheduler->RunOnUiThread(command.release());
+
+    napi_value external;
+    napi_status status = napi_create_external(env, context, FinalizeProgressBar, nullptr, &external);
+    if (status != napi_ok) {
+        CloseContext(env, context);
+        ReleaseContext(context);
+        napi_throw_error(env, nullptr, "Failed to create external");
+        return nullptr;
+    }
+
+    return external;
+}
+
+// updateProgress(handle, fields, progress, message, buttons). Only the
+// arguments named in the `fields` mask are read.
+static napi_value UpdateProgress(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("UpdateProgress");
+
+    size_t argc = 5;
+    napi_value args[5];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+    
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load()) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    uint32_t fields;
+    NAPI_CALL(env, napi_get_value_uint32(env, args[1], &fields));
+
+    if ((fields & kUpdateProgress) && argc >= 3) {
+        double progress;
+        NAPI_CALL(env, napi_get_value_double(env, args[2], &progress));
+        if (!(progress >= 0 && progress <= 100)) {
+            napi_throw_range_error(env, nullptr, "Progress must be between 0 and 100");
+            return nullptr;
+        }
+        SetPendingProgress(context, progress);
+    }
+
+    if ((fields & kUpdateMessage) && argc >= 4) {
+        NAPI_CALL(env, ReadMessage(env, args[3], context));
+        SetPendingMessage(context, context->incomingMessage.data(), context->incomingMessage.size());
+    }
+
+    if ((fields & kUpdateButtons) && argc >= 5) {
+        // Handle buttons array
+        std::vector<std::string> buttonLabels;
+        std::vector<napi_ref> buttonCallbacks;
+        napi_status buttons_status = ReadButtons(env, args[4], buttonLabels, buttonCallbacks);
+        if (buttons_status != napi_ok) {
+            DeleteCallbackRefs(env, buttonCallbacks);
+            NAPI_CALL(env, buttons_status);
+        }
+
+        Count(context->stats.updatesReceived);
+        for (const std::string& label : buttonLabels) {
+            Count(context->stats.stringBytes, label.size());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(context->stateMutex);
+            CountPendingChange(context, context->pending.buttonsDirty);
+            // Buttons that never made it to the screen can't be clicked
+            DeleteCallbackRefs(env, context->pending.buttonCallbacks);
+            context->pending.buttonLabels.swap(buttonLabels);
+            context->pending.buttonCallbacks.swap(buttonCallbacks);
+            context->pending.buttonsDirty = true;
+        }
+        context->scheduler->Schedule(context);
+    }
+
+    return nullptr;
+}
+
+// setIndeterminate(handle, indeterminate): switches between showing the
+// progress and an animation the backend drives by itself
+static napi_value SetIndeterminate(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("SetIndeterminate");
+
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    bool indeterminate;
+    NAPI_CALL(env, napi_get_value_bool(env, args[1], &indeterminate));
+
+    Count(context->stats.updatesReceived);
+    context->indeterminateChange.store(indeterminate ? 1 : 0);
+    context->scheduler->Schedule(context);
+
+    return nullptr;
+}
+
+// setSparkline(handle, enabled): shows how fast the bar moved under it.
+// Returns false, and does nothing, if the bar's backend can't draw one.
+static napi_value SetSparkline(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("SetSparkline");
+
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    bool enabled;
+    NAPI_CALL(env, napi_get_value_bool(env, args[1], &enabled));
+
+    bool supported = context->backend->setSparkline != nullptr;
+    if (supported) {
+        Count(context->stats.updatesReceived);
+        context->sparklineChange.store(enabled ? 1 : 0);
+        context->scheduler->SetTicking(context, kTickSparkline, enabled);
+        context->scheduler->Schedule(context);
+    }
+
+    napi_value result;
+    NAPI_CALL(env, napi_get_boolean(env, supported, &result));
+    return result;
+}
+
+// animateTo(handle, progress, durationMs, easing): moves the progress to
+// `progress` over `durationMs`, one step per frame
+static napi_value AnimateTo(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("AnimateTo");
+
+    size_t argc = 4;
+    napi_value args[4];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 4) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    double progress, durationMs;
+    NAPI_CALL(env, napi_get_value_double(env, args[1], &progress));
+    NAPI_CALL(env, napi_get_value_double(env, args[2], &durationMs));
+    // A NaN would stick to the animation and every frame it produces
+    if (!(progress >= 0 && progress <= 100)) {
+        napi_throw_range_error(env, nullptr, "Progress must be between 0 and 100");
+        return nullptr;
+    }
+    if (!(durationMs >= 0 && std::isfinite(durationMs))) {
+        napi_throw_range_error(env, nullptr, "Duration must be a finite number of milliseconds, 0 or more");
+        return nullptr;
+    }
+
+    char easingName[16];
+    size_t easingLength;
+    NAPI_CALL(env, napi_get_value_string_utf8(env, args[3], easingName, sizeof(easingName), &easingLength));
+    ProgressEasing easing;
+    if (!ParseProgressEasing(easingName, &easing)) {
+        napi_throw_error(env, nullptr, "Unknown easing");
+        return nullptr;
+    }
+
+    if (durationMs == 0) {
+        SetPendingProgress(context, progress);
+        return nullptr;
+    }
+
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        auto now = std::chrono::steady_clock::now();
+        ProgressAnimation& animation = context->animation;
+        // Start from where the bar is, or is about to be
+        double from = animation.Active() ? animation.ValueAt(now) : context->pending.progress;
+        animation.Start(from, progress,
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double, std::milli>(durationMs)),
+                        easing, now);
+        // The new target supersedes whatever progress was still pending
+        context->pending.progressDirty = false;
+    }
+    context->scheduler->Animate(context);
+
+    return nullptr;
+}
+
+// addTask(handle, parentId, name, weight): adds a task to the bar's task
+// tree and returns its id. 0 is the bar itself. The bar's progress follows
+// the tree from then on, and its message the path of the current task.
+static napi_value AddTask(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("AddTask");
+
+    size_t argc = 4;
+    napi_value args[4];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 4) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    uint32_t parent;
+    double weight;
+    std::string name;
+    NAPI_CALL(env, napi_get_value_uint32(env, args[1], &parent));
+    NAPI_CALL(env, ReadString(env, args[2], &name));
+    NAPI_CALL(env, napi_get_value_double(env, args[3], &weight));
+    if (!(weight >= 0 && std::isfinite(weight))) {
+        napi_throw_range_error(env, nullptr, "Task weights must be finite and not negative");
+        return nullptr;
+    }
+
+    Count(context->stats.updatesReceived);
+    Count(context->stats.stringBytes, name.size());
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        if (!context->tasks) {
+            context->tasks.reset(new TaskTree());
+        }
+        if (!context->tasks->Contains(parent)) {
+            napi_throw_range_error(env, nullptr, "Unknown task");
+            return nullptr;
+        }
+        id = context->tasks->Add(parent, std::move(name), weight);
+        SetPendingTaskState(context);
+    }
+    context->scheduler->Schedule(context);
+
+    napi_value result;
+    NAPI_CALL(env, napi_create_uint32(env, id, &result));
+    return result;
+}
+
+// setTaskProgress(handle, id, progress): sets the progress of a task without
+// subtasks, between 0 and 100, and returns the bar's
+static napi_value SetTaskProgress(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("SetTaskProgress");
+
+    size_t argc = 3;
+    napi_value args[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 3) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    uint32_t id;
+    double progress;
+    NAPI_CALL(env, napi_get_value_uint32(env, args[1], &id));
+    NAPI_CALL(env, napi_get_value_double(env, args[2], &progress));
+
+    Count(context->stats.updatesReceived);
+    double overall;
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        TaskTree* tasks = context->tasks.get();
+        if (!tasks || !tasks->Contains(id) || id == TaskTree::kRoot) {
+            napi_throw_range_error(env, nullptr, "Unknown task");
+            return nullptr;
+        }
+        if (!tasks->Set(id, progress / 100)) {
+            napi_throw_error(env, nullptr, "Only tasks without subtasks report progress");
+            return nullptr;
+        }
+        SetPendingTaskState(context);
+        overall = context->pending.progress;
+    }
+    context->scheduler->Schedule(context);
+
+    napi_value result;
+    NAPI_CALL(env, napi_create_double(env, overall, &result));
+    return result;
+}
+
+// setProgress(handle, progress): the fast path, no strings involved
+static napi_value SetProgress(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("SetProgress");
+
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load()) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    double progress;
+    NAPI_CALL(env, napi_get_value_double(env, args[1], &progress));
+    if (!(progress >= 0 && progress <= 100)) {
+        napi_throw_range_error(env, nullptr, "Progress must be between 0 and 100");
+        return nullptr;
+    }
+    SetPendingProgress(context, progress);
+
+    return nullptr;
+}
+
+// setMessage(handle, message)
+static napi_value SetMessage(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("SetMessage");
+
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load()) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    NAPI_CALL(env, ReadMessage(env, args[1], context));
+    SetPendingMessage(context, context->incomingMessage.data(), context->incomingMessage.size());
+
+    return nullptr;
+}
+
+// getProgressBarId(handle): the id to pass to updateMany(), 0 once closed.
+// Ids fit in a JS number, and stop resolving once their bar is closed.
+static napi_value GetProgressBarId(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    uint64_t id = context && context->isValid.load() ? context->id : 0;
+    napi_value result;
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(id), &result));
+    return result;
+}
+
+// updateMany(pairs, messages): updates many bars in one call. `pairs` is a
+// Float64Array of (id, progress) pairs; a NaN progress leaves the progress
+// alone. `messages` is an optional flat array of (pair index, message)
+// entries, for the few bars whose message changed. Unknown or closed ids are
+// skipped, as are bars shown from another thread. Returns the number of
+// pairs that matched an open bar.
+static napi_value UpdateMany(napi_env env, napi_callback_info info) {
+    // Spans many bars, so it only counts globally
+    NapiCallTimer timer;
+    timer.stats = &retired_stats;
+    TraceSpan span("UpdateMany");
+
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    bool isTypedArray;
+    NAPI_CALL(env, napi_is_typedarray(env, args[0], &isTypedArray));
+    if (!isTypedArray) {
+        napi_throw_type_error(env, nullptr, "Expected a Float64Array");
+        return nullptr;
+    }
+
+    napi_typedarray_type arrayType;
+    size_t length;
+    void* data;
+    NAPI_CALL(env, napi_get_typedarray_info(env, args[0], &arrayType, &length, &data, nullptr, nullptr));
+    if (arrayType != napi_float64_array || length % 2 != 0) {
+        napi_throw_type_error(env, nullptr, "Expected a Float64Array of (id, progress) pairs");
+        return nullptr;
+    }
+
+    uint32_t messageLength = 0;
+    if (argc >= 2) {
+        bool isArray;
+        NAPI_CALL(env, napi_is_array(env, args[1], &isArray));
+        if (isArray) {
+            NAPI_CALL(env, napi_get_array_length(env, args[1], &messageLength));
+        }
+    }
+
+    const double* pairs = static_cast<const double*>(data);
+    size_t pairCount = length / 2;
+    uint32_t updated = 0;
+
+    // Ids are resolved up front, holding a reference on each bar, so that no
+    // JS runs under handles_mutex: a getter on `messages` may close a bar.
+    // Only this environment's bars are updated, as their incoming messages
+    // belong to its JS thread.
+    std::vector<ProgressBarContext*> contexts(pairCount, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(handles_mutex);
+        for (size_t i = 0; i < pairCount; i++) {
+            double id = pairs[i * 2];
+            if (!(id >= 1 && id < 9007199254740992.0)) {
+                continue;
+            }
+            // Stale ids of closed bars don't resolve
+            ProgressBarContext* context = open_contexts.Lookup(static_cast<uint64_t>(id));
+            if (!context || context->group || !context->isValid.load() || context->env != env) {
+                continue;
+            }
+            RetainContext(context);
+            contexts[i] = context;
+        }
+    }
+
+    for (size_t i = 0; i < pairCount; i++) {
+        ProgressBarContext* context = contexts[i];
+        if (!context) {
+            continue;
+        }
+
+        updated++;
+        double progress = pairs[i * 2 + 1];
+        if (progress == progress && context->isValid.load()) {
+            SetPendingProgress(context, progress);
+        }
+    }
+
+    napi_status readStatus = napi_ok;
+    std::string text;
+    for (uint32_t i = 0; i + 1 < messageLength && readStatus == napi_ok; i += 2) {
+        napi_value index, message;
+        uint32_t pair;
+        readStatus = napi_get_element(env, args[1], i, &index);
+        if (readStatus == napi_ok) readStatus = napi_get_element(env, args[1], i + 1, &message);
+        if (readStatus == napi_ok) readStatus = napi_get_value_uint32(env, index, &pair);
+        if (readStatus != napi_ok || pair >= pairCount || !contexts[pair]) {
+            continue;
+        }
+
+        readStatus = ReadString(env, message, &text);
+        ProgressBarContext* context = contexts[pair];
+        if (readStatus == napi_ok && context->isValid.load()) {
+            Count(context->stats.stringBytes, text.size());
+            SetPendingMessage(context, text.data(), text.size());
+        }
+    }
+
+    for (ProgressBarContext* context : contexts) {
+        if (context) {
+            ReleaseContext(context);
+        }
+    }
+    NAPI_CALL(env, readStatus);
+
+    napi_value result;
+    NAPI_CALL(env, napi_create_uint32(env, updated, &result));
+    return result;
+}
+
+static napi_value AttachSharedProgress(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load()) {
+        return nullptr;
+    }
+
+    napi_valuetype type;
+    NAPI_CALL(env, napi_typeof(env, args[1], &type));
+    if (type == napi_null || type == napi_undefined) {
+        context->scheduler->SetSharedProgress(context, nullptr);
+        ReleaseSharedProgress(env, context);
+        return nullptr;
+    }
+
+    bool isTypedArray;
+    NAPI_CALL(env, napi_is_typedarray(env, args[1], &isTypedArray));
+    if (!isTypedArray) {
+        napi_throw_type_error(env, nullptr, "Expected an Int32Array");
+        return nullptr;
+    }
+
+    napi_typedarray_type arrayType;
+    size_t length;
+    void* cells;
+    NAPI_CALL(env, napi_get_typedarray_info(env, args[1], &arrayType, &length, &cells, nullptr, nullptr));
+    if (arrayType != napi_int32_array || length < kSharedProgressLength) {
+        napi_throw_type_error(env, nullptr, "Expected an Int32Array with at least 4 elements");
+        return nullptr;
+    }
+
+    // Keep the buffer alive for as long as the scheduler samples it
+    napi_ref ref;
+    NAPI_CALL(env, napi_create_reference(env, args[1], 1, &ref));
+    context->scheduler->SetSharedProgress(context, static_cast<std::atomic<int32_t>*>(cells));
+    ReleaseSharedProgress(env, context);
+    context->sharedProgressRef = ref;
+    live_buffer_refs.fetch_add(1, std::memory_order_relaxed);
+
+    return nullptr;
+}
+
+// createSharedSegment(handle): creates the bar's shared segment, if it has
+// none yet, and returns its name for openSharedSegment() in another process
+static napi_value CreateSharedSegment(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    if (!context->segment) {
+        context->segment.reset(SharedSegment::Create());
+        if (!context->segment) {
+            napi_throw_error(env, nullptr, "Failed to create shared memory");
+            return nullptr;
+        }
+        live_segments.fetch_add(1, std::memory_order_relaxed);
+        context->scheduler->AddSharedSegment(context);
+    }
+
+    const std::string& name = context->segment->name();
+    napi_value result;
+    NAPI_CALL(env, napi_create_string_utf8(env, name.data(), name.size(), &result));
+    return result;
+}
+
+// What openSharedSegment() hands to JS. Empty once closed.
+struct SharedSegmentWriter {
+    std::unique_ptr<SharedSegment> segment;
+};
+
+static void CloseSharedSegmentWriter(SharedSegmentWriter* writer) {
+    if (writer->segment) {
+        writer->segment.reset();
+        live_segments.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+static void FinalizeSharedSegment(napi_env env, void* finalize_data, void* finalize_hint) {
+    SharedSegmentWriter* writer = static_cast<SharedSegmentWriter*>(finalize_data);
+    CloseSharedSegmentWriter(writer);
+    delete writer;
+}
+
+// openSharedSegment(name): maps the segment of a bar in another process, see
+// createSharedSegment(). Returns null if there is no such bar.
+static napi_value OpenSharedSegment(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    std::string name;
+    NAPI_CALL(env, ReadString(env, args[0], &name));
+
+    napi_value result;
+    SharedSegment* segment = SharedSegment::Open(name.c_str());
+    if (!segment) {
+        NAPI_CALL(env, napi_get_null(env, &result));
+        return result;
+    }
+
+    SharedSegmentWriter* writer = new SharedSegmentWriter();
+    writer->segment.reset(segment);
+    live_segments.fetch_add(1, std::memory_order_relaxed);
+    napi_status status = napi_create_external(env, writer, FinalizeSharedSegment, nullptr, &result);
+    if (status != napi_ok) {
+        CloseSharedSegmentWriter(writer);
+        delete writer;
+        napi_throw_error(env, nullptr, "Failed to create external");
+        return nullptr;
+    }
+    return result;
+}
+
+// writeSharedSegment(segment, progress, message): writes either or both,
+// leaving out whichever is undefined, in one go
+static napi_value WriteToSharedSegment(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 3) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    SharedSegmentWriter* writer = static_cast<SharedSegmentWriter*>(data);
+    if (!writer || !writer->segment) {
+        return nullptr;
+    }
+
+    napi_valuetype type;
+    int32_t scaled = 0;
+    bool hasProgress = false;
+    NAPI_CALL(env, napi_typeof(env, args[1], &type));
+    if (type != napi_undefined) {
+        double progress;
+        NAPI_CALL(env, napi_get_value_double(env, args[1], &progress));
+        if (!(progress >= 0)) {
+            progress = 0;
+        }
+        scaled = static_cast<int32_t>(std::lround(std::min(progress, 100.0) * kSharedProgressScale));
+        hasProgress = true;
+    }
+
+    std::string message;
+    bool hasMessage = false;
+    NAPI_CALL(env, napi_typeof(env, args[2], &type));
+    if (type != napi_undefined) {
+        NAPI_CALL(env, ReadString(env, args[2], &message));
+        hasMessage = true;
+    }
+
+    WriteSharedSegment(writer->segment->layout(), hasProgress ? &scaled : nullptr,
+                       hasMessage ? message.data() : nullptr, message.size());
+    return nullptr;
+}
+
+// closeSharedSegment(segment): unmaps a segment from openSharedSegment()
+// without waiting for the garbage collector. Closing twice is harmless.
+static napi_value CloseSharedSegment(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    SharedSegmentWriter* writer = static_cast<SharedSegmentWriter*>(data);
+    if (writer) {
+        CloseSharedSegmentWriter(writer);
+    }
+    return nullptr;
+}
+
+static napi_value SetMaxFrameRate(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    double hz;
+    NAPI_CALL(env, napi_get_value_double(env, args[0], &hz));
+    scheduler->SetMaxFrameRate(hz);
+
+    return nullptr;
+}
+
+static napi_value GetMaxFrameRate(napi_env env, napi_callback_info info) {
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    napi_value result;
+    NAPI_CALL(env, napi_create_double(env, scheduler->GetMaxFrameRate(), &result));
+    return result;
+}
+
+static napi_value CloseProgress(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (context) {
+        CloseContext(env, context);
+    }
+
+    return nullptr;
+}
+
+static napi_status SetNamedDouble(napi_env env, napi_value object, const char* name, double value) {
+    napi_value result;
+    napi_status status = napi_create_double(env, value, &result);
+    if (status != napi_ok) return status;
+    return napi_set_named_property(env, object, name, result);
+}
+
+static napi_status SetNamedString(napi_env env, napi_value object, const char* name, const std::string& value) {
+    napi_value result;
+    napi_status status = napi_create_string_utf8(env, value.c_str(), value.size(), &result);
+    if (status != napi_ok) return status;
+    return napi_set_named_property(env, object, name, result);
+}
+
+// Reads a byte count, which may be a number or a BigInt
+static napi_status ReadByteCount(napi_env env, napi_value value, uint64_t* result) {
+    napi_valuetype type;
+    napi_status status = napi_typeof(env, value, &type);
+    if (status != napi_ok) return status;
+
+    if (type == napi_bigint) {
+        bool lossless;
+        status = napi_get_value_bigint_uint64(env, value, result, &lossless);
+        if (status != napi_ok) return status;
+        return lossless ? napi_ok : napi_invalid_arg;
+    }
+
+    double number;
+    status = napi_get_value_double(env, value, &number);
+    if (status != napi_ok) return status;
+    if (!(number >= 0 && number < 18446744073709551616.0)) {
+        return napi_invalid_arg;
+    }
+
+    *result = static_cast<uint64_t>(number);
+    return napi_ok;
+}
+
+// setBytes(handle, done, total): switches the bar to byte counts. Progress,
+// throughput and the remaining time are all derived from the counts. A total
+// of 0 means the size is unknown. Counts may be numbers or BigInts.
+static napi_value SetBytes(napi_env env, napi_callback_info info) {
+    NapiCallTimer timer;
+    TraceSpan span("SetBytes");
+
+    size_t argc = 3;
+    napi_value args[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 3) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    timer.stats = &context->stats;
+
+    uint64_t done;
+    uint64_t total;
+    if (ReadByteCount(env, args[1], &done) != napi_ok || ReadByteCount(env, args[2], &total) != napi_ok) {
+        napi_throw_range_error(env, nullptr, "Byte counts must be non-negative integers below 2^64");
+        return nullptr;
+    }
+
+    SetPendingBytes(context, done, total);
+    return nullptr;
+}
+
+// setMessageFormat(handle, format): builds the message from the byte counts
+// on every frame. See FormatTransferMessage() for the placeholders. Pass
+// null to go back to the message set with setMessage().
+static napi_value SetMessageFormat(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    if (!context || !context->isValid.load() || context->group) {
+        return nullptr;
+    }
+
+    napi_valuetype type;
+    NAPI_CALL(env, napi_typeof(env, args[1], &type));
+
+    std::string format;
+    if (type == napi_string) {
+        NAPI_CALL(env, ReadString(env, args[1], &format));
+    }
+
+    Count(context->stats.updatesReceived);
+    Count(context->stats.stringBytes, format.size());
+    bool formatted;
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        TransferState& transfer = context->transfer;
+        if (transfer.format == format) {
+            return nullptr;
+        }
+        CountPendingChange(context, transfer.formatDirty);
+        transfer.format.swap(format);
+        transfer.formatDirty = true;
+        formatted = !transfer.format.empty();
+        if (!formatted) {
+            // Put back whatever message was set last
+            context->pending.messageDirty = true;
+        }
+    }
+    // Keeps the rate in the message current while the transfer stalls
+    context->scheduler->SetTicking(context, kTickTransfer, formatted);
+    context->scheduler->Schedule(context);
+
+    return nullptr;
+}
+
+// getTransferStats(handle): { done, total, bytesPerSecond, secondsRemaining }
+// for a bar in byte mode, null otherwise. secondsRemaining is -1 while
+// unknown. Counts above 2^53 lose precision.
+static napi_value GetTransferStats(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    napi_value result;
+    if (!context || context->group) {
+        NAPI_CALL(env, napi_get_null(env, &result));
+        return result;
+    }
+
+    uint64_t done;
+    uint64_t total;
+    double bytesPerSecond;
+    double secondsRemaining;
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        const TransferState& transfer = context->transfer;
+        if (!transfer.active) {
+            NAPI_CALL(env, napi_get_null(env, &result));
+            return result;
+        }
+
+        done = transfer.done;
+        total = transfer.total;
+        auto now = TransferRate::Clock::now();
+        bytesPerSecond = transfer.rate.BytesPerSecond(now);
+        secondsRemaining = total > 0 && done <= total ? transfer.rate.SecondsRemaining(total - done, now) : -1;
+    }
+
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, SetNamedDouble(env, result, "done", static_cast<double>(done)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "total", static_cast<double>(total)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "bytesPerSecond", bytesPerSecond));
+    NAPI_CALL(env, SetNamedDouble(env, result, "secondsRemaining", secondsRemaining));
+    return result;
+}
+
+// getProgressHistory(handle): the bar's ProgressHistory up to now, as
+// Float64Arrays over a single buffer, one entry per bucket. Times are
+// seconds since the first progress the bar showed. Null for groups.
+static napi_value GetProgressHistory(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    void* data;
+    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+
+    napi_value result;
+    if (!context || context->group) {
+        NAPI_CALL(env, napi_get_null(env, &result));
+        return result;
+    }
+
+    // A copy is a few kilobytes, and keeps the lock short
+    ProgressHistory history;
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        context->history.Advance(HistorySeconds(std::chrono::steady_clock::now()));
+        history = context->history;
+    }
+
+    static const char* const kFields[] = { "time", "progress", "minimum", "maximum", "rate" };
+    static const size_t kFieldCount = sizeof(kFields) / sizeof(kFields[0]);
+    size_t count = history.size();
+
+    void* bytes;
+    napi_value buffer;
+    NAPI_CALL(env, napi_create_arraybuffer(env, kFieldCount * count * sizeof(double), &bytes, &buffer));
+    double* values = static_cast<double*>(bytes);
+    for (size_t i = 0; i < count; i++) {
+        const ProgressHistory::Bucket& bucket = history[i];
+        values[i] = i * history.interval();
+        values[count + i] = bucket.last;
+        values[2 * count + i] = bucket.min;
+        values[3 * count + i] = bucket.max;
+        values[4 * count + i] = history.RateAt(i);
+    }
+
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, SetNamedDouble(env, result, "interval", history.interval()));
+    for (size_t field = 0; field < kFieldCount; field++) {
+        napi_value array;
+        NAPI_CALL(env, napi_create_typedarray(env, napi_float64_array, count, buffer,
+                                              field * count * sizeof(double), &array));
+        NAPI_CALL(env, napi_set_named_property(env, result, kFields[field], array));
+    }
+    return result;
+}
+
+// The entry for a row in this frame's batch. Call with stateMutex held.
+static PendingRow& GetPendingRow(ProgressGroupState& group, uint32_t id) {
+    auto it = group.pendingIndex.find(id);
+    if (it != group.pendingIndex.end()) {
+        return group.pending[it->second];
+    }
+
+    group.pendingIndex.emplace(id, group.pending.size());
+    group.pending.emplace_back();
+    group.pending.back().id = id;
+    return group.pending.back();
+}
+
+static ProgressBarContext* GetGroupContext(napi_env env, napi_value value) {
+    void* data;
+    if (napi_get_value_external(env, value, &data) != napi_ok) {
+        return nullptr;
+    }
+
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+    if (!context || !context->isValid.load() || !context->group) {
+        return nullptr;
+    }
+
+    return context;
+}
+
+// showProgressGroup(title, style)
+static napi_value ShowProgressGroup(napi_env env, napi_callback_info info) {
+    TraceSpan span("ShowProgressGroup");
+    size_t argc = 2;
+    napi_value args[2];
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    std::string title, style;
+    NAPI_CALL(env, ReadString(env, args[0], &title));
+    NAPI_CALL(env, ReadString(env, args[1], &style));
+
+    ProgressBarContext* context = CreateContext(env, scheduler, GetCurrentBackend());
+    context->group.reset(new ProgressGroupState());
+    OpenContext(context);
+
+    UiCommand* command = CreateUiCommand(UiCommand::kShow, context);
+    command->title.swap(title);
+    command->style.swap(style);
+    scheduler->RunOnUiThread(command);
+
+    // Only known right away if the JS thread owns the backends
+    if (!kUseUiThread && !context->handle) {
+        CloseContext(env, context);
+        ReleaseContext(context);
+        napi_throw_error(env, nullptr, "Failed to show progress group");
+        return nullptr;
+    }
+
+    napi_value external;
+    napi_status status = napi_create_external(env, context, FinalizeProgressBar, nullptr, &external);
+    if (status != napi_ok) {
+        CloseContext(env, context);
+        ReleaseContext(context);
+        napi_throw_error(env, nullptr, "Failed to create external");
+        return nullptr;
+    }
+
+    return external;
+}
+
+// addProgressGroupRow(handle, id, progress, message). Rows are appended at
+// the bottom.
+static napi_value AddProgressGroupRow(napi_env env, napi_callback_info info) {
+    size_t argc = 4;
+    napi_value args[4];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 4) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    ProgressBarContext* context = GetGroupContext(env, args[0]);
+    if (!context) {
+        return nullptr;
+    }
+
+    uint32_t id;
+    double progress;
+    NAPI_CALL(env, napi_get_value_uint32(env, args[1], &id));
+    NAPI_CALL(env, napi_get_value_double(env, args[2], &progress));
+    NAPI_CALL(env, ReadMessage(env, args[3], context));
+
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        PendingRow& row = GetPendingRow(*context->group, id);
+        CountPendingChange(context, row.fields != 0);
+        row.fields = (row.fields & kRowRemoved) | kRowAdded | kUpdateProgress | kUpdateMessage;
+        row.progress = progress;
+        row.message.assign(context->incomingMessage);
+    }
+    context->scheduler->Schedule(context);
+
+    return nullptr;
+}
+
+// updateProgressGroupRow(handle, id, fields, progress, message), with the
+// same field mask as updateProgress()
+static napi_value UpdateProgressGroupRow(napi_env env, napi_callback_info info) {
+    size_t argc = 5;
+    napi_value args[5];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 3) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    ProgressBarContext* context = GetGroupContext(env, args[0]);
+    if (!context) {
+        return nullptr;
+    }
 
-struct ProgressBarContext {
-    void* handle;
-    std::atomic<bool> isValid{true};
-};
+    uint32_t id, fields;
+    NAPI_CALL(env, napi_get_value_uint32(env, args[1], &id));
+    NAPI_CALL(env, napi_get_value_uint32(env, args[2], &fields));
 
-static std::vector<void*> active_handles;
-static std::mutex handles_mutex;
+    double progress = 0;
+    if ((fields & kUpdateProgress) && argc >= 4) {
+        NAPI_CALL(env, napi_get_value_double(env, args[3], &progress));
+    } else {
+        fields &= ~kUpdateProgress;
+    }
 
-struct ButtonCallbackInfo {
-    napi_env env;
-    napi_ref callback;
-};
+    if ((fields & kUpdateMessage) && argc >= 5) {
+        NAPI_CALL(env, ReadMessage(env, args[4], context));
+    } else {
+        fields &= ~kUpdateMessage;
+    }
 
-std::vector<ButtonCallbackInfo> buttonCallbacks;
-
-void ButtonClickCallback(int buttonIndex) {
-    if (buttonIndex >= 0 && static_cast<size_t>(buttonIndex) < buttonCallbacks.size()) {
-        auto& info = buttonCallbacks[buttonIndex];
-        
-        napi_handle_scope scope;
-        napi_open_handle_scope(info.env, &scope);
-        
-        napi_value callback;
-        napi_get_reference_value(info.env, info.callback, &callback);
-        
-        napi_value global;
-        napi_get_global(info.env, &global);
-        
-        napi_value result;
-        napi_call_function(info.env, global, callback, 0, nullptr, &result);
-        
-        napi_close_handle_scope(info.env, scope);
+    if (!fields) {
+        return nullptr;
     }
-}
 
-static void FinalizeProgressBar(napi_env env, void* finalize_data, void* finalize_hint) {
-    ProgressBarContext* context = static_cast<ProgressBarContext*>(finalize_data);
-    if (context && context->isValid.exchange(false)) {
-        if (context->handle) {
-#ifdef __APPLE__
-            CloseProgressBarMacOS(context->handle);
-#elif defined(_WIN32)
-            CloseProgressBarWindows(context->handle);
-#endif
-            context->handle = nullptr;
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        PendingRow& row = GetPendingRow(*context->group, id);
+        if ((row.fields & kRowRemoved) && !(row.fields & kRowAdded)) {
+            return nullptr;
         }
-        delete context;
+        CountPendingChange(context, (row.fields & fields) != 0);
+
+        if (fields & kUpdateProgress) {
+            row.progress = progress;
+        }
+        if (fields & kUpdateMessage) {
+            row.message.assign(context->incomingMessage);
+        }
+        row.fields |= fields & (kUpdateProgress | kUpdateMessage);
     }
+    context->scheduler->Schedule(context);
+
+    return nullptr;
 }
 
-static void CleanupProgressBars(void* arg) {
-    std::lock_guard<std::mutex> lock(handles_mutex);
-    for (void* handle : active_handles) {
-        if (handle) {
-#ifdef __APPLE__
-            CloseProgressBarMacOS(handle);
-#elif defined(_WIN32)
-            CloseProgressBarWindows(handle);
-#endif
+// removeProgressGroupRow(handle, id)
+static napi_value RemoveProgressGroupRow(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    ProgressBarContext* context = GetGroupContext(env, args[0]);
+    if (!context) {
+        return nullptr;
+    }
+
+    uint32_t id;
+    NAPI_CALL(env, napi_get_value_uint32(env, args[1], &id));
+
+    Count(context->stats.updatesReceived);
+    {
+        std::lock_guard<std::mutex> lock(context->stateMutex);
+        PendingRow& row = GetPendingRow(*context->group, id);
+        CountPendingChange(context, row.fields != 0);
+        if ((row.fields & kRowAdded) && !(row.fields & kRowRemoved)) {
+            // The row never made it to the window
+            row.fields = 0;
+        } else {
+            row.fields = kRowRemoved;
         }
     }
-    active_handles.clear();
+    context->scheduler->Schedule(context);
+
+    return nullptr;
 }
 
-static napi_value ShowProgressBar(napi_env env, napi_callback_info info) {
-    size_t argc = 4;
-    napi_value args[4];
+static napi_value SetBackend(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
     NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
 
-    if (argc < 4) {
+    if (argc < 1) {
         napi_throw_error(env, nullptr, "Wrong number of arguments");
         return nullptr;
     }
 
-    size_t title_size;
-    NAPI_CALL(env, napi_get_value_string_utf8(env, args[0], nullptr, 0, &title_size));
-    char* title = new char[title_size + 1];
-    NAPI_CALL(env, napi_get_value_string_utf8(env, args[0], title, title_size + 1, nullptr));
+    char name[64];
+    NAPI_CALL(env, napi_get_value_string_utf8(env, args[0], name, sizeof(name), nullptr));
 
-    size_t message_size;
-    NAPI_CALL(env, napi_get_value_string_utf8(env, args[1], nullptr, 0, &message_size));
-    char* message = new char[message_size + 1];
-    NAPI_CALL(env, napi_get_value_string_utf8(env, args[1], message, message_size + 1, nullptr));
+    const ProgressBarBackend* backend = FindBackend(name);
+    if (!backend) {
+        napi_throw_error(env, nullptr, "Unknown progress bar backend");
+        return nullptr;
+    }
+    current_backend.store(backend);
 
-    size_t style_size;
-    NAPI_CALL(env, napi_get_value_string_utf8(env, args[2], nullptr, 0, &style_size));
-    char* style = new char[style_size + 1];
-    NAPI_CALL(env, napi_get_value_string_utf8(env, args[2], style, style_size + 1, nullptr));
+    return nullptr;
+}
 
-    // Handle buttons array
-    bool isArray;
-    NAPI_CALL(env, napi_is_array(env, args[3], &isArray));
-    
-    std::vector<std::string> buttonLabels;
-    std::vector<const char*> buttonLabelPtrs;
-    buttonCallbacks.clear();
-
-    if (isArray) {
-        uint32_t length;
-        NAPI_CALL(env, napi_get_array_length(env, args[3], &length));
-        
-        // Pre-allocate to prevent reallocations
-        buttonLabels.reserve(length);
-        buttonLabelPtrs.reserve(length);
-        
-        for (uint32_t i = 0; i < length; i++) {
-            napi_value buttonObj;
-            NAPI_CALL(env, napi_get_element(env, args[3], i, &buttonObj));
-            
-            // Get label
-            napi_value labelProp;
-            NAPI_CALL(env, napi_get_named_property(env, buttonObj, "label", &labelProp));
-            
-            size_t labelSize;
-            NAPI_CALL(env, napi_get_value_string_utf8(env, labelProp, nullptr, 0, &labelSize));
-            std::string label(labelSize + 1, '\0');
-            NAPI_CALL(env, napi_get_value_string_utf8(env, labelProp, &label[0], label.size(), nullptr));
-            
-            // Store string in buttonLabels
-            buttonLabels.push_back(label);
-            // Create a persistent copy of the string
-            buttonLabelPtrs.push_back(strdup(label.c_str()));
-            
-            // Store callback
-            napi_value clickProp;
-            NAPI_CALL(env, napi_get_named_property(env, buttonObj, "click", &clickProp));
-            
-            napi_ref callbackRef;
-            NAPI_CALL(env, napi_create_reference(env, clickProp, 1, &callbackRef));
-            
-            ButtonCallbackInfo callbackInfo = { env, callbackRef };
-            buttonCallbacks.push_back(callbackInfo);
-        }
+static napi_value GetBackend(napi_env env, napi_callback_info info) {
+    napi_value result;
+    NAPI_CALL(env, napi_create_string_utf8(env, GetCurrentBackend()->name, NAPI_AUTO_LENGTH, &result));
+    return result;
+}
+
+static napi_value GetBackends(napi_env env, napi_callback_info info) {
+    napi_value result;
+    NAPI_CALL(env, napi_create_array(env, &result));
+
+    uint32_t index = 0;
+    for (const ProgressBarBackend& backend : kBackends) {
+        napi_value name;
+        NAPI_CALL(env, napi_create_string_utf8(env, backend.name, NAPI_AUTO_LENGTH, &name));
+        NAPI_CALL(env, napi_set_element(env, result, index++, name));
     }
 
-    ProgressBarContext* context = new ProgressBarContext();
-#ifdef __APPLE__
-    context->handle = ShowProgressBarMacOS(
-        title, 
-        message, 
-        style, 
-        buttonLabelPtrs.data(), 
-        buttonLabelPtrs.size(), 
-        ButtonClickCallback
-    );
-#elif defined(_WIN32)
-    context->handle = ShowProgressBarWindows(
-        title,
-        message,
-        style,
-        buttonLabelPtrs.data(),
-        buttonLabelPtrs.size(),
-        ButtonClickCallback
-    );
+    return result;
+}
+
+// Sums up the stats of every bar, open or closed, and those that aren't tied
+// to a bar
+static void CollectStats(ProgressStats& total) {
+    std::lock_guard<std::mutex> lock(handles_mutex);
+    retired_stats.AddTo(total);
+    open_contexts.ForEach([&total](uint64_t, ProgressBarContext* context) {
+        context->stats.AddTo(total);
+    });
+    for (ProgressBarContext* context : closed_contexts) {
+        context->stats.AddTo(total);
+    }
+}
+
+// Lifecycle counters, to spot leaks
+static napi_value GetDiagnostics(napi_env env, napi_callback_info info) {
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    // Count what has really been released, not what is still on its way
+    scheduler->CatchUp();
+
+    size_t open, peak, capacity;
+    {
+        std::lock_guard<std::mutex> lock(handles_mutex);
+        open = open_contexts.Size();
+        peak = open_contexts.Peak();
+        capacity = open_contexts.Capacity();
+    }
+
+    ProgressStats stats;
+    CollectStats(stats);
+
+    int64_t callbacks = live_callback_refs.load();
+    napi_value result, callback_refs, refs, segments, contexts, open_handles, peak_handles, handle_capacity,
+        suppressed;
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(callbacks), &callback_refs));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(callbacks + live_buffer_refs.load()), &refs));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(live_segments.load()), &segments));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(live_contexts.load()), &contexts));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(open), &open_handles));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(peak), &peak_handles));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(capacity), &handle_capacity));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(stats.updatesSuppressed.load()), &suppressed));
+    NAPI_CALL(env, napi_set_named_property(env, result, "liveCallbackReferences", callback_refs));
+    NAPI_CALL(env, napi_set_named_property(env, result, "liveReferences", refs));
+    NAPI_CALL(env, napi_set_named_property(env, result, "liveSharedSegments", segments));
+    NAPI_CALL(env, napi_set_named_property(env, result, "liveContexts", contexts));
+    NAPI_CALL(env, napi_set_named_property(env, result, "openHandles", open_handles));
+    NAPI_CALL(env, napi_set_named_property(env, result, "peakOpenHandles", peak_handles));
+    NAPI_CALL(env, napi_set_named_property(env, result, "handleCapacity", handle_capacity));
+    NAPI_CALL(env, napi_set_named_property(env, result, "suppressedUpdates", suppressed));
+
+#ifdef PROGRESS_BAR_HAS_MALLINFO2
+    // What malloc has handed out to the whole process and not gotten back.
+    // Unlike RSS, it doesn't count freed memory the allocator holds on to.
+    struct mallinfo2 heap = mallinfo2();
+    napi_value heap_in_use;
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(heap.uordblks + heap.hblkhd), &heap_in_use));
+    NAPI_CALL(env, napi_set_named_property(env, result, "heapInUse", heap_in_use));
 #endif
 
-    delete[] title;
-    delete[] message;
-    delete[] style;
+    return result;
+}
 
-    napi_value external;
-    napi_status status = napi_create_external(env, context, FinalizeProgressBar, nullptr, &external);
-    if (status != napi_ok) {
-        delete context;
-        napi_throw_error(env, nullptr, "Failed to create external");
+static napi_status SetLatencyHistogram(napi_env env, napi_value object, const LatencyHistogram& histogram) {
+    napi_value latency, buckets, limits;
+    napi_status status = napi_create_object(env, &latency);
+    if (status != napi_ok) return status;
+
+    uint64_t count = histogram.SampleCount();
+    double mean = count > 0 ? histogram.SumMicros() / 1000.0 / count : 0;
+    if ((status = SetNamedDouble(env, latency, "count", static_cast<double>(count))) != napi_ok ||
+        (status = SetNamedDouble(env, latency, "mean", mean)) != napi_ok ||
+        (status = SetNamedDouble(env, latency, "max", histogram.MaxMicros() / 1000.0)) != napi_ok ||
+        (status = SetNamedDouble(env, latency, "p50", histogram.Quantile(0.5) / 1000.0)) != napi_ok ||
+        (status = SetNamedDouble(env, latency, "p90", histogram.Quantile(0.9) / 1000.0)) != napi_ok ||
+        (status = SetNamedDouble(env, latency, "p99", histogram.Quantile(0.99) / 1000.0)) != napi_ok) {
+        return status;
+    }
+
+    if ((status = napi_create_array_with_length(env, LatencyHistogram::kBuckets, &buckets)) != napi_ok ||
+        (status = napi_create_array_with_length(env, LatencyHistogram::kBuckets, &limits)) != napi_ok) {
+        return status;
+    }
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; i++) {
+        uint64_t limit = LatencyHistogram::BucketLimit(i);
+        napi_value bucket, bucket_limit;
+        if ((status = napi_create_double(env, static_cast<double>(histogram.Bucket(i)), &bucket)) != napi_ok ||
+            (status = napi_create_double(env, limit > 0 ? limit / 1000.0 : INFINITY, &bucket_limit)) != napi_ok ||
+            (status = napi_set_element(env, buckets, static_cast<uint32_t>(i), bucket)) != napi_ok ||
+            (status = napi_set_element(env, limits, static_cast<uint32_t>(i), bucket_limit)) != napi_ok) {
+            return status;
+        }
+    }
+
+    if ((status = napi_set_named_property(env, latency, "buckets", buckets)) != napi_ok ||
+        (status = napi_set_named_property(env, latency, "bucketLimits", limits)) != napi_ok) {
+        return status;
+    }
+    return napi_set_named_property(env, object, "latency", latency);
+}
+
+// getStats(handle?): the stats of one bar or group, or with no handle the
+// totals across all of them. Times are in milliseconds.
+static napi_value GetStats(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    napi_valuetype type = napi_undefined;
+    if (argc >= 1) {
+        NAPI_CALL(env, napi_typeof(env, args[0], &type));
+    }
+
+    // Include whatever the UI thread has been handed so far
+    scheduler->CatchUp();
+
+    ProgressStats total;
+    const ProgressStats* stats = &total;
+    if (type == napi_external) {
+        void* data;
+        NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
+        stats = &static_cast<ProgressBarContext*>(data)->stats;
+    } else {
+        CollectStats(total);
+    }
+
+    napi_value result;
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, SetNamedDouble(env, result, "updatesReceived", static_cast<double>(stats->updatesReceived.load())));
+    NAPI_CALL(env, SetNamedDouble(env, result, "updatesCoalesced", static_cast<double>(stats->updatesCoalesced.load())));
+    NAPI_CALL(env, SetNamedDouble(env, result, "updatesSuppressed", static_cast<double>(stats->updatesSuppressed.load())));
+    NAPI_CALL(env, SetNamedDouble(env, result, "stringBytes", static_cast<double>(stats->stringBytes.load())));
+    NAPI_CALL(env, SetNamedDouble(env, result, "nativeCalls", static_cast<double>(stats->napiCalls.load())));
+    NAPI_CALL(env, SetNamedDouble(env, result, "nativeTime", stats->napiNanoseconds.load() / 1e6));
+    NAPI_CALL(env, SetNamedDouble(env, result, "backendDispatches", static_cast<double>(stats->backendDispatches.load())));
+    if (stats == &total) {
+        NAPI_CALL(env, SetNamedDouble(env, result, "backendCalls", static_cast<double>(stats->backendCalls.load())));
+    }
+    NAPI_CALL(env, SetLatencyHistogram(env, result, stats->latency));
+
+    const ProgressBarBackend* backend = GetCurrentBackend();
+    if (stats == &total && backend->getPoolStats) {
+        WindowPoolStats pool = {};
+        backend->getPoolStats(&pool);
+
+        napi_value windowPool;
+        NAPI_CALL(env, napi_create_object(env, &windowPool));
+        NAPI_CALL(env, SetNamedDouble(env, windowPool, "idle", static_cast<double>(pool.idle)));
+        NAPI_CALL(env, SetNamedDouble(env, windowPool, "size", static_cast<double>(pool.target)));
+        NAPI_CALL(env, SetNamedDouble(env, windowPool, "hits", static_cast<double>(pool.hits)));
+        NAPI_CALL(env, SetNamedDouble(env, windowPool, "misses", static_cast<double>(pool.misses)));
+        NAPI_CALL(env, SetNamedDouble(env, windowPool, "savedTime", pool.savedNanoseconds / 1e6));
+        NAPI_CALL(env, napi_set_named_property(env, result, "windowPool", windowPool));
+    }
+
+    return result;
+}
+
+// prewarm(count, style): keeps `count` windows of the current backend built
+// and hidden, so that the next bars show without building one
+static napi_value Prewarm(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
         return nullptr;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(handles_mutex);
-        active_handles.push_back(context->handle);
+    const ProgressBarBackend* backend = GetCurrentBackend();
+    if (!backend->prewarm) {
+        return nullptr;
     }
 
-    for (const char* ptr : buttonLabelPtrs) {
-        free((void*)ptr);
+    double count;
+    NAPI_CALL(env, napi_get_value_double(env, args[0], &count));
+    if (!(count >= 0)) {
+        napi_throw_error(env, nullptr, "Count can't be negative");
+        return nullptr;
     }
 
-    return external;
+    std::string style;
+    NAPI_CALL(env, ReadString(env, args[1], &style));
+
+    UiCommand* command = new UiCommand(UiCommand::kPrewarm);
+    command->backend = backend;
+    command->count = static_cast<size_t>(count);
+    command->style.swap(style);
+    scheduler->RunOnUiThread(command);
+
+    return nullptr;
 }
 
-static napi_value UpdateProgress(napi_env env, napi_callback_info info) {
-    size_t argc = 5;
-    napi_value args[5];
+// setTracing(enabled): starts or stops recording trace events. Starting
+// again drops whatever was recorded before.
+static napi_value SetTracingEnabled(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
     NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
-    
+
+    bool enabled = false;
+    if (argc >= 1) {
+        NAPI_CALL(env, napi_get_value_bool(env, args[0], &enabled));
+    }
+    SetTracing(enabled);
+
+    return nullptr;
+}
+
+static napi_value GetTracingEnabled(napi_env env, napi_callback_info info) {
+    napi_value result;
+    NAPI_CALL(env, napi_get_boolean(env, IsTracing(), &result));
+    return result;
+}
+
+// getTrace(): the events recorded since tracing was turned on, as Chrome
+// trace_event JSON
+static napi_value GetTrace(napi_env env, napi_callback_info info) {
+    std::string json;
+    AppendTraceJson(json, static_cast<uint64_t>(uv_os_getpid()));
+
+    napi_value result;
+    NAPI_CALL(env, napi_create_string_utf8(env, json.data(), json.size(), &result));
+    return result;
+}
+
+// Applies all pending updates right away instead of waiting for the next frame
+static napi_value Flush(napi_env env, napi_callback_info info) {
+    FrameScheduler* scheduler;
+    NAPI_CALL(env, napi_get_cb_info(env, info, nullptr, nullptr, nullptr, reinterpret_cast<void**>(&scheduler)));
+
+    scheduler->FlushNow();
+
+    return nullptr;
+}
+
+// syncProgressBar(handle): a Promise that resolves once the thread that owns
+// the backends has caught up with everything queued for the bar or group so
+// far. Resolves with whether it has a window, which is false if it couldn't
+// be shown or has been closed.
+static napi_value SyncProgressBar(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
     void* data;
     NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
     ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
 
-    if (!context || !context->isValid.load() || !context->handle) {
+    napi_deferred deferred;
+    napi_value promise;
+    NAPI_CALL(env, napi_create_promise(env, &deferred, &promise));
+    context->scheduler->Sync(env, context, deferred);
+
+    return promise;
+}
+
+#ifdef PROGRESS_BAR_ALLOC_STATS
+static napi_value GetAllocationStats(napi_env env, napi_callback_info info) {
+    ProgressBarAllocationStats stats;
+    GetProgressBarAllocationStats(&stats);
+
+    napi_value result, allocations, deallocations, allocated_bytes;
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(stats.allocations), &allocations));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(stats.deallocations), &deallocations));
+    NAPI_CALL(env, napi_create_double(env, static_cast<double>(stats.allocatedBytes), &allocated_bytes));
+    NAPI_CALL(env, napi_set_named_property(env, result, "allocations", allocations));
+    NAPI_CALL(env, napi_set_named_property(env, result, "deallocations", deallocations));
+    NAPI_CALL(env, napi_set_named_property(env, result, "allocatedBytes", allocated_bytes));
+
+    return result;
+}
+#endif
+
+#ifdef __linux__
+static ProgressBarContext* GetHeadlessContext(napi_env env, napi_value value) {
+    void* data;
+    if (napi_get_value_external(env, value, &data) != napi_ok) {
+        return nullptr;
+    }
+
+    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+    if (!context || !context->isValid.load()) {
+        return nullptr;
+    }
+
+    // Report what the backend has been told so far, shown included
+    context->scheduler->CatchUp();
+    if (!context->handle || context->backend->show != ShowProgressBarLinux) {
         return nullptr;
     }
 
-    int32_t progress;
-    NAPI_CALL(env, napi_get_value_int32(env, args[1], &progress));
+    return context;
+}
+
+// Returns what a headless bar has recorded, or null if the bar is closed or
+// isn't headless. Timestamps are in milliseconds on the process.hrtime clock.
+static napi_value GetHeadlessState(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
 
-    // Extract message
-    char* message = nullptr;
-    if (argc >= 3 && args[2] != nullptr) {
-        size_t message_size;
-        NAPI_CALL(env, napi_get_value_string_utf8(env, args[2], nullptr, 0, &message_size));
-        message = new char[message_size + 1];
-        NAPI_CALL(env, napi_get_value_string_utf8(env, args[2], message, message_size + 1, nullptr));
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
     }
 
-    // Get update buttons flag
-    bool updateButtons = false;
-    if (argc >= 4) {
-        NAPI_CALL(env, napi_get_value_bool(env, args[3], &updateButtons));
+    napi_value result;
+    NAPI_CALL(env, napi_get_null(env, &result));
+
+    ProgressBarContext* context = GetHeadlessContext(env, args[0]);
+    HeadlessProgressBarSnapshot snapshot;
+    std::vector<HeadlessProgressBarUpdate> history;
+    if (!context || !GetProgressBarSnapshotLinux(context->handle, &snapshot, &history)) {
+        return result;
     }
 
-    // Handle buttons array
-    std::vector<std::string> buttonLabels;
-    std::vector<const char*> buttonLabelPtrs;
-    
-    if (argc >= 5 && updateButtons) {
-        bool isArray;
-        NAPI_CALL(env, napi_is_array(env, args[4], &isArray));
-        
-        if (isArray) {
-            uint32_t length;
-            NAPI_CALL(env, napi_get_array_length(env, args[4], &length));
-            
-            // Clear existing callbacks when updating buttons
-            buttonCallbacks.clear();
-            
-            for (uint32_t i = 0; i < length; i++) {
-                napi_value buttonObj;
-                NAPI_CALL(env, napi_get_element(env, args[4], i, &buttonObj));
-                
-                // Get label
-                napi_value labelProp;
-                NAPI_CALL(env, napi_get_named_property(env, buttonObj, "label", &labelProp));
-                
-                size_t labelSize;
-                NAPI_CALL(env, napi_get_value_string_utf8(env, labelProp, nullptr, 0, &labelSize));
-                std::string label(labelSize + 1, '\0');
-                NAPI_CALL(env, napi_get_value_string_utf8(env, labelProp, &label[0], label.size(), nullptr));
-                
-                buttonLabels.push_back(label);
-                buttonLabelPtrs.push_back(buttonLabels.back().c_str());
-                
-                // Store callback
-                napi_value clickProp;
-                NAPI_CALL(env, napi_get_named_property(env, buttonObj, "click", &clickProp));
-                
-                // Create a new reference for each callback
-                napi_ref callbackRef;
-                NAPI_CALL(env, napi_create_reference(env, clickProp, 1, &callbackRef));
-                
-                ButtonCallbackInfo callbackInfo = { env, callbackRef };
-                buttonCallbacks.push_back(callbackInfo);
-            }
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, SetNamedString(env, result, "title", snapshot.title));
+    NAPI_CALL(env, SetNamedString(env, result, "message", snapshot.message));
+    NAPI_CALL(env, SetNamedString(env, result, "style", snapshot.style));
+    NAPI_CALL(env, SetNamedDouble(env, result, "progress", snapshot.progress));
+    napi_value indeterminate;
+    NAPI_CALL(env, napi_get_boolean(env, snapshot.indeterminate, &indeterminate));
+    NAPI_CALL(env, napi_set_named_property(env, result, "indeterminate", indeterminate));
+    NAPI_CALL(env, SetNamedDouble(env, result, "animationFrame", static_cast<double>(snapshot.animationFrame)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "updateCount", static_cast<double>(snapshot.updateCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "messageUpdateCount", static_cast<double>(snapshot.messageUpdateCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "buttonUpdateCount", static_cast<double>(snapshot.buttonUpdateCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "sparklineUpdateCount", static_cast<double>(snapshot.sparklineUpdateCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "contentHeight", snapshot.contentHeight));
+    NAPI_CALL(env, SetNamedDouble(env, result, "layoutOpCount", static_cast<double>(snapshot.layoutOpCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "shownAt", snapshot.shownAt / 1e6));
+    NAPI_CALL(env, SetNamedDouble(env, result, "lastUpdateAt", snapshot.lastUpdateAt / 1e6));
+
+    napi_value buttons;
+    NAPI_CALL(env, napi_create_array_with_length(env, snapshot.buttonLabels.size(), &buttons));
+    for (size_t i = 0; i < snapshot.buttonLabels.size(); i++) {
+        napi_value label;
+        NAPI_CALL(env, napi_create_string_utf8(env, snapshot.buttonLabels[i].c_str(), snapshot.buttonLabels[i].size(), &label));
+        NAPI_CALL(env, napi_set_element(env, buttons, static_cast<uint32_t>(i), label));
+    }
+    NAPI_CALL(env, napi_set_named_property(env, result, "buttons", buttons));
+
+    napi_value sparkline;
+    NAPI_CALL(env, napi_create_array_with_length(env, snapshot.sparkline.size(), &sparkline));
+    for (size_t i = 0; i < snapshot.sparkline.size(); i++) {
+        napi_value level;
+        NAPI_CALL(env, napi_create_double(env, snapshot.sparkline[i], &level));
+        NAPI_CALL(env, napi_set_element(env, sparkline, static_cast<uint32_t>(i), level));
+    }
+    NAPI_CALL(env, napi_set_named_property(env, result, "sparkline", sparkline));
+
+    napi_value updates;
+    NAPI_CALL(env, napi_create_array_with_length(env, history.size(), &updates));
+    for (size_t i = 0; i < history.size(); i++) {
+        napi_value update;
+        NAPI_CALL(env, napi_create_object(env, &update));
+        NAPI_CALL(env, SetNamedDouble(env, update, "timestamp", history[i].timestamp / 1e6));
+        NAPI_CALL(env, SetNamedDouble(env, update, "progress", history[i].progress));
+        if (history[i].hasMessage) {
+            NAPI_CALL(env, SetNamedString(env, update, "message", history[i].message));
         }
+        napi_value updateButtons;
+        NAPI_CALL(env, napi_get_boolean(env, history[i].updateButtons, &updateButtons));
+        NAPI_CALL(env, napi_set_named_property(env, update, "updateButtons", updateButtons));
+        NAPI_CALL(env, napi_set_element(env, updates, static_cast<uint32_t>(i), update));
     }
+    NAPI_CALL(env, napi_set_named_property(env, result, "history", updates));
 
-#ifdef __APPLE__
-    UpdateProgressBarMacOS(
-        context->handle, 
-        progress, 
-        message, 
-        updateButtons,
-        updateButtons ? buttonLabelPtrs.data() : nullptr,
-        updateButtons ? buttonLabelPtrs.size() : 0,
-        updateButtons ? ButtonClickCallback : nullptr
-    );
-#elif defined(_WIN32)
-    UpdateProgressBarWindows(
-        context->handle, 
-        progress, 
-        message,
-        updateButtons,
-        updateButtons ? buttonLabelPtrs.data() : nullptr,
-        updateButtons ? buttonLabelPtrs.size() : 0,
-        updateButtons ? ButtonClickCallback : nullptr
-    );
-#endif
+    return result;
+}
+
+// Returns the rows of a headless progress group, or null if the group is
+// closed or isn't headless
+static napi_value GetHeadlessGroupState(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
 
-    if (message) {
-        delete[] message;
+    napi_value result;
+    NAPI_CALL(env, napi_get_null(env, &result));
+
+    ProgressBarContext* context = GetGroupContext(env, args[0]);
+    if (context) {
+        context->scheduler->CatchUp();
     }
 
-    return nullptr;
+    HeadlessProgressGroupSnapshot snapshot;
+    if (!context || context->backend->showGroup != ShowProgressGroupLinux ||
+        !GetProgressGroupSnapshotLinux(context->handle, &snapshot)) {
+        return result;
+    }
+
+    NAPI_CALL(env, napi_create_object(env, &result));
+    NAPI_CALL(env, SetNamedString(env, result, "title", snapshot.title));
+    NAPI_CALL(env, SetNamedString(env, result, "style", snapshot.style));
+    NAPI_CALL(env, SetNamedDouble(env, result, "updateCount", static_cast<double>(snapshot.updateCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "renderedRowCount", static_cast<double>(snapshot.renderedRowCount)));
+    NAPI_CALL(env, SetNamedDouble(env, result, "visibleRowCount", static_cast<double>(snapshot.visibleRowCount)));
+
+    napi_value rows;
+    NAPI_CALL(env, napi_create_array_with_length(env, snapshot.rows.size(), &rows));
+    for (size_t i = 0; i < snapshot.rows.size(); i++) {
+        napi_value row;
+        NAPI_CALL(env, napi_create_object(env, &row));
+        NAPI_CALL(env, SetNamedDouble(env, row, "id", snapshot.rows[i].id));
+        NAPI_CALL(env, SetNamedDouble(env, row, "progress", snapshot.rows[i].progress));
+        NAPI_CALL(env, SetNamedString(env, row, "message", snapshot.rows[i].message));
+        NAPI_CALL(env, napi_set_element(env, rows, static_cast<uint32_t>(i), row));
+    }
+    NAPI_CALL(env, napi_set_named_property(env, result, "rows", rows));
+
+    return result;
 }
 
-static napi_value CloseProgress(napi_env env, napi_callback_info info) {
+static napi_value ClickHeadlessButton(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 2) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    int32_t index;
+    NAPI_CALL(env, napi_get_value_int32(env, args[1], &index));
+
+    ProgressBarContext* context = GetHeadlessContext(env, args[0]);
+    bool clicked = context && ClickProgressBarButtonLinux(context->handle, index);
+
+    napi_value result;
+    NAPI_CALL(env, napi_get_boolean(env, clicked, &result));
+    return result;
+}
+
+static napi_value SetHeadlessRecording(napi_env env, napi_callback_info info) {
     size_t argc = 1;
     napi_value args[1];
     NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
@@ -324,40 +3954,98 @@ static napi_value CloseProgress(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
-    void* data;
-    NAPI_CALL(env, napi_get_value_external(env, args[0], &data));
-    ProgressBarContext* context = static_cast<ProgressBarContext*>(data);
+    bool enabled;
+    NAPI_CALL(env, napi_get_value_bool(env, args[0], &enabled));
+    SetProgressBarRecordingLinux(enabled);
 
-    if (context && context->isValid.exchange(false)) {
-        if (context->handle) {
-#ifdef __APPLE__
-            CloseProgressBarMacOS(context->handle);
-#elif defined(_WIN32)
-            CloseProgressBarWindows(context->handle);
-#endif
-            context->handle = nullptr;
-        }
+    return nullptr;
+}
+
+static napi_value SetHeadlessPixelWidth(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    if (argc < 1) {
+        napi_throw_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
     }
 
+    double width;
+    NAPI_CALL(env, napi_get_value_double(env, args[0], &width));
+    SetProgressBarPixelWidthLinux(width > 0 ? width : 0);
+
     return nullptr;
 }
+#endif
 
 NAPI_MODULE_INIT() {
     napi_value result = nullptr;
     NAPI_CALL(env, napi_create_object(env, &result));
 
-    napi_add_env_cleanup_hook(env, CleanupProgressBars, nullptr);
-
-    napi_value show_fn, update_fn, close_fn;
-    NAPI_CALL(env, napi_create_function(env, "showProgressBar", NAPI_AUTO_LENGTH, 
-                                       ShowProgressBar, NULL, &show_fn));
-    NAPI_CALL(env, napi_create_function(env, "updateProgress", NAPI_AUTO_LENGTH, 
-                                       UpdateProgress, NULL, &update_fn));
-    NAPI_CALL(env, napi_create_function(env, "closeProgress", NAPI_AUTO_LENGTH, 
-                                       CloseProgress, NULL, &close_fn));
-    NAPI_CALL(env, napi_set_named_property(env, result, "showProgressBar", show_fn));
-    NAPI_CALL(env, napi_set_named_property(env, result, "updateProgress", update_fn));
-    NAPI_CALL(env, napi_set_named_property(env, result, "closeProgress", close_fn));
+    FrameScheduler* scheduler = new FrameScheduler();
+    if (!scheduler->Start(env)) {
+        delete scheduler;
+        napi_throw_error(env, nullptr, "Failed to start the frame scheduler");
+        return nullptr;
+    }
+    napi_add_env_cleanup_hook(env, CleanupProgressBars, scheduler);
+
+    napi_property_descriptor properties[] = {
+        { "showProgressBar", nullptr, ShowProgressBar, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "updateProgress", nullptr, UpdateProgress, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setProgress", nullptr, SetProgress, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setMessage", nullptr, SetMessage, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getProgressBarId", nullptr, GetProgressBarId, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "updateMany", nullptr, UpdateMany, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setBytes", nullptr, SetBytes, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setMessageFormat", nullptr, SetMessageFormat, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getTransferStats", nullptr, GetTransferStats, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getProgressHistory", nullptr, GetProgressHistory, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "closeProgress", nullptr, CloseProgress, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "syncProgressBar", nullptr, SyncProgressBar, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "prewarm", nullptr, Prewarm, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "animateTo", nullptr, AnimateTo, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "addTask", nullptr, AddTask, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setTaskProgress", nullptr, SetTaskProgress, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setIndeterminate", nullptr, SetIndeterminate, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setSparkline", nullptr, SetSparkline, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getStats", nullptr, GetStats, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setTracing", nullptr, SetTracingEnabled, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getTracing", nullptr, GetTracingEnabled, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getTrace", nullptr, GetTrace, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "showProgressGroup", nullptr, ShowProgressGroup, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "addProgressGroupRow", nullptr, AddProgressGroupRow, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "updateProgressGroupRow", nullptr, UpdateProgressGroupRow, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "removeProgressGroupRow", nullptr, RemoveProgressGroupRow, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "attachSharedProgress", nullptr, AttachSharedProgress, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "createSharedSegment", nullptr, CreateSharedSegment, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "openSharedSegment", nullptr, OpenSharedSegment, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "writeSharedSegment", nullptr, WriteToSharedSegment, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "closeSharedSegment", nullptr, CloseSharedSegment, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setMaxFrameRate", nullptr, SetMaxFrameRate, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getMaxFrameRate", nullptr, GetMaxFrameRate, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getDiagnostics", nullptr, GetDiagnostics, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "flush", nullptr, Flush, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setBackend", nullptr, SetBackend, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getBackend", nullptr, GetBackend, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getBackends", nullptr, GetBackends, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+#ifdef PROGRESS_BAR_ALLOC_STATS
+        { "getAllocationStats", nullptr, GetAllocationStats, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+#endif
+#ifdef __linux__
+        { "getHeadlessState", nullptr, GetHeadlessState, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "getHeadlessGroupState", nullptr, GetHeadlessGroupState, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "clickHeadlessButton", nullptr, ClickHeadlessButton, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setHeadlessRecording", nullptr, SetHeadlessRecording, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+        { "setHeadlessPixelWidth", nullptr, SetHeadlessPixelWidth, nullptr, nullptr, nullptr, napi_enumerable, scheduler },
+#endif
+    };
+    NAPI_CALL(env, napi_define_properties(env, result, sizeof(properties) / sizeof(properties[0]), properties));
+
+    napi_value native_api;
+    NAPI_CALL(env, napi_create_external(env, const_cast<ProgressBarApi*>(&kNativeApi), nullptr, nullptr, &native_api));
+    NAPI_CALL(env, napi_set_named_property(env, result, "nativeApi", native_api));
 
     return result;
 }
@@ -0,0 +1,58 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "progress_bar_alloc_stats.h"
+
+// Replaces the global allocation functions for this addon only (it is linked
+// with -Bsymbolic-functions), so the benchmarks can count allocations per
+// call. Never part of a release build.
+
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<uint64_t> deallocations{0};
+static std::atomic<uint64_t> allocated_bytes{0};
+
+static void* CountedAllocate(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+static void CountedFree(void* ptr) {
+    if (ptr) {
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        free(ptr);
+    }
+}
+
+void* operator new(size_t size) {
+    void* ptr = CountedAllocate(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    void* ptr = CountedAllocate(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr) noexcept { CountedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { CountedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { CountedFree(ptr); }
+
+void GetProgressBarAllocationStats(ProgressBarAllocationStats* stats) {
+    stats->allocations = allocations.load(std::memory_order_relaxed);
+    stats->deallocations = deallocations.load(std::memory_order_relaxed);
+    stats->allocatedBytes = allocated_bytes.load(std::memory_order_relaxed);
+}
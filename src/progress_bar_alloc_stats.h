@@ -0,0 +1,17 @@
+#ifndef PROGRESS_BAR_ALLOC_STATS_H
+#define PROGRESS_BAR_ALLOC_STATS_H
+
+#include <stdint.h>
+
+// Heap allocations made through operator new/delete by the addon itself.
+// Only available when built with `node-gyp rebuild --alloc_stats=1`, which
+// defines PROGRESS_BAR_ALLOC_STATS.
+struct ProgressBarAllocationStats {
+    uint64_t allocations;
+    uint64_t deallocations;
+    uint64_t allocatedBytes;
+};
+
+void GetProgressBarAllocationStats(ProgressBarAllocationStats* stats);
+
+#endif // PROGRESS_BAR_ALLOC_STATS_H
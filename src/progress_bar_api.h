@@ -0,0 +1,84 @@
+#ifndef PROGRESS_BAR_API_H
+#define PROGRESS_BAR_API_H
+
+// Public C interface for other native addons that want to drive a progress
+// bar without going through JavaScript.
+//
+// From JavaScript, pass `nativeApi` (exported by "native-progress-bar") and a
+// ProgressBar's `handle` to your addon. On the JS thread, resolve the API
+// table with ProgressBarGetApi() and turn the handle into a ProgressBarRef
+// with acquire(). The reference can then be used from any thread, at any
+// rate: updates are coalesced and marshalled to the UI thread by the core.
+// Call release() once you are done with it, from any thread.
+//
+// The table is versioned. New functions are only ever appended, so check
+// `size` before using anything added after version 1.
+
+#include <node_api.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROGRESS_BAR_API_VERSION 2
+
+typedef struct ProgressBarRef ProgressBarRef;
+
+typedef enum {
+    PROGRESS_BAR_OK = 0,
+    // The bar has been closed. The reference is still valid and must be released.
+    PROGRESS_BAR_CLOSED = 1,
+    PROGRESS_BAR_INVALID_ARGUMENT = 2
+} ProgressBarStatus;
+
+typedef struct ProgressBarApi {
+    uint32_t version;
+    // sizeof(ProgressBarApi) in the addon that provides the table
+    uint32_t size;
+
+    // JS thread only. Returns NULL if `handle` isn't a live ProgressBar handle.
+    ProgressBarRef* (*acquire)(napi_env env, napi_value handle);
+    // Any thread.
+    void (*release)(ProgressBarRef* bar);
+
+    // Any thread. Progress is between 0 and 100.
+    ProgressBarStatus (*setProgress)(ProgressBarRef* bar, double progress);
+    // Any thread. The message is copied; it must be UTF-8.
+    ProgressBarStatus (*setMessage)(ProgressBarRef* bar, const char* message, size_t length);
+    // Any thread. Returns non-zero once the bar has been closed.
+    int (*isClosed)(ProgressBarRef* bar);
+
+    // Added in version 2.
+    // Any thread. Switches the bar to byte counts: progress, throughput and
+    // the remaining time are derived from them. A total of 0 means unknown.
+    ProgressBarStatus (*setBytes)(ProgressBarRef* bar, uint64_t done, uint64_t total);
+} ProgressBarApi;
+
+// Whether `api` provides `field`, for functions added after version 1
+#define PROGRESS_BAR_API_HAS(api, field) \
+    ((api)->size >= offsetof(ProgressBarApi, field) + sizeof((api)->field))
+
+// Resolves the value of `require("native-progress-bar").nativeApi`.
+// Returns NULL if the value isn't a compatible API table.
+static inline const ProgressBarApi* ProgressBarGetApi(napi_env env, napi_value value) {
+    void* data = NULL;
+    if (napi_get_value_external(env, value, &data) != napi_ok || data == NULL) {
+        return NULL;
+    }
+
+    // Anything since version 1 is compatible, see PROGRESS_BAR_API_HAS()
+    const ProgressBarApi* api = (const ProgressBarApi*)data;
+    if (api->version < 1) {
+        return NULL;
+    }
+
+    return api;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROGRESS_BAR_API_H
@@ -0,0 +1,356 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "progress_bar_linux.h"
+#include "progress_layout.h"
+
+struct HeadlessProgressBar {
+    std::mutex mutex;
+    HeadlessProgressBarSnapshot state;
+    std::vector<HeadlessProgressBarUpdate> history;
+    void (*callback)(void*, int) = nullptr;
+    void* userData = nullptr;
+    // Fixed when shown, like a native window's layout
+    double pixelWidth = 0;
+    // Laid out like a window, so layout changes can be counted
+    ProgressBarLayout layout;
+};
+
+static std::atomic<bool> recording{false};
+static std::atomic<double> pixel_width{0};
+
+// Like DestroyWindow with a dead HWND, closing a handle twice is harmless
+static std::mutex bars_mutex;
+static std::unordered_set<HeadlessProgressBar*> live_bars;
+
+// Bars built ahead of time, see PrewarmProgressBarsLinux()
+static WindowPool<HeadlessProgressBar*> bar_pool;
+
+static HeadlessProgressBar* FindBar(void* handle) {
+    std::lock_guard<std::mutex> lock(bars_mutex);
+    auto it = live_bars.find(static_cast<HeadlessProgressBar*>(handle));
+    return it != live_bars.end() ? *it : nullptr;
+}
+
+static uint64_t MonotonicNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The metrics of a Windows bar at 96 DPI
+static ProgressBarLayoutMetrics GetLayoutMetrics() {
+    ProgressBarLayoutMetrics metrics;
+    metrics.contentWidth = 484;
+    metrics.margin = 30;
+    metrics.top = 20;
+    metrics.messageHeight = 20;
+    metrics.progressGap = 10;
+    metrics.progressHeight = 24;
+    metrics.buttonGap = 26;
+    metrics.buttonHeight = 32;
+    metrics.buttonMinWidth = 100;
+    metrics.buttonPadding = 24;
+    metrics.buttonSpacing = 10;
+    metrics.bottomMargin = 28;
+    return metrics;
+}
+
+// Text is 8 units per code point, as if in a monospaced font
+static int MeasureLabel(const std::string& label) {
+    int width = 0;
+    for (unsigned char c : label) {
+        if ((c & 0xc0) != 0x80) {
+            width += 8;
+        }
+    }
+    return width;
+}
+
+static void SetButtons(HeadlessProgressBar* bar, const char** buttonLabels, size_t buttonCount,
+                       void (*callback)(void*, int)) {
+    bar->state.buttonLabels.clear();
+    for (size_t i = 0; i < buttonCount; i++) {
+        bar->state.buttonLabels.emplace_back(buttonLabels[i] ? buttonLabels[i] : "");
+    }
+    bar->callback = callback;
+
+    std::vector<LayoutOp> ops = bar->layout.Update(GetLayoutMetrics(), bar->state.buttonLabels, MeasureLabel);
+    bar->state.layoutOpCount += ops.size();
+    bar->state.contentHeight = bar->layout.geometry().contentHeight;
+}
+
+void* ShowProgressBarLinux(
+    const char* title,
+    const char* message,
+    const char* style,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void*, int),
+    void* userData) {
+
+    HeadlessProgressBar* bar = nullptr;
+    if (!bar_pool.Take(&bar)) {
+        bar = new HeadlessProgressBar();
+    }
+    bar->userData = userData;
+    bar->state.title = title ? title : "Progress";
+    bar->state.message = message ? message : "";
+    bar->state.style = style ? style : "default";
+    bar->state.shownAt = MonotonicNow();
+    bar->pixelWidth = pixel_width.load();
+    SetButtons(bar, buttonLabels, buttonCount, callback);
+
+    std::lock_guard<std::mutex> lock(bars_mutex);
+    live_bars.insert(bar);
+    return bar;
+}
+
+void UpdateProgressBarLinux(
+    void* handle,
+    double progress,
+    const char* message,
+    bool updateButtons,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void*, int)) {
+
+    HeadlessProgressBar* bar = static_cast<HeadlessProgressBar*>(handle);
+    if (!bar) return;
+
+    std::lock_guard<std::mutex> lock(bar->mutex);
+    uint64_t now = MonotonicNow();
+
+    bar->state.progress = progress;
+    bar->state.updateCount++;
+    bar->state.lastUpdateAt = now;
+
+    if (message) {
+        bar->state.message = message;
+        bar->state.messageUpdateCount++;
+    }
+
+    if (updateButtons) {
+        SetButtons(bar, buttonLabels, buttonCount, callback);
+        bar->state.buttonUpdateCount++;
+    }
+
+    if (recording.load(std::memory_order_relaxed)) {
+        HeadlessProgressBarUpdate update;
+        update.timestamp = now;
+        update.progress = progress;
+        update.hasMessage = message != nullptr;
+        if (message) {
+            update.message = message;
+        }
+        update.updateButtons = updateButtons;
+        bar->history.push_back(std::move(update));
+    }
+}
+
+void CloseProgressBarLinux(void* handle) {
+    HeadlessProgressBar* bar = static_cast<HeadlessProgressBar*>(handle);
+    {
+        std::lock_guard<std::mutex> lock(bars_mutex);
+        if (live_bars.erase(bar) == 0) {
+            return;
+        }
+    }
+
+    // Nobody can look the bar up anymore, so it can be reset without a lock.
+    // The layout stays, as a pooled window keeps its controls.
+    SetButtons(bar, nullptr, 0, nullptr);
+    bar->state = HeadlessProgressBarSnapshot();
+    bar->history.clear();
+    bar->callback = nullptr;
+    bar->userData = nullptr;
+    if (!bar_pool.Return(bar)) {
+        delete bar;
+    }
+}
+
+void PrewarmProgressBarsLinux(size_t count, const char* style) {
+    bar_pool.Prewarm(count, [] { return new HeadlessProgressBar(); },
+                     [](HeadlessProgressBar* bar) { delete bar; });
+}
+
+void GetProgressBarPoolStatsLinux(WindowPoolStats* stats) {
+    bar_pool.GetStats(stats);
+}
+
+double GetProgressBarPixelWidthLinux(void* handle) {
+    HeadlessProgressBar* bar = static_cast<HeadlessProgressBar*>(handle);
+    return bar ? bar->pixelWidth : 0;
+}
+
+void SetProgressBarIndeterminateLinux(void* handle, bool indeterminate) {
+    HeadlessProgressBar* bar = static_cast<HeadlessProgressBar*>(handle);
+    if (!bar) return;
+
+    std::lock_guard<std::mutex> lock(bar->mutex);
+    if (bar->state.indeterminate != indeterminate) {
+        bar->state.indeterminate = indeterminate;
+        bar->state.indeterminateSince = indeterminate ? MonotonicNow() : 0;
+    }
+}
+
+void SetProgressBarSparklineLinux(void* handle, const float* levels, size_t count) {
+    HeadlessProgressBar* bar = static_cast<HeadlessProgressBar*>(handle);
+    if (!bar) return;
+
+    std::lock_guard<std::mutex> lock(bar->mutex);
+    bar->state.sparkline.assign(levels, levels + count);
+    bar->state.sparklineUpdateCount++;
+}
+
+bool GetProgressBarSnapshotLinux(void* handle, HeadlessProgressBarSnapshot* snapshot,
+                                 std::vector<HeadlessProgressBarUpdate>* history) {
+    HeadlessProgressBar* bar = FindBar(handle);
+    if (!bar) return false;
+
+    std::lock_guard<std::mutex> lock(bar->mutex);
+    *snapshot = bar->state;
+    if (snapshot->indeterminate) {
+        snapshot->animationFrame = (MonotonicNow() - snapshot->indeterminateSince) / 30000000;
+    }
+    if (history) {
+        *history = bar->history;
+    }
+
+    return true;
+}
+
+bool ClickProgressBarButtonLinux(void* handle, int buttonIndex) {
+    HeadlessProgressBar* bar = FindBar(handle);
+    if (!bar) return false;
+
+    void (*callback)(void*, int) = nullptr;
+    void* userData = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(bar->mutex);
+        if (buttonIndex < 0 || static_cast<size_t>(buttonIndex) >= bar->state.buttonLabels.size()) {
+            return false;
+        }
+        callback = bar->callback;
+        userData = bar->userData;
+    }
+
+    // The callback may update or close this bar, so it runs unlocked
+    if (callback) {
+        callback(userData, buttonIndex);
+    }
+
+    return true;
+}
+
+void SetProgressBarRecordingLinux(bool enabled) {
+    recording.store(enabled);
+}
+
+void SetProgressBarPixelWidthLinux(double width) {
+    pixel_width.store(width);
+}
+
+// Rows that fit in a group window without scrolling
+static const size_t kGroupVisibleRows = 8;
+
+struct HeadlessProgressGroup {
+    std::mutex mutex;
+    HeadlessProgressGroupSnapshot state;
+    std::unordered_map<uint32_t, size_t> rowIndex;
+};
+
+static std::unordered_set<HeadlessProgressGroup*> live_groups;
+
+static HeadlessProgressGroup* FindGroup(void* handle) {
+    std::lock_guard<std::mutex> lock(bars_mutex);
+    auto it = live_groups.find(static_cast<HeadlessProgressGroup*>(handle));
+    return it != live_groups.end() ? *it : nullptr;
+}
+
+static void RenderRow(HeadlessProgressGroup* group, size_t index) {
+    if (index < kGroupVisibleRows) {
+        group->state.renderedRowCount++;
+    }
+}
+
+void* ShowProgressGroupLinux(const char* title, const char* style) {
+    HeadlessProgressGroup* group = new HeadlessProgressGroup();
+    group->state.title = title ? title : "Progress";
+    group->state.style = style ? style : "default";
+    group->state.visibleRowCount = kGroupVisibleRows;
+
+    std::lock_guard<std::mutex> lock(bars_mutex);
+    live_groups.insert(group);
+    return group;
+}
+
+void UpdateProgressGroupLinux(void* handle, const ProgressGroupRowUpdate* updates, size_t count) {
+    HeadlessProgressGroup* group = static_cast<HeadlessProgressGroup*>(handle);
+    if (!group) return;
+
+    std::lock_guard<std::mutex> lock(group->mutex);
+    std::vector<HeadlessProgressGroupRow>& rows = group->state.rows;
+    group->state.updateCount++;
+
+    for (size_t i = 0; i < count; i++) {
+        const ProgressGroupRowUpdate& update = updates[i];
+        auto it = group->rowIndex.find(update.id);
+
+        if (update.op == PROGRESS_GROUP_ROW_REMOVE) {
+            if (it == group->rowIndex.end()) continue;
+
+            size_t index = it->second;
+            group->rowIndex.erase(it);
+            rows.erase(rows.begin() + index);
+            for (size_t j = index; j < rows.size(); j++) {
+                group->rowIndex[rows[j].id] = j;
+                // Rows moving up into view have to be drawn
+                RenderRow(group, j);
+            }
+            continue;
+        }
+
+        size_t index;
+        if (it != group->rowIndex.end()) {
+            index = it->second;
+        } else if (update.op == PROGRESS_GROUP_ROW_ADD) {
+            index = rows.size();
+            group->rowIndex.emplace(update.id, index);
+            rows.emplace_back();
+            rows.back().id = update.id;
+        } else {
+            continue;
+        }
+
+        HeadlessProgressGroupRow& row = rows[index];
+        if (update.hasProgress) {
+            row.progress = update.progress;
+        }
+        if (update.message) {
+            row.message = update.message;
+        }
+        RenderRow(group, index);
+    }
+}
+
+void CloseProgressGroupLinux(void* handle) {
+    HeadlessProgressGroup* group = static_cast<HeadlessProgressGroup*>(handle);
+    {
+        std::lock_guard<std::mutex> lock(bars_mutex);
+        if (live_groups.erase(group) == 0) {
+            return;
+        }
+    }
+    delete group;
+}
+
+bool GetProgressGroupSnapshotLinux(void* handle, HeadlessProgressGroupSnapshot* snapshot) {
+    HeadlessProgressGroup* group = FindGroup(handle);
+    if (!group) return false;
+
+    std::lock_guard<std::mutex> lock(group->mutex);
+    *snapshot = group->state;
+    return true;
+}
@@ -0,0 +1,137 @@
+#ifndef PROGRESS_BAR_LINUX_H
+#define PROGRESS_BAR_LINUX_H
+
+#include <stddef.h>
+#include "progress_group.h"
+#include "window_pool.h"
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#endif
+
+// Headless backend. There is no window: every bar records its state in
+// memory, so that the core can be exercised, profiled and tested on Linux.
+
+void* ShowProgressBarLinux(
+    const char* title,
+    const char* message,
+    const char* style,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void* userData, int buttonIndex),
+    void* userData
+);
+
+void UpdateProgressBarLinux(
+    void* handle,
+    double progress,
+    const char* message,
+    bool updateButtons,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void* userData, int buttonIndex)
+);
+
+void CloseProgressBarLinux(void* handle);
+
+// Width of the bar's fill in device pixels, 0 if unknown
+double GetProgressBarPixelWidthLinux(void* handle);
+
+// There is nothing to animate, the snapshot reports which frame a real
+// animation would be on
+void SetProgressBarIndeterminateLinux(void* handle, bool indeterminate);
+
+// Keeps the sparkline's levels in the snapshot, see ProgressBarBackend
+void SetProgressBarSparklineLinux(void* handle, const float* levels, size_t count);
+
+// Keeps `count` bars allocated for the next shows, like the window pools of
+// the other platforms
+void PrewarmProgressBarsLinux(size_t count, const char* style);
+
+void GetProgressBarPoolStatsLinux(WindowPoolStats* stats);
+
+void* ShowProgressGroupLinux(const char* title, const char* style);
+
+void UpdateProgressGroupLinux(void* handle, const ProgressGroupRowUpdate* updates, size_t count);
+
+void CloseProgressGroupLinux(void* handle);
+
+#ifdef __cplusplus
+}
+
+// A copy of everything a headless bar has been told. Timestamps are
+// monotonic nanoseconds (CLOCK_MONOTONIC, the clock behind process.hrtime).
+struct HeadlessProgressBarSnapshot {
+    std::string title;
+    std::string message;
+    std::string style;
+    double progress = 0;
+    std::vector<std::string> buttonLabels;
+    bool indeterminate = false;
+    // Frames of a 30 ms animation since the bar became indeterminate, or 0
+    uint64_t animationFrame = 0;
+    // Between 0 and 1, oldest first. Empty without a sparkline.
+    std::vector<float> sparkline;
+
+    uint64_t updateCount = 0;
+    uint64_t messageUpdateCount = 0;
+    uint64_t buttonUpdateCount = 0;
+    uint64_t sparklineUpdateCount = 0;
+    // Height of the content a window would have, and the changes its
+    // controls would have gone through to get there, see progress_layout.h
+    int contentHeight = 0;
+    uint64_t layoutOpCount = 0;
+    uint64_t shownAt = 0;
+    uint64_t lastUpdateAt = 0;
+    uint64_t indeterminateSince = 0;
+};
+
+// One entry per update, only kept while recording is enabled
+struct HeadlessProgressBarUpdate {
+    uint64_t timestamp = 0;
+    double progress = 0;
+    bool hasMessage = false;
+    std::string message;
+    bool updateButtons = false;
+};
+
+bool GetProgressBarSnapshotLinux(void* handle, HeadlessProgressBarSnapshot* snapshot,
+                                 std::vector<HeadlessProgressBarUpdate>* history);
+
+// Simulates a click on a button, as if the user had pressed it
+bool ClickProgressBarButtonLinux(void* handle, int buttonIndex);
+
+// Toggles whether every update is appended to the bar's history
+void SetProgressBarRecordingLinux(bool enabled);
+
+// The width headless bars shown from now on report, to exercise the core's
+// pixel filter. 0, the default, means every update is applied.
+void SetProgressBarPixelWidthLinux(double width);
+
+struct HeadlessProgressGroupRow {
+    uint32_t id = 0;
+    double progress = 0;
+    std::string message;
+};
+
+// Rows are in display order. Like a native list view, the headless group only
+// renders the rows that fit in its window: `renderedRowCount` counts how
+// often a row in the first `visibleRowCount` rows had to be drawn.
+struct HeadlessProgressGroupSnapshot {
+    std::string title;
+    std::string style;
+    std::vector<HeadlessProgressGroupRow> rows;
+
+    uint64_t updateCount = 0;
+    uint64_t renderedRowCount = 0;
+    size_t visibleRowCount = 0;
+};
+
+bool GetProgressGroupSnapshotLinux(void* handle, HeadlessProgressGroupSnapshot* snapshot);
+#endif
+
+#endif // PROGRESS_BAR_LINUX_H
@@ -1,23 +1,57 @@
 #ifndef PROGRESS_BAR_MACOS_H
 #define PROGRESS_BAR_MACOS_H
 
+#include "progress_bar_update.h"
+#include "progress_group.h"
+#include "window_pool.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef void (*ButtonCallback)(int buttonIndex);
+// Called on the main thread with the userData the bar was shown with
+typedef void (*ButtonCallback)(void* userData, int buttonIndex);
 
 extern "C" __attribute__((visibility("default")))
 void* ShowProgressBarMacOS(const char* title, const char* message, const char* style, 
-                          const char** buttonLabels, int buttonCount, ButtonCallback callback);
+                          const char** buttonLabels, int buttonCount, ButtonCallback callback,
+                          void* userData);
 
 extern "C" __attribute__((visibility("default")))
 void UpdateProgressBarMacOS(void* handle, double progress, const char* message,
                             bool updateButtons, const char** buttonLabels, int buttonCount, ButtonCallback callback);
 
+extern "C" __attribute__((visibility("default")))
+void UpdateProgressBarsMacOS(const ProgressBarUpdate* updates, size_t count);
+
+// Width of the bar's fill in device pixels, 0 if unknown
+extern "C" __attribute__((visibility("default")))
+double GetProgressBarPixelWidthMacOS(void* handle);
+
+// Indeterminate bars animate on their own, driven by AppKit
+extern "C" __attribute__((visibility("default")))
+void SetProgressBarIndeterminateMacOS(void* handle, bool indeterminate);
+
 extern "C" __attribute__((visibility("default")))
 void CloseProgressBarMacOS(void* handle);
 
+// Keeps `count` hidden panels of `style` ready for the next shows. Closed bars
+// of that style return their panel while the pool has room. 0 empties it.
+extern "C" __attribute__((visibility("default")))
+void PrewarmProgressBarsMacOS(size_t count, const char* style);
+
+extern "C" __attribute__((visibility("default")))
+void GetProgressBarPoolStatsMacOS(WindowPoolStats* stats);
+
+extern "C" __attribute__((visibility("default")))
+void* ShowProgressGroupMacOS(const char* title, const char* style);
+
+extern "C" __attribute__((visibility("default")))
+void UpdateProgressGroupMacOS(void* handle, const ProgressGroupRowUpdate* updates, size_t count);
+
+extern "C" __attribute__((visibility("default")))
+void CloseProgressGroupMacOS(void* handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,145 +1,140 @@
 #import <Cocoa/Cocoa.h>
+#include <mutex>
+#include <unordered_set>
 #include "progress_bar_macos.h"
+#include "progress_layout.h"
 
-typedef void (*ButtonCallback)(int buttonIndex);
-
-@interface ButtonInfo : NSObject
-@property (nonatomic) int index;
-@property (nonatomic) ButtonCallback callback;
-@end
-
-@implementation ButtonInfo
-@end
-
-@interface ProgressBarWrapper : NSObject
+@interface ProgressBarWrapper : NSObject {
+    // Where the controls are, kept to diff the next layout against
+    ProgressBarLayout _layout;
+}
 @property NSPanel* panel;
 @property NSProgressIndicator* progressBar;
 @property NSTextField* messageLabel;
+// In the order of their labels
 @property NSMutableArray<NSButton*>* buttons;
-@property NSMutableArray<ButtonInfo*>* buttonCallbacks;
+@property (nonatomic) ButtonCallback buttonCallback;
+// Cleared when the bar is closed, so late clicks go nowhere
+@property (nonatomic) void* userData;
+// Width of the fill in device pixels. Read from the JS thread.
+@property (atomic) double pixelWidth;
+// The style the panel was built with
+@property NSString* style;
 
-- (void)clearButtons;
-- (void)addButton:(const char*)label index:(int)index callback:(ButtonCallback)callback;
-- (void)relayoutButtons;
+- (void)layoutWithButtonLabels:(const std::vector<std::string>&)labels;
 @end
 
 // Declare default values
 #define DEFAULT_WIDTH 400
 #define DEFAULT_HEIGHT_WITHOUT_BUTTONS 100
-#define DEFAULT_ADDED_HEIGHT_WITH_BUTTONS 40
-#define DEFAULT_HEIGHT_WITH_BUTTONS (DEFAULT_HEIGHT_WITHOUT_BUTTONS + DEFAULT_ADDED_HEIGHT_WITH_BUTTONS)
+
+// Button labels measured so far. Only used on the main thread.
+static TextWidthCache label_widths;
+
+static ProgressBarLayoutMetrics GetLayoutMetrics() {
+    ProgressBarLayoutMetrics metrics;
+    metrics.contentWidth = DEFAULT_WIDTH;
+    metrics.margin = 20;
+    metrics.top = 20;
+    metrics.messageHeight = 20;
+    metrics.progressGap = 10;
+    metrics.progressHeight = 20;
+    metrics.buttonGap = 10;
+    metrics.buttonHeight = 30;
+    metrics.buttonMinWidth = 100;
+    metrics.buttonPadding = 32;
+    metrics.buttonSpacing = 10;
+    metrics.bottomMargin = 30;
+    metrics.firstButtonRightmost = true;
+    return metrics;
+}
 
 @implementation ProgressBarWrapper
 - (void)buttonClicked:(NSButton*)sender {
     NSUInteger index = [self.buttons indexOfObject:sender];
-    if (index != NSNotFound && index < self.buttonCallbacks.count) {
-        ButtonInfo* info = self.buttonCallbacks[index];
-        if (info.callback) {
-            info.callback(info.index);
-        }
+    if (index != NSNotFound && self.buttonCallback && self.userData) {
+        self.buttonCallback(self.userData, (int)index);
     }
 }
 
-- (void)clearButtons {
-    for (NSButton* button in self.buttons) {
-        [button removeFromSuperview];
-    }
-    [self.buttons removeAllObjects];
-    [self.buttonCallbacks removeAllObjects];
-}
+// Lays the panel out for `labels` and makes only the changes that takes: a
+// bar that swaps one button label relabels that one button. Keeps the top
+// edge of the panel where it is. Runs on the main thread.
+- (void)layoutWithButtonLabels:(const std::vector<std::string>&)labels {
+    NSFont* font = [NSFont systemFontOfSize:[NSFont systemFontSizeForControlSize:NSControlSizeRegular]];
+    int dpi = (int)(self.panel.backingScaleFactor * 72);
 
-- (void)addButton:(const char*)label index:(int)index callback:(ButtonCallback)callback {
-    NSString* labelStr = [NSString stringWithUTF8String:label];
-    NSButton* button = [[NSButton alloc] init];
-    [button setTitle:labelStr];
-    [button setBezelStyle:NSBezelStyleRounded];
-    [button setTarget:self];
-    [button setAction:@selector(buttonClicked:)];
-    [[self.panel contentView] addSubview:button];
-    [self.buttons addObject:button];
-    
-    ButtonInfo* info = [[ButtonInfo alloc] init];
-    info.index = index;
-    info.callback = callback;
-    [self.buttonCallbacks addObject:info];
-}
+    std::vector<LayoutOp> ops = _layout.Update(GetLayoutMetrics(), labels, [&](const std::string& label) {
+        return label_widths.Get(label, (uintptr_t)(__bridge void*)font, dpi, [&] {
+            NSString* text = [NSString stringWithUTF8String:label.c_str()] ?: @"";
+            return (int)ceil([text sizeWithAttributes:@{ NSFontAttributeName: font }].width);
+        });
+    });
 
-- (void)relayoutButtons {
-    // Get the current window frame in screen coordinates
-    NSRect screenFrame = [self.panel frame];
-    
-    CGFloat newHeight;
-    CGFloat messageLabelY;
-    CGFloat progressBarY;
-    
-    if (self.buttons.count == 0) {
-        // Resize window to smaller height if no buttons
-        newHeight = DEFAULT_HEIGHT_WITHOUT_BUTTONS;
-        messageLabelY = newHeight - 40;
-        progressBarY = newHeight - 70;
-    } else {
-        // Resize window to accommodate buttons
-        newHeight = DEFAULT_HEIGHT_WITH_BUTTONS;
-        messageLabelY = newHeight - 40;
-        progressBarY = newHeight - 70;
-    }
-    
-    // Calculate new window frame while maintaining screen position
-    NSRect newFrame = screenFrame;
-    newFrame.origin.y = NSMaxY(screenFrame) - newHeight; // Keep top edge in same place
-    newFrame.size.height = newHeight + 30;
-    
-    // Update window frame
-    [self.panel setFrame:newFrame display:YES animate:YES];
-    
-    // Update message label position
-    NSRect messageLabelFrame = self.messageLabel.frame;
-    messageLabelFrame.origin.y = messageLabelY;
-    [self.messageLabel setFrame:messageLabelFrame];
-    
-    // Update progress bar position
-    NSRect progressBarFrame = self.progressBar.frame;
-    progressBarFrame.origin.y = progressBarY;
-    [self.progressBar setFrame:progressBarFrame];
-    
-    if (self.buttons.count > 0) {
-        // Reposition buttons
-        CGFloat buttonWidth = 100;
-        CGFloat buttonHeight = 30;
-        CGFloat buttonSpacing = 10;
-        CGFloat buttonY = 20;
-        
-        // Calculate total width needed for all buttons
-        CGFloat startX = self.panel.frame.size.width - 20 - buttonWidth;
-        
-        for (NSButton* button in self.buttons) {
-            [button setFrame:NSMakeRect(startX, buttonY, buttonWidth, buttonHeight)];
-            startX -= (buttonWidth + buttonSpacing);
+    // AppKit counts y up from the bottom, the layout down from the top. Every
+    // control sticks to the top edge when the panel resizes, so only the ones
+    // the layout moves need new frames.
+    for (const LayoutOp& op : ops) {
+        CGFloat contentHeight = [self.panel.contentView frame].size.height;
+        if (op.kind == LayoutOpKind::kResize) {
+            contentHeight = op.rect.height;
+        }
+        NSRect frame = NSMakeRect(op.rect.x, contentHeight - op.rect.y - op.rect.height,
+                                  op.rect.width, op.rect.height);
+
+        switch (op.kind) {
+            case LayoutOpKind::kResize: {
+                NSRect content = [self.panel contentRectForFrameRect:self.panel.frame];
+                content.origin.y = NSMaxY(content) - op.rect.height;
+                content.size = NSMakeSize(op.rect.width, op.rect.height);
+                [self.panel setFrame:[self.panel frameRectForContentRect:content] display:YES];
+                break;
+            }
+            case LayoutOpKind::kMoveMessage:
+                [self.messageLabel setFrame:frame];
+                break;
+            case LayoutOpKind::kMoveProgress:
+                [self.progressBar setFrame:frame];
+                break;
+            case LayoutOpKind::kCreateButton: {
+                NSButton* button = [[NSButton alloc] initWithFrame:frame];
+                [button setTitle:[NSString stringWithUTF8String:_layout.label(op.index).c_str()] ?: @""];
+                [button setBezelStyle:NSBezelStyleRounded];
+                [button setAutoresizingMask:NSViewMinYMargin];
+                [button setTarget:self];
+                [button setAction:@selector(buttonClicked:)];
+                [[self.panel contentView] addSubview:button];
+                [self.buttons addObject:button];
+                break;
+            }
+            case LayoutOpKind::kRelabelButton:
+                [self.buttons[op.index] setTitle:[NSString stringWithUTF8String:_layout.label(op.index).c_str()] ?: @""];
+                [self.buttons[op.index] setFrame:frame];
+                break;
+            case LayoutOpKind::kMoveButton:
+                [self.buttons[op.index] setFrame:frame];
+                break;
+            case LayoutOpKind::kDestroyButton:
+                [self.buttons[op.index] removeFromSuperview];
+                [self.buttons removeLastObject];
+                break;
         }
     }
 }
 @end
 
-extern "C" __attribute__((visibility("default")))
-void* ShowProgressBarMacOS(const char* title, const char* message, const char* style,
-                          const char** buttonLabels, int buttonCount, ButtonCallback callback) {
-    if (title == nullptr) title = "Progress";
-    if (message == nullptr) message = "";
-    if (style == nullptr) style = "default";
-    
+// Builds a hidden panel with its message and progress, everything a bar
+// needs apart from its title, text and buttons
+static ProgressBarWrapper* BuildProgressBarWrapper(NSString* styleStr) {
     ProgressBarWrapper* wrapper = [[ProgressBarWrapper alloc] init];
     wrapper.buttons = [NSMutableArray array];
-    wrapper.buttonCallbacks = [NSMutableArray array];
-    
+
     [NSApplication sharedApplication];
-    [NSApp setActivationPolicy:NSApplicationActivationPolicyRegular];
-    [NSApp activateIgnoringOtherApps:YES];
     
     // Base style mask
     NSWindowStyleMask styleMask = NSWindowStyleMaskTitled | NSWindowStyleMaskNonactivatingPanel;
     
     // Add additional style based on parameter
-    NSString* styleStr = [NSString stringWithUTF8String:style];
     if ([styleStr isEqualToString:@"hud"]) {
         styleMask |= NSWindowStyleMaskHUDWindow;
     } else if ([styleStr isEqualToString:@"utility"]) {
@@ -147,7 +142,7 @@ void* ShowProgressBarMacOS(const char* title, const char* message, const char* s
     }
     
     double width = DEFAULT_WIDTH;
-    double height = (buttonCount > 0) ? DEFAULT_HEIGHT_WITH_BUTTONS : DEFAULT_HEIGHT_WITHOUT_BUTTONS;
+    double height = DEFAULT_HEIGHT_WITHOUT_BUTTONS;
 
     NSPanel *panel = [[NSPanel alloc] initWithContentRect:NSMakeRect(0, 0, width, height)
                                                styleMask:styleMask
@@ -159,20 +154,19 @@ void* ShowProgressBarMacOS(const char* title, const char* message, const char* s
         panel.appearance = [NSAppearance appearanceNamed:NSAppearanceNameVibrantDark];
     }
     
-    [panel setTitle:[NSString stringWithUTF8String:title]];
     [panel setLevel:NSFloatingWindowLevel];
     [panel setHidesOnDeactivate:NO];
     
-    // Position message label at the top
-    NSTextField *messageLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(20, height - 40, DEFAULT_WIDTH - 40, 20)];
-    [messageLabel setStringValue:[NSString stringWithUTF8String:message]];
+    // Placed by -layoutWithButtonLabels: below
+    NSTextField *messageLabel = [[NSTextField alloc] initWithFrame:NSZeroRect];
+    [messageLabel setAutoresizingMask:NSViewMinYMargin];
     [messageLabel setBezeled:NO];
     [messageLabel setDrawsBackground:NO];
     [messageLabel setEditable:NO];
     [messageLabel setSelectable:NO];
     
-    // Position progress bar below message
-    NSProgressIndicator *progressBar = [[NSProgressIndicator alloc] initWithFrame:NSMakeRect(20, height - 70, DEFAULT_WIDTH - 40, 20)];
+    NSProgressIndicator *progressBar = [[NSProgressIndicator alloc] initWithFrame:NSZeroRect];
+    [progressBar setAutoresizingMask:NSViewMinYMargin];
     [progressBar setIndeterminate:NO];
     [progressBar setMinValue:0.0];
     [progressBar setMaxValue:100.0];
@@ -181,55 +175,148 @@ void* ShowProgressBarMacOS(const char* title, const char* message, const char* s
     [[panel contentView] addSubview:messageLabel];
     [[panel contentView] addSubview:progressBar];
     
-    [panel center];
-    [panel makeKeyAndOrderFront:nil];
-    
     wrapper.panel = panel;
     wrapper.progressBar = progressBar;
     wrapper.messageLabel = messageLabel;
+    wrapper.style = styleStr;
+    [wrapper layoutWithButtonLabels:std::vector<std::string>()];
+    return wrapper;
+}
+
+// Hidden panels of one style, waiting to be shown. Only touched on the main
+// thread, apart from the stats.
+static WindowPool<ProgressBarWrapper*> window_pool;
+static NSString* pool_style = nil;
+
+extern "C" __attribute__((visibility("default")))
+void* ShowProgressBarMacOS(const char* title, const char* message, const char* style,
+                          const char** buttonLabels, int buttonCount, ButtonCallback callback,
+                          void* userData) {
+    if (title == nullptr) title = "Progress";
+    if (message == nullptr) message = "";
+    if (style == nullptr) style = "default";
+    
+    NSString* styleStr = [NSString stringWithUTF8String:style];
+    ProgressBarWrapper* wrapper = nil;
+    if (![styleStr isEqualToString:pool_style] || !window_pool.Take(&wrapper)) {
+        wrapper = BuildProgressBarWrapper(styleStr);
+    }
+    wrapper.userData = userData;
+    
+    [NSApp setActivationPolicy:NSApplicationActivationPolicyRegular];
+    [NSApp activateIgnoringOtherApps:YES];
+    
+    std::vector<std::string> labels;
+    for (int i = 0; buttonLabels && i < buttonCount; i++) {
+        labels.push_back(buttonLabels[i] ? buttonLabels[i] : "");
+    }
+    [wrapper layoutWithButtonLabels:labels];
+    wrapper.buttonCallback = callback;
+
+    NSPanel* panel = wrapper.panel;
+    [panel setTitle:[NSString stringWithUTF8String:title]];
+    [wrapper.messageLabel setStringValue:[NSString stringWithUTF8String:message]];
+    
+    [panel center];
+    [panel makeKeyAndOrderFront:nil];
+    
+    wrapper.pixelWidth = wrapper.progressBar.frame.size.width * panel.backingScaleFactor;
+    
+    return (__bridge_retained void*)wrapper;
+}
+
+extern "C" __attribute__((visibility("default")))
+void PrewarmProgressBarsMacOS(size_t count, const char* style) {
+    @autoreleasepool {
+        NSString* styleStr = [NSString stringWithUTF8String:style ? style : "default"];
+        // One style at a time, the pool's panels are of the last one asked for
+        if (![styleStr isEqualToString:pool_style]) {
+            window_pool.Prewarm(0, [] { return (ProgressBarWrapper*)nil; },
+                                [](ProgressBarWrapper* wrapper) { [wrapper.panel close]; });
+            pool_style = styleStr;
+        }
+
+        window_pool.Prewarm(count, [styleStr] { return BuildProgressBarWrapper(styleStr); },
+                            [](ProgressBarWrapper* wrapper) { [wrapper.panel close]; });
+    }
+}
+
+extern "C" __attribute__((visibility("default")))
+void GetProgressBarPoolStatsMacOS(WindowPoolStats* stats) {
+    window_pool.GetStats(stats);
+}
+
+// An update, converted to Cocoa types on the calling thread so that it can be
+// applied on the main queue later
+@interface ProgressBarPendingUpdate : NSObject {
+@public
+    // Copied as they are, the layout works in UTF-8
+    std::vector<std::string> _buttonLabels;
+}
+@property ProgressBarWrapper* wrapper;
+@property (nonatomic) double progress;
+@property NSString* message;
+@property (nonatomic) BOOL updateButtons;
+@property (nonatomic) ButtonCallback callback;
+@end
+
+@implementation ProgressBarPendingUpdate
+@end
+
+static ProgressBarPendingUpdate* PrepareUpdate(void* handle, double progress, const char* message,
+                                               bool updateButtons, const char** buttonLabels, int buttonCount,
+                                               ButtonCallback callback) {
+    ProgressBarWrapper* wrapper = (__bridge ProgressBarWrapper*)handle;
+    if (!wrapper) {
+        NSLog(@"Wrapper is null");
+        return nil;
+    }
+    
+    if (!wrapper.progressBar) {
+        NSLog(@"Progress bar is null");
+        return nil;
+    }
+    
+    // Create NSString from message outside the async block
+    NSString* messageStr = nil;
+    if (message != nullptr) {
+        messageStr = [NSString stringWithUTF8String:message];
+    }
     
-    // Add buttons if provided
-    if (buttonLabels && buttonCount > 0) {
-        CGFloat buttonWidth = 100;
-        CGFloat buttonHeight = 30;
-        CGFloat buttonSpacing = 10;
-        CGFloat startX = panel.frame.size.width - (buttonWidth + 20);
-        CGFloat buttonY = 20;  // Position buttons at the bottom
-        
+    // Verify button data
+    if (buttonCount > 0 && buttonLabels == nullptr) {
+        NSLog(@"Button labels array is null but count is %d", buttonCount);
+        buttonCount = 0;
+    }
+    
+    ProgressBarPendingUpdate* update = [[ProgressBarPendingUpdate alloc] init];
+    update.wrapper = wrapper;
+    update.progress = progress;
+    update.message = messageStr;
+    update.updateButtons = updateButtons;
+    update.callback = callback;
+    if (updateButtons) {
         for (int i = 0; i < buttonCount; i++) {
-            if (!buttonLabels[i]) {
-                NSLog(@"Warning: Button label at index %d is null", i);
-                continue;
-            }
-            
-            // Create an NSString using UTF8 encoding explicitly
-            NSString* label = [[NSString alloc] initWithBytes:buttonLabels[i] 
-                                                     length:strlen(buttonLabels[i]) 
-                                                   encoding:NSUTF8StringEncoding];
-            
-            if (!label) {
-                NSLog(@"Warning: Failed to create NSString from button label at index %d", i);
-                continue;
-            }
-            
-            NSButton* button = [[NSButton alloc] initWithFrame:NSMakeRect(startX, buttonY, buttonWidth, buttonHeight)];
-            [button setTitle:label];
-            [button setBezelStyle:NSBezelStyleRounded];
-            [button setTarget:wrapper];
-            [button setAction:@selector(buttonClicked:)];
-            [[panel contentView] addSubview:button];
-            [wrapper.buttons addObject:button];
-            
-            ButtonInfo* info = [[ButtonInfo alloc] init];
-            info.index = i;
-            info.callback = callback;
-            [wrapper.buttonCallbacks addObject:info];
-            
-            startX -= (buttonWidth + buttonSpacing);
+            update->_buttonLabels.push_back(buttonLabels[i] ? buttonLabels[i] : "");
         }
     }
+    return update;
+}
+
+// Runs on the main queue
+static void ApplyUpdate(ProgressBarPendingUpdate* update) {
+    ProgressBarWrapper* wrapper = update.wrapper;
+    [wrapper.progressBar setDoubleValue:update.progress];
     
-    return (__bridge_retained void*)wrapper;
+    if (update.message != nil && wrapper.messageLabel != nil) {
+        [wrapper.messageLabel setStringValue:update.message];
+    }
+    
+    // Only update buttons if updateButtons is true
+    if (update.updateButtons) {
+        [wrapper layoutWithButtonLabels:update->_buttonLabels];
+        wrapper.buttonCallback = update.callback;
+    }
 }
 
 extern "C" __attribute__((visibility("default")))
@@ -242,103 +329,90 @@ void UpdateProgressBarMacOS(void* handle, double progress, const char* message,
     
     @autoreleasepool {
         @try {
-            ProgressBarWrapper* wrapper = (__bridge ProgressBarWrapper*)handle;
-            if (!wrapper) {
-                NSLog(@"Wrapper is null");
+            ProgressBarPendingUpdate* update = PrepareUpdate(handle, progress, message, updateButtons,
+                                                             buttonLabels, buttonCount, callback);
+            if (!update) {
                 return;
             }
             
-            if (!wrapper.progressBar) {
-                NSLog(@"Progress bar is null");
-                return;
-            }
-            
-            // Create NSString from message outside the async block
-            NSString* messageStr = nil;
-            if (message != nullptr) {
-                messageStr = [NSString stringWithUTF8String:message];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                ApplyUpdate(update);
+            });
+        } @catch (NSException *exception) {
+            NSLog(@"Exception in UpdateProgressBarMacOS: %@", exception);
+            NSLog(@"Exception reason: %@", [exception reason]);
+        }
+    }
+}
+
+// Applies a whole frame's worth of updates with a single hop to the main queue
+extern "C" __attribute__((visibility("default")))
+void UpdateProgressBarsMacOS(const ProgressBarUpdate* updates, size_t count) {
+    @autoreleasepool {
+        @try {
+            NSMutableArray<ProgressBarPendingUpdate*>* pending = [NSMutableArray arrayWithCapacity:count];
+            for (size_t i = 0; i < count; i++) {
+                const ProgressBarUpdate& update = updates[i];
+                if (update.handle == nullptr) {
+                    continue;
+                }
+
+                ProgressBarPendingUpdate* prepared = PrepareUpdate(
+                    update.handle, update.progress, update.message, update.updateButtons,
+                    update.buttonLabels, static_cast<int>(update.buttonCount), update.callback);
+                if (prepared) {
+                    [pending addObject:prepared];
+                }
             }
-            
-            // Verify button data
-            if (buttonCount > 0 && buttonLabels == nullptr) {
-                NSLog(@"Button labels array is null but count is %d", buttonCount);
-                buttonCount = 0;
+
+            if (pending.count == 0) {
+                return;
             }
-            
-            // Move button processing inside updateButtons check
-            NSMutableArray* pendingButtons = [NSMutableArray array];
-            if (updateButtons && buttonCount > 0) {
-                if (buttonLabels == nullptr) {
-                    NSLog(@"Button labels array is null but count is %d", buttonCount);
-                    buttonCount = 0;
-                } else {
-                    // Create the pending buttons array only if we're updating buttons
-                    for (int i = 0; i < buttonCount; i++) {
-                        if (buttonLabels[i] != nullptr) {
-                            const char* label = strdup(buttonLabels[i]);
-                            NSString* labelStr = [NSString stringWithUTF8String:label];
-                            free((void*)label);
-                            
-                            if (labelStr) {
-                                [pendingButtons addObject:@{
-                                    @"label": labelStr,
-                                    @"index": @(i)
-                                }];
-                            }
-                        }
-                    }
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                for (ProgressBarPendingUpdate* update in pending) {
+                    ApplyUpdate(update);
                 }
-            }
-            
+            });
+        } @catch (NSException *exception) {
+            NSLog(@"Exception in UpdateProgressBarsMacOS: %@", exception);
+            NSLog(@"Exception reason: %@", [exception reason]);
+        }
+    }
+}
+
+extern "C" __attribute__((visibility("default")))
+double GetProgressBarPixelWidthMacOS(void* handle) {
+    if (!handle) return 0;
+    ProgressBarWrapper* wrapper = (__bridge ProgressBarWrapper*)handle;
+    return wrapper.pixelWidth;
+}
+
+extern "C" __attribute__((visibility("default")))
+void SetProgressBarIndeterminateMacOS(void* handle, bool indeterminate) {
+    if (handle == nullptr) {
+        return;
+    }
+
+    @autoreleasepool {
+        @try {
+            ProgressBarWrapper* wrapper = (__bridge ProgressBarWrapper*)handle;
             dispatch_async(dispatch_get_main_queue(), ^{
-                [wrapper.progressBar setDoubleValue:progress];
-                
-                if (messageStr != nil && wrapper.messageLabel != nil) {
-                    [wrapper.messageLabel setStringValue:messageStr];
+                NSProgressIndicator* progressBar = wrapper.progressBar;
+                if (!progressBar) {
+                    return;
                 }
-                
-                // Only update buttons if updateButtons is true
-                if (updateButtons) {
-                    [wrapper clearButtons];
-                    
-                    if (pendingButtons.count > 0) {
-                        CGFloat buttonWidth = 100;
-                        CGFloat buttonSpacing = 10;
-                        CGFloat startX = wrapper.panel.frame.size.width - (buttonWidth + 20);
-                        CGFloat buttonY = 20;
-                        
-                        for (NSDictionary* buttonData in pendingButtons) {
-                            NSString* label = buttonData[@"label"];
-                            NSNumber* index = buttonData[@"index"];
-                            
-                            NSButton* button = [[NSButton alloc] init];
-                            [button setTitle:label];
-                            [button setBezelStyle:NSBezelStyleRounded];
-                            [button sizeToFit];
-                            
-                            CGFloat buttonWidth = button.frame.size.width + 20;
-                            CGFloat buttonHeight = button.frame.size.height;
-                            
-                            [button setFrame:NSMakeRect(startX, buttonY, buttonWidth, buttonHeight)];
-                            [button setTarget:wrapper];
-                            [button setAction:@selector(buttonClicked:)];
-                            [[wrapper.panel contentView] addSubview:button];
-                            [wrapper.buttons addObject:button];
-                            
-                            ButtonInfo* info = [[ButtonInfo alloc] init];
-                            info.index = [index intValue];
-                            info.callback = callback;
-                            [wrapper.buttonCallbacks addObject:info];
-                            
-                            startX -= (buttonWidth + buttonSpacing);
-                        }
-                    }
-                    
-                    [wrapper relayoutButtons];
+
+                if (indeterminate) {
+                    [progressBar setIndeterminate:YES];
+                    [progressBar startAnimation:nil];
+                } else {
+                    [progressBar stopAnimation:nil];
+                    [progressBar setIndeterminate:NO];
                 }
             });
         } @catch (NSException *exception) {
-            NSLog(@"Exception in UpdateProgressBarMacOS: %@", exception);
+            NSLog(@"Exception in SetProgressBarIndeterminateMacOS: %@", exception);
             NSLog(@"Exception reason: %@", [exception reason]);
         }
     }
@@ -353,8 +427,21 @@ void CloseProgressBarMacOS(void* handle) {
     @autoreleasepool {
         @try {
             ProgressBarWrapper* wrapper = (__bridge ProgressBarWrapper*)handle;
+            // The caller may free userData as soon as we return
+            wrapper.userData = nullptr;
             if (wrapper.panel) {
                 dispatch_async(dispatch_get_main_queue(), ^{
+                    // Back to the state BuildProgressBarWrapper() left it in,
+                    // in case the pool takes it
+                    [wrapper.panel orderOut:nil];
+                    [wrapper layoutWithButtonLabels:std::vector<std::string>()];
+                    [wrapper.progressBar stopAnimation:nil];
+                    [wrapper.progressBar setIndeterminate:NO];
+                    [wrapper.progressBar setDoubleValue:0.0];
+                    if ([wrapper.style isEqualToString:pool_style] && window_pool.Return(wrapper)) {
+                        return;
+                    }
+
                     [wrapper.panel close];
                     wrapper.panel = nil;
                     wrapper.progressBar = nil;
@@ -367,3 +454,278 @@ void CloseProgressBarMacOS(void* handle) {
         }
     }
 }
+
+// Progress groups: one panel with a table of progress rows. The table only
+// creates views for the rows that are scrolled into view and reuses them as
+// rows scroll by.
+
+#define GROUP_HEIGHT 320
+#define GROUP_ROW_HEIGHT 48
+
+static NSString* const kProgressGroupRowIdentifier = @"ProgressGroupRow";
+
+// Each handle owns a retain, so closing one twice must be harmless
+static std::mutex groups_mutex;
+static std::unordered_set<void*> live_groups;
+
+@interface ProgressGroupRow : NSObject
+@property (nonatomic) uint32_t rowId;
+@property (nonatomic) double progress;
+@property (nonatomic, copy) NSString* message;
+@end
+
+@implementation ProgressGroupRow
+@end
+
+// A row change, copied out of the caller's buffers before it crosses over to
+// the main queue
+@interface ProgressGroupOp : NSObject
+@property (nonatomic) uint32_t rowId;
+@property (nonatomic) uint32_t op;
+@property (nonatomic) BOOL hasProgress;
+@property (nonatomic) double progress;
+@property (nonatomic, copy) NSString* message;
+@end
+
+@implementation ProgressGroupOp
+@end
+
+@interface ProgressGroupRowView : NSTableCellView
+@property NSTextField* messageLabel;
+@property NSProgressIndicator* progressBar;
+@end
+
+@implementation ProgressGroupRowView
+- (instancetype)initWithFrame:(NSRect)frame {
+    self = [super initWithFrame:frame];
+    if (self) {
+        self.identifier = kProgressGroupRowIdentifier;
+
+        self.messageLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(0, 24, frame.size.width, 20)];
+        [self.messageLabel setBezeled:NO];
+        [self.messageLabel setDrawsBackground:NO];
+        [self.messageLabel setEditable:NO];
+        [self.messageLabel setSelectable:NO];
+        [self.messageLabel setLineBreakMode:NSLineBreakByTruncatingMiddle];
+        [self.messageLabel setAutoresizingMask:NSViewWidthSizable];
+        [self addSubview:self.messageLabel];
+
+        self.progressBar = [[NSProgressIndicator alloc] initWithFrame:NSMakeRect(0, 4, frame.size.width, 20)];
+        [self.progressBar setIndeterminate:NO];
+        [self.progressBar setMinValue:0.0];
+        [self.progressBar setMaxValue:100.0];
+        [self.progressBar setAutoresizingMask:NSViewWidthSizable];
+        [self addSubview:self.progressBar];
+    }
+    return self;
+}
+
+- (void)showRow:(ProgressGroupRow*)row {
+    [self.messageLabel setStringValue:row.message ?: @""];
+    [self.progressBar setDoubleValue:row.progress];
+}
+@end
+
+@interface ProgressGroupWrapper : NSObject <NSTableViewDataSource, NSTableViewDelegate>
+@property NSPanel* panel;
+@property NSTableView* tableView;
+@property NSMutableArray<ProgressGroupRow*>* rows;
+@property NSMutableDictionary<NSNumber*, ProgressGroupRow*>* rowsById;
+
+- (void)applyOps:(NSArray<ProgressGroupOp*>*)ops;
+@end
+
+@implementation ProgressGroupWrapper
+- (NSInteger)numberOfRowsInTableView:(NSTableView*)tableView {
+    return self.rows.count;
+}
+
+- (NSView*)tableView:(NSTableView*)tableView viewForTableColumn:(NSTableColumn*)tableColumn row:(NSInteger)row {
+    ProgressGroupRowView* view = [tableView makeViewWithIdentifier:kProgressGroupRowIdentifier owner:self];
+    if (!view) {
+        view = [[ProgressGroupRowView alloc] initWithFrame:NSMakeRect(0, 0, tableColumn.width, GROUP_ROW_HEIGHT)];
+    }
+    [view showRow:self.rows[row]];
+    return view;
+}
+
+- (BOOL)tableView:(NSTableView*)tableView shouldSelectRow:(NSInteger)row {
+    return NO;
+}
+
+// Runs on the main queue
+- (void)applyOps:(NSArray<ProgressGroupOp*>*)ops {
+    if (!self.tableView) {
+        return;
+    }
+
+    NSMutableSet<ProgressGroupRow*>* changed = [NSMutableSet set];
+
+    [self.tableView beginUpdates];
+    for (ProgressGroupOp* op in ops) {
+        NSNumber* key = @(op.rowId);
+        ProgressGroupRow* row = self.rowsById[key];
+
+        if (op.op == PROGRESS_GROUP_ROW_REMOVE) {
+            if (!row) continue;
+
+            NSUInteger index = [self.rows indexOfObjectIdenticalTo:row];
+            [self.rows removeObjectAtIndex:index];
+            [self.rowsById removeObjectForKey:key];
+            [changed removeObject:row];
+            [self.tableView removeRowsAtIndexes:[NSIndexSet indexSetWithIndex:index]
+                                  withAnimation:NSTableViewAnimationEffectNone];
+            continue;
+        }
+
+        if (!row) {
+            if (op.op != PROGRESS_GROUP_ROW_ADD) continue;
+
+            row = [[ProgressGroupRow alloc] init];
+            row.rowId = op.rowId;
+            [self.rows addObject:row];
+            self.rowsById[key] = row;
+            [self.tableView insertRowsAtIndexes:[NSIndexSet indexSetWithIndex:self.rows.count - 1]
+                                  withAnimation:NSTableViewAnimationEffectNone];
+        }
+
+        if (op.hasProgress) {
+            row.progress = op.progress;
+        }
+        if (op.message) {
+            row.message = op.message;
+        }
+        [changed addObject:row];
+    }
+    [self.tableView endUpdates];
+
+    // Reloading only asks for new views of rows that are on screen
+    NSRange visible = [self.tableView rowsInRect:self.tableView.visibleRect];
+    NSMutableIndexSet* reload = [NSMutableIndexSet indexSet];
+    for (NSUInteger i = visible.location; i < NSMaxRange(visible) && i < self.rows.count; i++) {
+        if ([changed containsObject:self.rows[i]]) {
+            [reload addIndex:i];
+        }
+    }
+    if (reload.count > 0) {
+        [self.tableView reloadDataForRowIndexes:reload columnIndexes:[NSIndexSet indexSetWithIndex:0]];
+    }
+}
+@end
+
+extern "C" __attribute__((visibility("default")))
+void* ShowProgressGroupMacOS(const char* title, const char* style) {
+    if (title == nullptr) title = "Progress";
+    if (style == nullptr) style = "default";
+
+    ProgressGroupWrapper* wrapper = [[ProgressGroupWrapper alloc] init];
+    wrapper.rows = [NSMutableArray array];
+    wrapper.rowsById = [NSMutableDictionary dictionary];
+
+    [NSApplication sharedApplication];
+    [NSApp setActivationPolicy:NSApplicationActivationPolicyRegular];
+    [NSApp activateIgnoringOtherApps:YES];
+
+    NSWindowStyleMask styleMask = NSWindowStyleMaskTitled | NSWindowStyleMaskNonactivatingPanel |
+                                  NSWindowStyleMaskResizable;
+
+    NSString* styleStr = [NSString stringWithUTF8String:style];
+    if ([styleStr isEqualToString:@"hud"]) {
+        styleMask |= NSWindowStyleMaskHUDWindow;
+    } else if ([styleStr isEqualToString:@"utility"]) {
+        styleMask |= NSWindowStyleMaskUtilityWindow;
+    }
+
+    NSPanel* panel = [[NSPanel alloc] initWithContentRect:NSMakeRect(0, 0, DEFAULT_WIDTH, GROUP_HEIGHT)
+                                                styleMask:styleMask
+                                                  backing:NSBackingStoreBuffered
+                                                    defer:NO];
+
+    if ([styleStr isEqualToString:@"hud"]) {
+        panel.appearance = [NSAppearance appearanceNamed:NSAppearanceNameVibrantDark];
+    }
+
+    [panel setTitle:[NSString stringWithUTF8String:title]];
+    [panel setLevel:NSFloatingWindowLevel];
+    [panel setHidesOnDeactivate:NO];
+
+    NSScrollView* scrollView = [[NSScrollView alloc] initWithFrame:[[panel contentView] bounds]];
+    [scrollView setHasVerticalScroller:YES];
+    [scrollView setDrawsBackground:NO];
+    [scrollView setAutoresizingMask:NSViewWidthSizable | NSViewHeightSizable];
+
+    NSTableView* tableView = [[NSTableView alloc] initWithFrame:scrollView.bounds];
+    NSTableColumn* column = [[NSTableColumn alloc] initWithIdentifier:kProgressGroupRowIdentifier];
+    [column setWidth:DEFAULT_WIDTH - 40];
+    [column setResizingMask:NSTableColumnAutoresizingMask];
+    [tableView addTableColumn:column];
+    [tableView setHeaderView:nil];
+    [tableView setRowHeight:GROUP_ROW_HEIGHT];
+    [tableView setIntercellSpacing:NSMakeSize(20, 0)];
+    [tableView setBackgroundColor:[NSColor clearColor]];
+    [tableView setColumnAutoresizingStyle:NSTableViewUniformColumnAutoresizingStyle];
+    [tableView setDataSource:wrapper];
+    [tableView setDelegate:wrapper];
+
+    [scrollView setDocumentView:tableView];
+    [[panel contentView] addSubview:scrollView];
+
+    [panel center];
+    [panel makeKeyAndOrderFront:nil];
+
+    wrapper.panel = panel;
+    wrapper.tableView = tableView;
+
+    void* handle = (__bridge_retained void*)wrapper;
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    live_groups.insert(handle);
+    return handle;
+}
+
+extern "C" __attribute__((visibility("default")))
+void UpdateProgressGroupMacOS(void* handle, const ProgressGroupRowUpdate* updates, size_t count) {
+    if (handle == nullptr || count == 0) {
+        return;
+    }
+
+    @autoreleasepool {
+        ProgressGroupWrapper* wrapper = (__bridge ProgressGroupWrapper*)handle;
+
+        NSMutableArray<ProgressGroupOp*>* ops = [NSMutableArray arrayWithCapacity:count];
+        for (size_t i = 0; i < count; i++) {
+            ProgressGroupOp* op = [[ProgressGroupOp alloc] init];
+            op.rowId = updates[i].id;
+            op.op = updates[i].op;
+            op.hasProgress = updates[i].hasProgress;
+            op.progress = updates[i].progress;
+            if (updates[i].message) {
+                op.message = [NSString stringWithUTF8String:updates[i].message];
+            }
+            [ops addObject:op];
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [wrapper applyOps:ops];
+        });
+    }
+}
+
+extern "C" __attribute__((visibility("default")))
+void CloseProgressGroupMacOS(void* handle) {
+    {
+        std::lock_guard<std::mutex> lock(groups_mutex);
+        if (live_groups.erase(handle) == 0) {
+            return;
+        }
+    }
+
+    // Balances the retain from ShowProgressGroupMacOS once the block is done
+    ProgressGroupWrapper* wrapper = (__bridge_transfer ProgressGroupWrapper*)handle;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [wrapper.tableView setDataSource:nil];
+        [wrapper.tableView setDelegate:nil];
+        [wrapper.panel close];
+        wrapper.panel = nil;
+        wrapper.tableView = nil;
+    });
+}
@@ -0,0 +1,601 @@
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "progress_bar_terminal.h"
+#include "utf16.h"
+
+// Changed bars are printed at most this often when stderr isn't a TTY
+static const std::chrono::seconds kPlainLineInterval(5);
+// How often indeterminate bars move by one cell
+static const std::chrono::milliseconds kAnimationInterval(100);
+
+struct TerminalRow {
+    uint32_t id = 0;
+    double progress = 0;
+    std::string message;
+    bool changed = true;
+};
+
+// A bar, or a group and its rows
+struct TerminalItem {
+    bool isGroup = false;
+    std::string title;
+    std::string message;
+    double progress = 0;
+    bool indeterminate = false;
+    // See SetProgressBarSparklineTerminal()
+    std::vector<float> sparkline;
+    std::vector<TerminalRow> rows;
+    std::unordered_map<uint32_t, size_t> rowIndex;
+
+    // Only used for plain output
+    bool changed = true;
+    std::chrono::steady_clock::time_point printedAt;
+};
+
+static std::mutex terminal_mutex;
+// Open bars and groups, top to bottom
+static std::vector<TerminalItem*> items;
+// What is on screen, one entry per line. The cursor sits at the start of the
+// line below.
+static std::vector<std::u32string> screen;
+static unsigned short screen_columns = 0;
+static bool screen_dirty = false;
+// Bars that currently show an animation instead of their progress
+static size_t indeterminate_count = 0;
+
+static bool IsTerminal() {
+    static const bool terminal = isatty(STDERR_FILENO) == 1;
+    return terminal;
+}
+
+static void GetTerminalSize(unsigned short* columns, unsigned short* rows) {
+    struct winsize size = {};
+    if (ioctl(STDERR_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0) {
+        size.ws_col = 80;
+        size.ws_row = 24;
+    }
+    *columns = size.ws_col;
+    *rows = size.ws_row;
+}
+
+static void WriteAll(const std::string& out) {
+    const char* data = out.data();
+    size_t left = out.size();
+    while (left > 0) {
+        ssize_t written = write(STDERR_FILENO, data, left);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Nobody to tell; a progress bar isn't worth blocking for
+            return;
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+}
+
+// Invalid sequences decode to U+FFFD. Every code point is taken to fill one
+// cell, which holds for everything but wide East Asian characters and emoji.
+static void AppendDecodedUtf8(std::u32string& out, const std::string& text) {
+    size_t i = 0;
+    while (i < text.size()) {
+        char32_t codePoint = DecodeUtf8(text.data(), text.size(), &i);
+        // Control characters would move the cursor behind our back
+        out.push_back(codePoint < 0x20 || codePoint == 0x7f ? U' ' : codePoint);
+    }
+}
+
+static void AppendEncodedUtf8(std::string& out, const std::u32string& text, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        char32_t c = text[i];
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+        } else if (c < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xf0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3f)));
+        }
+    }
+}
+
+static void AppendAscii(std::u32string& out, const char* text) {
+    while (*text) {
+        out.push_back(static_cast<unsigned char>(*text++));
+    }
+}
+
+// Whole percent, rounded down like the core's pixel filter
+static int Percent(double progress) {
+    return static_cast<int>(std::floor(std::min(100.0, std::max(0.0, progress))));
+}
+
+// Appends `text` cut or padded to exactly `width` cells
+static void AppendFitted(std::u32string& out, const std::string& text, size_t width) {
+    size_t start = out.size();
+    AppendDecodedUtf8(out, text);
+    if (out.size() - start > width) {
+        out.resize(start + (width >= 3 ? width - 3 : 0));
+        out.append(width >= 3 ? 3 : width, U'.');
+    } else {
+        out.append(width - (out.size() - start), U' ');
+    }
+}
+
+static size_t AnimationFrame() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<size_t>((std::chrono::steady_clock::now() - epoch) / kAnimationInterval);
+}
+
+// Where the inside of a bar starts on its line, and how wide it is
+static void GetBarGeometry(size_t indent, size_t columns, size_t* labelWidth, size_t* barWidth) {
+    // The last column is left alone, so the terminal never wraps the line
+    size_t width = columns > 1 ? columns - 1 : 1;
+    *barWidth = std::min<size_t>(40, std::max<size_t>(10, width / 3));
+    size_t fixed = indent + *barWidth + 8;
+
+    if (width > fixed) {
+        *labelWidth = width - fixed;
+    } else {
+        *labelWidth = 0;
+        *barWidth = width > indent + 8 ? width - indent - 8 : 0;
+    }
+}
+
+//   label                       [=============>          ]  57%
+//   label                       [        <=>             ]
+//
+// A negative progress draws the latter, a block bouncing between the ends.
+static std::u32string LayoutBarLine(const std::string& label, double progress, size_t indent,
+                                    size_t columns) {
+    size_t labelWidth, barWidth;
+    GetBarGeometry(indent, columns, &labelWidth, &barWidth);
+
+    std::u32string line(indent, U' ');
+    if (labelWidth > 0) {
+        AppendFitted(line, label, labelWidth);
+    }
+
+    if (progress < 0) {
+        size_t travel = barWidth > 3 ? barWidth - 3 : 0;
+        size_t position = travel > 0 ? AnimationFrame() % (2 * travel) : 0;
+        if (position > travel) {
+            position = 2 * travel - position;
+        }
+
+        AppendAscii(line, " [");
+        line.append(position, U' ');
+        line.append(U"<=>", std::min<size_t>(3, barWidth));
+        line.append(barWidth - position - std::min<size_t>(3, barWidth), U' ');
+        AppendAscii(line, "]     ");
+        return line;
+    }
+
+    size_t filled = static_cast<size_t>(Percent(progress) * barWidth / 100);
+    AppendAscii(line, " [");
+    line.append(filled, U'=');
+    if (filled < barWidth) {
+        line.push_back(filled > 0 ? U'>' : U' ');
+        line.append(barWidth - filled - 1, U' ');
+    }
+
+    char percent[8];
+    snprintf(percent, sizeof(percent), "] %3d%%", Percent(progress));
+    AppendAscii(line, percent);
+    return line;
+}
+
+//   label                       [=============>          ]  57%
+//                                      ▂▃▅▇█▆▅▅▃▂▁
+//
+// The latest level ends where the bar does. A level of 0 is left blank, so
+// that stalls stand out.
+static std::u32string LayoutSparklineLine(const std::vector<float>& levels, size_t columns) {
+    static const char32_t kBlocks[] = U"\u2581\u2582\u2583\u2584\u2585\u2586\u2587\u2588";
+
+    size_t labelWidth, barWidth;
+    GetBarGeometry(0, columns, &labelWidth, &barWidth);
+    size_t shown = std::min(levels.size(), barWidth);
+
+    std::u32string line(labelWidth + 2 + barWidth - shown, U' ');
+    for (size_t i = levels.size() - shown; i < levels.size(); i++) {
+        float level = std::min(1.0f, std::max(0.0f, levels[i]));
+        line.push_back(level > 0 ? kBlocks[std::min<size_t>(7, static_cast<size_t>(level * 8))] : U' ');
+    }
+    return line;
+}
+
+static void LayoutScreen(std::vector<std::u32string>& lines, unsigned short columns, unsigned short rows) {
+    for (const TerminalItem* item : items) {
+        if (!item->isGroup) {
+            lines.push_back(LayoutBarLine(item->message.empty() ? item->title : item->message,
+                                          item->indeterminate ? -1 : item->progress, 0, columns));
+            if (!item->sparkline.empty()) {
+                lines.push_back(LayoutSparklineLine(item->sparkline, columns));
+            }
+            continue;
+        }
+
+        std::u32string title;
+        AppendFitted(title, item->title, columns > 1 ? columns - 1 : 1);
+        lines.push_back(title);
+        for (const TerminalRow& row : item->rows) {
+            lines.push_back(LayoutBarLine(row.message, row.progress, 2, columns));
+        }
+    }
+
+    // Lines scrolled off the top can't be redrawn, so stay within the screen
+    size_t maxLines = rows > 1 ? rows - 1u : 1u;
+    if (lines.size() > maxLines) {
+        size_t hidden = lines.size() - maxLines + 1;
+        lines.resize(maxLines - 1);
+
+        char more[48];
+        snprintf(more, sizeof(more), "... and %zu more", hidden);
+        lines.emplace_back();
+        AppendAscii(lines.back(), more);
+    }
+}
+
+static void AppendCursorMove(std::string& out, size_t count, char direction) {
+    char sequence[24];
+    int length = snprintf(sequence, sizeof(sequence), "\x1b[%zu%c", count, direction);
+    out.append(sequence, length);
+}
+
+// Rewrites the lines that changed, and within each of them only the cells
+// between the first and the last change
+static void RenderTerminal(std::string& out) {
+    unsigned short columns, rows;
+    GetTerminalSize(&columns, &rows);
+
+    // A resize may have rewrapped what is on screen, so start over
+    if (columns != screen_columns && !screen.empty()) {
+        AppendCursorMove(out, screen.size(), 'A');
+        out.append("\r\x1b[J");
+        screen.clear();
+    }
+    screen_columns = columns;
+
+    std::vector<std::u32string> lines;
+    LayoutScreen(lines, columns, rows);
+
+    size_t first = 0;
+    while (first < lines.size() && first < screen.size() && lines[first] == screen[first]) {
+        first++;
+    }
+    if (first == lines.size() && first == screen.size()) {
+        return;
+    }
+
+    if (first < screen.size()) {
+        AppendCursorMove(out, screen.size() - first, 'A');
+    }
+
+    for (size_t i = first; i < lines.size(); i++) {
+        const std::u32string& line = lines[i];
+        if (i >= screen.size()) {
+            AppendEncodedUtf8(out, line, 0, line.size());
+            out.push_back('\n');
+            continue;
+        }
+
+        const std::u32string& old = screen[i];
+        size_t begin = 0;
+        while (begin < line.size() && begin < old.size() && line[begin] == old[begin]) {
+            begin++;
+        }
+
+        size_t end = line.size();
+        if (line.size() == old.size()) {
+            while (end > begin && line[end - 1] == old[end - 1]) {
+                end--;
+            }
+        }
+
+        if (begin < end || line.size() < old.size()) {
+            if (begin > 0) {
+                AppendCursorMove(out, begin + 1, 'G');
+            }
+            AppendEncodedUtf8(out, line, begin, end);
+            if (line.size() < old.size()) {
+                out.append("\x1b[K");
+            }
+        }
+        out.push_back('\n');
+    }
+
+    if (lines.size() < screen.size()) {
+        out.append("\x1b[J");
+    }
+    screen.swap(lines);
+}
+
+static void AppendPlainLine(std::string& out, const std::string& label, double progress) {
+    out.append(label);
+    if (progress < 0) {
+        out.append(" ...\n");
+        return;
+    }
+
+    char percent[8];
+    int length = snprintf(percent, sizeof(percent), " %d%%\n", Percent(progress));
+    out.append(percent, length);
+}
+
+static void AppendPlainItem(std::string& out, TerminalItem* item) {
+    if (!item->isGroup) {
+        AppendPlainLine(out, item->message.empty() ? item->title : item->message,
+                        item->indeterminate ? -1 : item->progress);
+    } else {
+        for (TerminalRow& row : item->rows) {
+            if (row.changed) {
+                AppendPlainLine(out, item->title + ": " + row.message, row.progress);
+                row.changed = false;
+            }
+        }
+    }
+    item->changed = false;
+}
+
+// Prints the bars that changed and haven't been printed for a while, or
+// have just finished
+static void RenderPlain(std::string& out) {
+    auto now = std::chrono::steady_clock::now();
+    for (TerminalItem* item : items) {
+        if (item->changed && (now - item->printedAt >= kPlainLineInterval ||
+                              (!item->isGroup && item->progress >= 100))) {
+            AppendPlainItem(out, item);
+            item->printedAt = now;
+        }
+    }
+}
+
+// Moves indeterminate bars along while nothing else redraws them. Started with
+// the first one, stopped and joined when the module is unloaded.
+struct TerminalAnimator {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    bool stopping = false;
+
+    void Start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!thread.joinable() && !stopping) {
+            thread = std::thread([this] { Run(); });
+        }
+        wake.notify_one();
+    }
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            {
+                std::lock_guard<std::mutex> terminalLock(terminal_mutex);
+                if (indeterminate_count > 0) {
+                    screen_dirty = true;
+                }
+            }
+            lock.unlock();
+            EndFrameTerminal();
+            lock.lock();
+
+            wake.wait_for(lock, kAnimationInterval, [this] { return stopping; });
+            // Sleep until the next bar turns indeterminate
+            wake.wait(lock, [this] {
+                std::lock_guard<std::mutex> terminalLock(terminal_mutex);
+                return stopping || indeterminate_count > 0;
+            });
+        }
+    }
+
+    ~TerminalAnimator() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+};
+
+// Declared after the state it draws, so it is destroyed first
+static TerminalAnimator animator;
+
+void* ShowProgressBarTerminal(
+    const char* title,
+    const char* message,
+    const char* style,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void*, int),
+    void* userData) {
+
+    TerminalItem* item = new TerminalItem();
+    item->title = title ? title : "Progress";
+    item->message = message ? message : "";
+
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    items.push_back(item);
+    screen_dirty = true;
+    return item;
+}
+
+void UpdateProgressBarTerminal(
+    void* handle,
+    double progress,
+    const char* message,
+    bool updateButtons,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void*, int)) {
+
+    TerminalItem* item = static_cast<TerminalItem*>(handle);
+    if (!item) return;
+
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    item->progress = progress;
+    if (message) {
+        item->message = message;
+    }
+    item->changed = true;
+    screen_dirty = true;
+}
+
+static void CloseItem(TerminalItem* item) {
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    auto it = std::find(items.begin(), items.end(), item);
+    if (it == items.end()) {
+        return;
+    }
+    items.erase(it);
+    if (item->indeterminate) {
+        indeterminate_count--;
+    }
+
+    // Without a TTY, the last line printed is all that remains of the bar
+    if (!IsTerminal() && item->changed) {
+        std::string out;
+        AppendPlainItem(out, item);
+        WriteAll(out);
+    }
+
+    delete item;
+    screen_dirty = true;
+}
+
+void CloseProgressBarTerminal(void* handle) {
+    CloseItem(static_cast<TerminalItem*>(handle));
+}
+
+double GetProgressBarPixelWidthTerminal(void* handle) {
+    return 100;
+}
+
+void SetProgressBarIndeterminateTerminal(void* handle, bool indeterminate) {
+    TerminalItem* item = static_cast<TerminalItem*>(handle);
+    if (!item) return;
+
+    {
+        std::lock_guard<std::mutex> lock(terminal_mutex);
+        if (item->indeterminate == indeterminate) {
+            return;
+        }
+        item->indeterminate = indeterminate;
+        indeterminate_count += indeterminate ? 1 : -1;
+        item->changed = true;
+        screen_dirty = true;
+    }
+
+    // Without a TTY there is nothing to animate
+    if (indeterminate && IsTerminal()) {
+        animator.Start();
+    }
+}
+
+void SetProgressBarSparklineTerminal(void* handle, const float* levels, size_t count) {
+    TerminalItem* item = static_cast<TerminalItem*>(handle);
+    if (!item) return;
+
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    item->sparkline.assign(levels, levels + count);
+    screen_dirty = true;
+}
+
+void* ShowProgressGroupTerminal(const char* title, const char* style) {
+    TerminalItem* item = new TerminalItem();
+    item->isGroup = true;
+    item->title = title ? title : "Progress";
+
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    items.push_back(item);
+    screen_dirty = true;
+    return item;
+}
+
+void UpdateProgressGroupTerminal(void* handle, const ProgressGroupRowUpdate* updates, size_t count) {
+    TerminalItem* item = static_cast<TerminalItem*>(handle);
+    if (!item) return;
+
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    for (size_t i = 0; i < count; i++) {
+        const ProgressGroupRowUpdate& update = updates[i];
+        auto it = item->rowIndex.find(update.id);
+
+        if (update.op == PROGRESS_GROUP_ROW_REMOVE) {
+            if (it != item->rowIndex.end()) {
+                item->rows.erase(item->rows.begin() + it->second);
+                item->rowIndex.clear();
+                for (size_t row = 0; row < item->rows.size(); row++) {
+                    item->rowIndex[item->rows[row].id] = row;
+                }
+            }
+            continue;
+        }
+
+        if (it == item->rowIndex.end()) {
+            if (update.op != PROGRESS_GROUP_ROW_ADD) {
+                continue;
+            }
+            it = item->rowIndex.emplace(update.id, item->rows.size()).first;
+            item->rows.emplace_back();
+            item->rows.back().id = update.id;
+        }
+
+        TerminalRow& row = item->rows[it->second];
+        if (update.hasProgress) {
+            row.progress = update.progress;
+        }
+        if (update.message) {
+            row.message = update.message;
+        }
+        row.changed = true;
+    }
+    item->changed = true;
+    screen_dirty = true;
+}
+
+void CloseProgressGroupTerminal(void* handle) {
+    CloseItem(static_cast<TerminalItem*>(handle));
+}
+
+void EndFrameTerminal(void) {
+    std::lock_guard<std::mutex> lock(terminal_mutex);
+    if (!screen_dirty) {
+        return;
+    }
+
+    std::string out;
+    if (IsTerminal()) {
+        RenderTerminal(out);
+        screen_dirty = false;
+    } else {
+        // Bars that changed too recently are printed on a later frame
+        RenderPlain(out);
+    }
+
+    if (!out.empty()) {
+        WriteAll(out);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef PROGRESS_BAR_TERMINAL_H
+#define PROGRESS_BAR_TERMINAL_H
+
+#include <stddef.h>
+#include "progress_group.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Terminal backend, for command line tools. Bars and groups are drawn as
+// lines at the bottom of stderr. On a TTY, each frame only rewrites the cells
+// that changed, with a single write(). Otherwise, as in CI logs or pipes,
+// changed bars are printed as plain lines every few seconds.
+//
+// Buttons can't be clicked in a terminal and are not shown. Sparklines are
+// drawn on a line of their own under the bar, on a TTY only.
+
+void* ShowProgressBarTerminal(
+    const char* title,
+    const char* message,
+    const char* style,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void* userData, int buttonIndex),
+    void* userData
+);
+
+void UpdateProgressBarTerminal(
+    void* handle,
+    double progress,
+    const char* message,
+    bool updateButtons,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void* userData, int buttonIndex)
+);
+
+void CloseProgressBarTerminal(void* handle);
+
+// Progress is shown in whole percent, so that's the resolution
+double GetProgressBarPixelWidthTerminal(void* handle);
+
+// Indeterminate bars are animated by a thread of their own, as long as any
+// is shown
+void SetProgressBarIndeterminateTerminal(void* handle, bool indeterminate);
+
+// Draws `levels` with block characters, one cell each, as many of the latest
+// as fit under the bar
+void SetProgressBarSparklineTerminal(void* handle, const float* levels, size_t count);
+
+void* ShowProgressGroupTerminal(const char* title, const char* style);
+
+void UpdateProgressGroupTerminal(void* handle, const ProgressGroupRowUpdate* updates, size_t count);
+
+void CloseProgressGroupTerminal(void* handle);
+
+// Draws whatever changed since the last frame
+void EndFrameTerminal(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROGRESS_BAR_TERMINAL_H
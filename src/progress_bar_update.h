@@ -0,0 +1,29 @@
+#ifndef PROGRESS_BAR_UPDATE_H
+#define PROGRESS_BAR_UPDATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One bar's changes for a frame. Backends that can apply many bars at once
+// (for instance with a single hop to the UI thread) receive all bars of a
+// frame as an array of these.
+typedef struct ProgressBarUpdate {
+    void* handle;
+    double progress;
+    // nullptr if unchanged
+    const char* message;
+    bool updateButtons;
+    const char** buttonLabels;
+    size_t buttonCount;
+    void (*callback)(void* userData, int buttonIndex);
+} ProgressBarUpdate;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROGRESS_BAR_UPDATE_H
@@ -1,15 +1,27 @@
 #define UNICODE
 #define _UNICODE
+#define NOMINMAX
 #include <windows.h>
 #include <commctrl.h>
 #include <shellscalingapi.h>
+#include <algorithm>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "progress_bar_windows.h"
+#include "progress_layout.h"
+#include "utf16.h"
+
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "Windows strings are UTF-16");
 
 #define DEFAULT_WINDOW_WIDTH 500
 #define DEFAULT_WINDOW_HEIGHT 150
-#define DEFAULT_WINDOW_HEIGHT_WITH_BUTTONS 200
+// Client area of a bar, which a 500 pixel wide window has at 96 DPI
+#define CONTENT_WIDTH 484
 #define WINDOW_MARGIN 30
+// Positions of the progress control. Far finer than any bar is wide, so
+// sub-percent progress still moves the fill.
+#define PROGRESS_RANGE 10000
 
 // Add DPI awareness helper
 int GetWindowDpiHelper(HWND hwnd) {
@@ -35,6 +47,29 @@ int ScaleForDpi(int value, int dpi) {
     return MulDiv(value, dpi, 96);
 }
 
+// Stored in GWLP_USERDATA, freed with the window
+struct ProgressBarWindowData {
+    void (*callback)(void*, int) = nullptr;
+    void* userData = nullptr;
+    // What the message control shows
+    Utf16Text message;
+    // Where the controls are, and the buttons in the order of their labels
+    ProgressBarLayout layout;
+    std::vector<HWND> buttons;
+};
+
+static LPCWSTR AsWide(const char16_t* text) {
+    return reinterpret_cast<LPCWSTR>(text);
+}
+
+// Converts into a buffer reused across calls, so it's only good until the
+// next one. Only used on the thread that owns the windows.
+static LPCWSTR ToWide(const char* text) {
+    static std::u16string buffer;
+    AssignUtf8AsUtf16(buffer, text);
+    return AsWide(buffer.c_str());
+}
+
 // Window class name
 const wchar_t* WINDOW_CLASS_NAME = L"ProgressBarWindow";
 
@@ -47,12 +82,15 @@ LRESULT CALLBACK ProgressBarWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
         // Handle button clicks
         int buttonId = LOWORD(wParam);
         if (buttonId >= 1) {  // Our buttons start from ID 1
-            void (*callback)(int) = (void (*)(int))GetWindowLongPtr(hwnd, GWLP_USERDATA);
-            if (callback) {
-                callback(buttonId - 1);  // Convert back to 0-based index
+            ProgressBarWindowData* data = (ProgressBarWindowData*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+            if (data && data->callback) {
+                data->callback(data->userData, buttonId - 1);  // Convert back to 0-based index
             }
         }
     }
+    else if (msg == WM_NCDESTROY) {
+        delete (ProgressBarWindowData*)SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+    }
     return DefWindowProcW(hwnd, msg, wParam, lParam);
 }
 
@@ -69,54 +107,162 @@ bool RegisterProgressBarWindowClass() {
     return RegisterClassExW(&wc) != 0;
 }
 
-void* ShowProgressBarWindows(
-    const char* title,
-    const char* message,
-    const char* style,
-    const char** buttonLabels,
-    size_t buttonCount,
-    void (*callback)(int)) {
+// The font of messages and buttons, created once per DPI. Only used on the
+// thread that owns the windows.
+static HFONT GetMessageFont(int dpi) {
+    static std::unordered_map<int, HFONT> fonts;
+    HFONT& font = fonts[dpi];
+    if (!font) {
+        font = CreateFontW(
+            ScaleForDpi(18, dpi),       // Height
+            0,                          // Width
+            0,                          // Escapement
+            0,                          // Orientation
+            FW_NORMAL,                  // Weight
+            FALSE,                      // Italic
+            FALSE,                      // Underline
+            0,                          // StrikeOut
+            ANSI_CHARSET,               // CharSet
+            OUT_DEFAULT_PRECIS,         // OutPrecision
+            CLIP_DEFAULT_PRECIS,        // ClipPrecision
+            CLEARTYPE_QUALITY,          // Quality
+            DEFAULT_PITCH | FF_SWISS,   // PitchAndFamily
+            L"Segoe UI"                 // Font Name
+        );
+    }
+    return font;
+}
+
+static ProgressBarLayoutMetrics GetLayoutMetrics(int dpi) {
+    ProgressBarLayoutMetrics metrics;
+    metrics.contentWidth = ScaleForDpi(CONTENT_WIDTH, dpi);
+    metrics.margin = ScaleForDpi(WINDOW_MARGIN, dpi);
+    metrics.top = ScaleForDpi(20, dpi);
+    metrics.messageHeight = ScaleForDpi(20, dpi);
+    metrics.progressGap = ScaleForDpi(10, dpi);
+    metrics.progressHeight = ScaleForDpi(24, dpi);
+    metrics.buttonGap = ScaleForDpi(26, dpi);
+    metrics.buttonHeight = ScaleForDpi(32, dpi);
+    metrics.buttonMinWidth = ScaleForDpi(100, dpi);
+    metrics.buttonPadding = ScaleForDpi(24, dpi);
+    metrics.buttonSpacing = ScaleForDpi(10, dpi);
+    metrics.bottomMargin = ScaleForDpi(28, dpi);
+    return metrics;
+}
+
+// Button labels measured so far. Only used on the thread that owns the
+// windows.
+static TextWidthCache label_widths;
+
+static int MeasureLabel(const std::string& label, HFONT font) {
+    LPCWSTR text = ToWide(label.c_str());
+    HDC hdc = GetDC(NULL);
+    HGDIOBJ previous = SelectObject(hdc, font);
+    SIZE size = {0};
+    GetTextExtentPoint32W(hdc, text, (int)wcslen(text), &size);
+    SelectObject(hdc, previous);
+    ReleaseDC(NULL, hdc);
+    return size.cx;
+}
+
+// Lays the window out for `buttonLabels` and makes only the changes that
+// takes: a bar that swaps one button label relabels that one button
+static void ApplyLayout(HWND hwnd, ProgressBarWindowData* data, const char** buttonLabels,
+                        size_t buttonCount) {
+    int dpi = GetWindowDpiHelper(hwnd);
+    HFONT font = GetMessageFont(dpi);
+
+    std::vector<std::string> labels;
+    labels.reserve(buttonCount);
+    for (size_t i = 0; i < buttonCount; i++) {
+        labels.push_back(buttonLabels && buttonLabels[i] ? buttonLabels[i] : "");
+    }
 
+    std::vector<LayoutOp> ops = data->layout.Update(GetLayoutMetrics(dpi), labels,
+        [&](const std::string& label) {
+            return label_widths.Get(label, (uintptr_t)font, dpi,
+                                    [&] { return MeasureLabel(label, font); });
+        });
+
+    for (const LayoutOp& op : ops) {
+        const LayoutRect& rect = op.rect;
+        switch (op.kind) {
+            case LayoutOpKind::kResize: {
+                // Keeps the top left corner where it is
+                RECT frame = { 0, 0, rect.width, rect.height };
+                AdjustWindowRectEx(&frame, (DWORD)GetWindowLongPtr(hwnd, GWL_STYLE), FALSE,
+                                   (DWORD)GetWindowLongPtr(hwnd, GWL_EXSTYLE));
+                SetWindowPos(hwnd, NULL, 0, 0, frame.right - frame.left, frame.bottom - frame.top,
+                             SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+                break;
+            }
+            case LayoutOpKind::kMoveMessage:
+                MoveWindow(FindWindowExW(hwnd, NULL, L"STATIC", NULL),
+                           rect.x, rect.y, rect.width, rect.height, TRUE);
+                break;
+            case LayoutOpKind::kMoveProgress:
+                MoveWindow(FindWindowExW(hwnd, NULL, PROGRESS_CLASSW, NULL),
+                           rect.x, rect.y, rect.width, rect.height, TRUE);
+                break;
+            case LayoutOpKind::kCreateButton: {
+                HWND hButton = CreateWindowExW(
+                    0,
+                    L"BUTTON",
+                    ToWide(data->layout.label(op.index).c_str()),
+                    WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+                    rect.x, rect.y, rect.width, rect.height,
+                    hwnd,
+                    (HMENU)(op.index + 1),  // Click IDs start from 1
+                    GetModuleHandle(NULL),
+                    NULL
+                );
+                SendMessage(hButton, WM_SETFONT, (WPARAM)font, TRUE);
+                data->buttons.push_back(hButton);
+                break;
+            }
+            case LayoutOpKind::kRelabelButton:
+                SetWindowTextW(data->buttons[op.index], ToWide(data->layout.label(op.index).c_str()));
+                MoveWindow(data->buttons[op.index], rect.x, rect.y, rect.width, rect.height, TRUE);
+                break;
+            case LayoutOpKind::kMoveButton:
+                MoveWindow(data->buttons[op.index], rect.x, rect.y, rect.width, rect.height, TRUE);
+                break;
+            case LayoutOpKind::kDestroyButton:
+                DestroyWindow(data->buttons[op.index]);
+                data->buttons.pop_back();
+                break;
+        }
+    }
+}
+
+// Hidden windows waiting to be shown, see PrewarmProgressBarsWindows()
+static WindowPool<HWND> window_pool;
+
+// Builds a hidden window with its message and progress controls, everything
+// a bar needs apart from its title, text and buttons
+static HWND CreateProgressBarWindow() {
     // Set DPI awareness
     SetProcessDpiAwareness(PROCESS_PER_MONITOR_DPI_AWARE);
 
     // Register window class
     static bool registered = RegisterProgressBarWindowClass();
     if (!registered) {
-        return nullptr;
+        return NULL;
     }
 
-    // Convert char* to wstring
-    std::wstring wTitle(title, title + strlen(title));
-    std::wstring wMessage(message, message + strlen(message));
-    
-    // Get screen dimensions
-    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-    
     // Get system DPI
     HDC hdc = GetDC(NULL);
     int dpi = GetDeviceCaps(hdc, LOGPIXELSX);
     ReleaseDC(NULL, hdc);
-    
-    // Calculate window dimensions with DPI scaling
-    int windowWidth = ScaleForDpi(DEFAULT_WINDOW_WIDTH, dpi);
-    int windowHeight = buttonCount == 0 ? 
-        ScaleForDpi(DEFAULT_WINDOW_HEIGHT, dpi) : 
-        ScaleForDpi(DEFAULT_WINDOW_HEIGHT_WITH_BUTTONS, dpi);
-    
-    // Calculate center position with scaled dimensions
-    int windowX = (screenWidth - windowWidth) / 2;
-    int windowY = (screenHeight - windowHeight) / 2;
 
-    // Create the window using our custom window class
+    // Sized and positioned when shown
     HWND hwnd = CreateWindowExW(
         WS_EX_DLGMODALFRAME | WS_EX_TOPMOST,
         WINDOW_CLASS_NAME,
-        wTitle.c_str(),
-        WS_POPUP | WS_CAPTION | WS_VISIBLE,
-        windowX, windowY,  // Centered position
-        windowWidth, windowHeight,
+        L"",
+        WS_POPUP | WS_CAPTION,
+        0, 0,
+        ScaleForDpi(DEFAULT_WINDOW_WIDTH, dpi), ScaleForDpi(DEFAULT_WINDOW_HEIGHT, dpi),
         NULL,
         NULL,
         GetModuleHandle(NULL),
@@ -124,54 +270,27 @@ void* ShowProgressBarWindows(
     );
 
     if (!hwnd) {
-        return nullptr;
+        return NULL;
     }
 
     // Update DPI to use the per-monitor value
     dpi = GetWindowDpiHelper(hwnd);
 
-    // After window creation and getting DPI
-    RECT clientRect;
-    GetClientRect(hwnd, &clientRect);
-    int clientWidth = clientRect.right - clientRect.left;
-
-    // Create message text
+    // Create message text, placed by ApplyLayout() below
     HWND hMessage = CreateWindowExW(
         WS_EX_TRANSPARENT,
         L"STATIC",
-        wMessage.c_str(),
+        L"",
         WS_CHILD | WS_VISIBLE | SS_LEFT | SS_NOPREFIX,
-        ScaleForDpi(WINDOW_MARGIN, dpi),
-        ScaleForDpi(20, dpi),
-        clientWidth - ScaleForDpi(2 * WINDOW_MARGIN, dpi),  // Width based on client area
-        ScaleForDpi(20, dpi),
+        0, 0, 0, 0,
         hwnd,
         NULL,
         GetModuleHandle(NULL),
         NULL
     );
 
-    // Create DPI-aware font
-    int fontSize = ScaleForDpi(18, dpi);  // Increased size
-    HFONT hFont = CreateFontW(
-        fontSize,                    // Height
-        0,                          // Width
-        0,                          // Escapement
-        0,                          // Orientation
-        FW_NORMAL,                  // Weight
-        FALSE,                      // Italic
-        FALSE,                      // Underline
-        0,                          // StrikeOut
-        ANSI_CHARSET,               // CharSet
-        OUT_DEFAULT_PRECIS,         // OutPrecision
-        CLIP_DEFAULT_PRECIS,        // ClipPrecision
-        CLEARTYPE_QUALITY,          // Quality
-        DEFAULT_PITCH | FF_SWISS,   // PitchAndFamily
-        L"Segoe UI"                 // Font Name
-    );
-
     // Apply font to message
-    SendMessage(hMessage, WM_SETFONT, (WPARAM)hFont, TRUE);
+    SendMessage(hMessage, WM_SETFONT, (WPARAM)GetMessageFont(dpi), TRUE);
 
     // Make background transparent
     SetWindowLongW(hMessage, GWL_EXSTYLE, 
@@ -199,51 +318,60 @@ void* ShowProgressBarWindows(
         PROGRESS_CLASSW,
         NULL,
         WS_CHILD | WS_VISIBLE,
-        ScaleForDpi(WINDOW_MARGIN, dpi),
-        ScaleForDpi(50, dpi),
-        clientWidth - ScaleForDpi(2 * WINDOW_MARGIN, dpi),  // Width based on client area
-        ScaleForDpi(24, dpi),
+        0, 0, 0, 0,
         hwnd,
         NULL,
         GetModuleHandle(NULL),
         NULL
     );
+    SendMessage(hProgress, PBM_SETRANGE32, 0, PROGRESS_RANGE);
 
-    // Create buttons if provided
-    int buttonWidth = ScaleForDpi(100, dpi);
-    int buttonHeight = ScaleForDpi(32, dpi);
-    int buttonSpacing = ScaleForDpi(10, dpi);  // Reduced spacing between buttons
-    int buttonY = ScaleForDpi(100, dpi);
+    // Filled in when shown
+    ProgressBarWindowData* data = new ProgressBarWindowData();
+    SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)data);
+    ApplyLayout(hwnd, data, nullptr, 0);
 
-    // Calculate total width needed for all buttons
-    int totalButtonWidth = (buttonWidth * buttonCount) + (buttonSpacing * (buttonCount - 1));
-    
-    // Start position for the first button (from right side)
-    int startX = clientWidth - ScaleForDpi(WINDOW_MARGIN, dpi) - totalButtonWidth;
+    return hwnd;
+}
 
-    for (size_t i = 0; i < buttonCount; i++) {
-        std::wstring wButtonLabel(buttonLabels[i], buttonLabels[i] + strlen(buttonLabels[i]));
-        HWND hButton = CreateWindowExW(
-            0,
-            L"BUTTON",
-            wButtonLabel.c_str(),
-            WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
-            startX + (i * (buttonWidth + buttonSpacing)),  // Position from right to left
-            buttonY,
-            buttonWidth,
-            buttonHeight,
-            hwnd,
-            (HMENU)(i + 1),
-            GetModuleHandle(NULL),
-            NULL
-        );
+void* ShowProgressBarWindows(
+    const char* title,
+    const char* message,
+    const char* style,
+    const char** buttonLabels,
+    size_t buttonCount,
+    void (*callback)(void*, int),
+    void* userData) {
 
-        // Apply same font to buttons
-        SendMessage(hButton, WM_SETFONT, (WPARAM)hFont, TRUE);
+    HWND hwnd = NULL;
+    if (!window_pool.Take(&hwnd)) {
+        hwnd = CreateProgressBarWindow();
     }
+    if (!hwnd) {
+        return nullptr;
+    }
+
+    ProgressBarWindowData* data = (ProgressBarWindowData*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+    SetWindowTextW(hwnd, ToWide(title));
+    if (data->message.Assign(message)) {
+        SetWindowTextW(FindWindowExW(hwnd, NULL, L"STATIC", NULL), AsWide(data->message.c_str()));
+    }
+
+    ApplyLayout(hwnd, data, buttonLabels, buttonCount);
+
+    // Centered on the screen
+    RECT frame;
+    GetWindowRect(hwnd, &frame);
+    int windowWidth = frame.right - frame.left;
+    int windowHeight = frame.bottom - frame.top;
+    SetWindowPos(hwnd, NULL,
+                 (GetSystemMetrics(SM_CXSCREEN) - windowWidth) / 2,
+                 (GetSystemMetrics(SM_CYSCREEN) - windowHeight) / 2,
+                 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
 
     // Store callback and other data
-    SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)callback);
+    data->callback = callback;
+    data->userData = userData;
 
     // Show the window
     ShowWindow(hwnd, SW_SHOW);
@@ -252,107 +380,376 @@ void* ShowProgressBarWindows(
     return hwnd;
 }
 
+void PrewarmProgressBarsWindows(size_t count, const char* style) {
+    window_pool.Prewarm(count, CreateProgressBarWindow, DestroyWindow);
+}
+
+void GetProgressBarPoolStatsWindows(WindowPoolStats* stats) {
+    window_pool.GetStats(stats);
+}
+
 void UpdateProgressBarWindows(
     void* handle,
-    int progress,
+    double progress,
     const char* message,
     bool updateButtons,
     const char** buttonLabels,
     size_t buttonCount,
-    void (*callback)(int)) {
+    void (*callback)(void*, int)) {
     
     HWND hwnd = (HWND)handle;
     if (!hwnd) return;
 
-    int dpi = GetWindowDpiHelper(hwnd);
-    
-    // Get screen dimensions
-    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-    
-    // Get client area dimensions
-    RECT clientRect;
-    GetClientRect(hwnd, &clientRect);
-    int clientWidth = clientRect.right - clientRect.left;
-
     // Find the progress bar window
     HWND hProgress = FindWindowExW(hwnd, NULL, PROGRESS_CLASSW, NULL);
     if (hProgress) {
-        SendMessage(hProgress, PBM_SETPOS, progress, 0);
+        WPARAM position = (WPARAM)(progress * PROGRESS_RANGE / 100 + 0.5);
+        // Kept for when the bar leaves marquee mode, which resets it
+        SetWindowLongPtr(hProgress, GWLP_USERDATA, (LONG_PTR)position);
+        if (!(GetWindowLongPtr(hProgress, GWL_STYLE) & PBS_MARQUEE)) {
+            SendMessage(hProgress, PBM_SETPOS, position, 0);
+        }
     }
 
-    if (message) {
+    // Unchanged messages are neither converted nor sent to the control
+    ProgressBarWindowData* data = (ProgressBarWindowData*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+    if (message && data && data->message.Assign(message)) {
         // Find the message static control
         HWND hMessage = FindWindowExW(hwnd, NULL, L"STATIC", NULL);
         if (hMessage) {
-            std::wstring wMessage(message, message + strlen(message));
-            SetWindowTextW(hMessage, wMessage.c_str());
+            SetWindowTextW(hMessage, AsWide(data->message.c_str()));
         }
     }
 
-    if (updateButtons) {
-        // Remove existing buttons
-        HWND hButton = NULL;
-        while ((hButton = FindWindowExW(hwnd, hButton, L"BUTTON", NULL)) != NULL) {
-            DestroyWindow(hButton);
+    if (updateButtons && data) {
+        ApplyLayout(hwnd, data, buttonLabels, buttonCount);
+        data->callback = callback;
+    }
+}
+
+double GetProgressBarPixelWidthWindows(void* handle) {
+    HWND hProgress = FindWindowExW((HWND)handle, NULL, PROGRESS_CLASSW, NULL);
+    if (!hProgress) return 0;
+
+    // We're per-monitor DPI aware, so this is in device pixels already
+    RECT rect;
+    GetClientRect(hProgress, &rect);
+    return rect.right - rect.left;
+}
+
+// Marquee mode is animated by the control's own timer, which the message loop
+// of the thread that owns the window keeps running
+void SetProgressBarIndeterminateWindows(void* handle, bool indeterminate) {
+    HWND hProgress = FindWindowExW((HWND)handle, NULL, PROGRESS_CLASSW, NULL);
+    if (!hProgress) return;
+
+    LONG_PTR style = GetWindowLongPtr(hProgress, GWL_STYLE);
+    if (indeterminate) {
+        SetWindowLongPtr(hProgress, GWL_STYLE, style | PBS_MARQUEE);
+        SendMessage(hProgress, PBM_SETMARQUEE, TRUE, 30);
+    } else {
+        SendMessage(hProgress, PBM_SETMARQUEE, FALSE, 0);
+        SetWindowLongPtr(hProgress, GWL_STYLE, style & ~PBS_MARQUEE);
+        SendMessage(hProgress, PBM_SETRANGE32, 0, PROGRESS_RANGE);
+        SendMessage(hProgress, PBM_SETPOS, (WPARAM)GetWindowLongPtr(hProgress, GWLP_USERDATA), 0);
+    }
+}
+
+void CloseProgressBarWindows(void* handle) {
+    HWND hwnd = (HWND)handle;
+    if (!hwnd) {
+        return;
+    }
+
+    // Back to the state CreateProgressBarWindow() left it in, in case the pool
+    // takes it
+    ShowWindow(hwnd, SW_HIDE);
+    ProgressBarWindowData* data = (ProgressBarWindowData*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+    if (data) {
+        data->callback = nullptr;
+        data->userData = nullptr;
+        ApplyLayout(hwnd, data, nullptr, 0);
+    }
+    SetProgressBarIndeterminateWindows(hwnd, false);
+    UpdateProgressBarWindows(hwnd, 0, "", false, nullptr, 0, nullptr);
+
+    if (!window_pool.Return(hwnd)) {
+        DestroyWindow(hwnd);
+    }
+}
+
+// Progress groups: one window with a virtual (LVS_OWNERDATA) list view. The
+// list view keeps no items of its own; it asks for the text of the rows it
+// is about to paint, so only rows that are scrolled into view cost anything.
+
+#define GROUP_WINDOW_HEIGHT 360
+#define GROUP_ROW_HEIGHT 28
+#define GROUP_PROGRESS_COLUMN_WIDTH 160
+
+const wchar_t* GROUP_WINDOW_CLASS_NAME = L"ProgressGroupWindow";
+
+struct ProgressGroupRow {
+    uint32_t id;
+    double progress;
+    std::u16string message;
+    std::wstring percent;
+};
+
+struct ProgressGroupWindow {
+    HWND list = NULL;
+    HFONT font = NULL;
+    std::vector<ProgressGroupRow> rows;
+    std::unordered_map<uint32_t, size_t> rowIndex;
+};
+
+static void SetGroupRowProgress(ProgressGroupRow& row, double progress) {
+    row.progress = progress;
+    row.percent = std::to_wstring(static_cast<int>(progress)) + L"%";
+}
+
+// Draws the progress column as a bar, since list views can't host controls
+static LRESULT DrawGroupProgressCell(ProgressGroupWindow* group, NMLVCUSTOMDRAW* draw) {
+    size_t index = draw->nmcd.dwItemSpec;
+    if (index >= group->rows.size()) {
+        return CDRF_DODEFAULT;
+    }
+
+    RECT cell;
+    ListView_GetSubItemRect(group->list, (int)index, 1, LVIR_BOUNDS, &cell);
+    InflateRect(&cell, -4, -6);
+
+    HDC hdc = draw->nmcd.hdc;
+    FrameRect(hdc, &cell, GetSysColorBrush(COLOR_3DSHADOW));
+
+    RECT filled = cell;
+    InflateRect(&filled, -1, -1);
+    filled.right = filled.left + (LONG)((filled.right - filled.left) * group->rows[index].progress / 100.0);
+    FillRect(hdc, &filled, GetSysColorBrush(COLOR_HIGHLIGHT));
+
+    return CDRF_SKIPDEFAULT;
+}
+
+LRESULT CALLBACK ProgressGroupWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    ProgressGroupWindow* group = (ProgressGroupWindow*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+
+    if (msg == WM_CLOSE) {
+        return 0;  // Ignore close request
+    }
+    else if (msg == WM_SIZE && group && group->list) {
+        MoveWindow(group->list, 0, 0, LOWORD(lParam), HIWORD(lParam), TRUE);
+    }
+    else if (msg == WM_NOTIFY && group) {
+        NMHDR* header = (NMHDR*)lParam;
+        if (header->hwndFrom == group->list && header->code == LVN_GETDISPINFOW) {
+            LVITEMW& item = ((NMLVDISPINFOW*)lParam)->item;
+            if ((item.mask & LVIF_TEXT) && (size_t)item.iItem < group->rows.size()) {
+                const ProgressGroupRow& row = group->rows[item.iItem];
+                item.pszText = (LPWSTR)(item.iSubItem == 0 ? AsWide(row.message.c_str()) : row.percent.c_str());
+            }
+            return 0;
+        }
+        if (header->hwndFrom == group->list && header->code == NM_CUSTOMDRAW) {
+            NMLVCUSTOMDRAW* draw = (NMLVCUSTOMDRAW*)lParam;
+            switch (draw->nmcd.dwDrawStage) {
+                case CDDS_PREPAINT:
+                    return CDRF_NOTIFYITEMDRAW;
+                case CDDS_ITEMPREPAINT:
+                    return CDRF_NOTIFYSUBITEMDRAW;
+                case CDDS_ITEMPREPAINT | CDDS_SUBITEM:
+                    if (draw->iSubItem == 1) {
+                        return DrawGroupProgressCell(group, draw);
+                    }
+                    return CDRF_DODEFAULT;
+            }
+            return CDRF_DODEFAULT;
         }
+    }
+    else if (msg == WM_NCDESTROY && group) {
+        SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+        if (group->font) {
+            DeleteObject(group->font);
+        }
+        delete group;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
 
-        // Calculate new window size with DPI scaling
-        int windowWidth = ScaleForDpi(DEFAULT_WINDOW_WIDTH, dpi);
-        int windowHeight = buttonCount == 0 ? 
-            ScaleForDpi(DEFAULT_WINDOW_HEIGHT, dpi) : 
-            ScaleForDpi(DEFAULT_WINDOW_HEIGHT_WITH_BUTTONS, dpi);
-        
-        // Calculate new center position with scaled dimensions
-        int windowX = (screenWidth - windowWidth) / 2;
-        int windowY = (screenHeight - windowHeight) / 2;
-
-        if (buttonCount > 0) {
-            // Create new buttons with DPI scaling
-            int buttonWidth = ScaleForDpi(100, dpi);
-            int buttonHeight = ScaleForDpi(32, dpi);
-            int buttonSpacing = ScaleForDpi(10, dpi);
-            int buttonY = ScaleForDpi(100, dpi);
-
-            // Calculate total width needed for all buttons
-            int totalButtonWidth = (buttonWidth * buttonCount) + (buttonSpacing * (buttonCount - 1));
-            int startX = clientWidth - ScaleForDpi(WINDOW_MARGIN, dpi) - totalButtonWidth;
-
-            for (size_t i = 0; i < buttonCount; i++) {
-                std::wstring wButtonLabel(buttonLabels[i], buttonLabels[i] + strlen(buttonLabels[i]));
-                HWND hNewButton = CreateWindowExW(
-                    0,
-                    L"BUTTON",
-                    wButtonLabel.c_str(),
-                    WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
-                    startX + (i * (buttonWidth + buttonSpacing)),
-                    buttonY,
-                    buttonWidth,
-                    buttonHeight,
-                    hwnd,
-                    (HMENU)(i + 1),
-                    GetModuleHandle(NULL),
-                    NULL
-                );
+bool RegisterProgressGroupWindowClass() {
+    WNDCLASSEXW wc = {0};
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = ProgressGroupWndProc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = GROUP_WINDOW_CLASS_NAME;
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.hbrBackground = GetSysColorBrush(COLOR_3DFACE);
 
-                // Set button font
-                HFONT hFont = (HFONT)GetStockObject(DEFAULT_GUI_FONT);
-                SendMessage(hNewButton, WM_SETFONT, (WPARAM)hFont, TRUE);
+    return RegisterClassExW(&wc) != 0;
+}
+
+void* ShowProgressGroupWindows(const char* title, const char* style) {
+    SetProcessDpiAwareness(PROCESS_PER_MONITOR_DPI_AWARE);
+
+    static bool registered = RegisterProgressGroupWindowClass();
+    if (!registered) {
+        return nullptr;
+    }
+
+    INITCOMMONCONTROLSEX controls = { sizeof(INITCOMMONCONTROLSEX), ICC_LISTVIEW_CLASSES };
+    InitCommonControlsEx(&controls);
+
+    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+
+    HDC hdc = GetDC(NULL);
+    int dpi = GetDeviceCaps(hdc, LOGPIXELSX);
+    ReleaseDC(NULL, hdc);
+
+    int windowWidth = ScaleForDpi(DEFAULT_WINDOW_WIDTH, dpi);
+    int windowHeight = ScaleForDpi(GROUP_WINDOW_HEIGHT, dpi);
+
+    HWND hwnd = CreateWindowExW(
+        WS_EX_DLGMODALFRAME | WS_EX_TOPMOST,
+        GROUP_WINDOW_CLASS_NAME,
+        ToWide(title),
+        WS_POPUP | WS_CAPTION | WS_THICKFRAME | WS_VISIBLE,
+        (screenWidth - windowWidth) / 2, (screenHeight - windowHeight) / 2,
+        windowWidth, windowHeight,
+        NULL,
+        NULL,
+        GetModuleHandle(NULL),
+        NULL
+    );
+
+    if (!hwnd) {
+        return nullptr;
+    }
+
+    dpi = GetWindowDpiHelper(hwnd);
+
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    int clientWidth = clientRect.right - clientRect.left;
+    int clientHeight = clientRect.bottom - clientRect.top;
+
+    ProgressGroupWindow* group = new ProgressGroupWindow();
+    SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)group);
+
+    group->list = CreateWindowExW(
+        0,
+        WC_LISTVIEWW,
+        NULL,
+        WS_CHILD | WS_VISIBLE | WS_VSCROLL | LVS_REPORT | LVS_OWNERDATA | LVS_NOCOLUMNHEADER | LVS_NOSORTHEADER,
+        0, 0,
+        clientWidth, clientHeight,
+        hwnd,
+        NULL,
+        GetModuleHandle(NULL),
+        NULL
+    );
+    ListView_SetExtendedListViewStyle(group->list, LVS_EX_DOUBLEBUFFER | LVS_EX_FULLROWSELECT);
+
+    group->font = CreateFontW(
+        ScaleForDpi(16, dpi), 0, 0, 0, FW_NORMAL, FALSE, FALSE, 0, ANSI_CHARSET,
+        OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_SWISS, L"Segoe UI");
+    SendMessage(group->list, WM_SETFONT, (WPARAM)group->font, TRUE);
+
+    // List views size their rows after the height of a small image list
+    HIMAGELIST rowHeight = ImageList_Create(1, ScaleForDpi(GROUP_ROW_HEIGHT, dpi), ILC_COLOR, 0, 0);
+    ListView_SetImageList(group->list, rowHeight, LVSIL_SMALL);
+
+    int progressWidth = ScaleForDpi(GROUP_PROGRESS_COLUMN_WIDTH, dpi);
+    LVCOLUMNW column = {0};
+    column.mask = LVCF_WIDTH | LVCF_SUBITEM;
+    column.cx = clientWidth - progressWidth - GetSystemMetrics(SM_CXVSCROLL);
+    column.iSubItem = 0;
+    ListView_InsertColumn(group->list, 0, &column);
+    column.cx = progressWidth;
+    column.iSubItem = 1;
+    ListView_InsertColumn(group->list, 1, &column);
+
+    ShowWindow(hwnd, SW_SHOW);
+    UpdateWindow(hwnd);
+
+    return hwnd;
+}
+
+void UpdateProgressGroupWindows(void* handle, const ProgressGroupRowUpdate* updates, size_t count) {
+    HWND hwnd = (HWND)handle;
+    if (!hwnd) return;
+
+    ProgressGroupWindow* group = (ProgressGroupWindow*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+    if (!group) return;
+
+    // Everything from `firstChanged` on has to be repainted, if visible
+    size_t firstChanged = SIZE_MAX;
+    size_t lastChanged = 0;
+    bool countChanged = false;
+
+    for (size_t i = 0; i < count; i++) {
+        const ProgressGroupRowUpdate& update = updates[i];
+        auto it = group->rowIndex.find(update.id);
+
+        if (update.op == PROGRESS_GROUP_ROW_REMOVE) {
+            if (it == group->rowIndex.end()) continue;
+
+            size_t index = it->second;
+            group->rowIndex.erase(it);
+            group->rows.erase(group->rows.begin() + index);
+            for (size_t j = index; j < group->rows.size(); j++) {
+                group->rowIndex[group->rows[j].id] = j;
             }
 
-            // Store new callback
-            SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)callback);
+            firstChanged = std::min(firstChanged, index);
+            lastChanged = SIZE_MAX;
+            countChanged = true;
+            continue;
+        }
+
+        size_t index;
+        if (it != group->rowIndex.end()) {
+            index = it->second;
+        } else if (update.op == PROGRESS_GROUP_ROW_ADD) {
+            index = group->rows.size();
+            group->rowIndex.emplace(update.id, index);
+            group->rows.push_back({ update.id, 0, u"", L"0%" });
+            countChanged = true;
+        } else {
+            continue;
+        }
 
-            // Force window to redraw
-            InvalidateRect(hwnd, NULL, TRUE);
-            UpdateWindow(hwnd);
+        ProgressGroupRow& row = group->rows[index];
+        if (update.hasProgress) {
+            SetGroupRowProgress(row, update.progress);
+        }
+        if (update.message) {
+            AssignUtf8AsUtf16(row.message, update.message);
         }
+
+        firstChanged = std::min(firstChanged, index);
+        lastChanged = std::max(lastChanged, index);
+    }
+
+    if (countChanged) {
+        ListView_SetItemCountEx(group->list, (int)group->rows.size(), LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+    }
+
+    if (firstChanged == SIZE_MAX || group->rows.empty()) {
+        return;
+    }
+
+    // Only repaint what is on screen; the rest is read when scrolled to
+    size_t top = (size_t)ListView_GetTopIndex(group->list);
+    size_t bottom = top + (size_t)ListView_GetCountPerPage(group->list);
+    size_t first = std::max(firstChanged, top);
+    size_t last = std::min(std::min(lastChanged, bottom), group->rows.size() - 1);
+    if (first <= last) {
+        ListView_RedrawItems(group->list, (int)first, (int)last);
     }
 }
 
-void CloseProgressBarWindows(void* handle) {
+void CloseProgressGroupWindows(void* handle) {
     HWND hwnd = (HWND)handle;
-    if (hwnd) {
+    if (hwnd && IsWindow(hwnd)) {
         DestroyWindow(hwnd);
     }
-} 
+}
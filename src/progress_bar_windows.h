@@ -1,6 +1,9 @@
 #ifndef PROGRESS_BAR_WINDOWS_H
 #define PROGRESS_BAR_WINDOWS_H
 
+#include "progress_group.h"
+#include "window_pool.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -11,21 +14,40 @@ void* ShowProgressBarWindows(
     const char* style,
     const char** buttonLabels,
     size_t buttonCount,
-    void (*callback)(int)
+    void (*callback)(void* userData, int buttonIndex),
+    void* userData
 );
 
 void UpdateProgressBarWindows(
     void* handle,
-    int progress,
+    double progress,
     const char* message,
     bool updateButtons,
     const char** buttonLabels,
     size_t buttonCount,
-    void (*callback)(int)
+    void (*callback)(void* userData, int buttonIndex)
 );
 
+// Width of the bar's fill in device pixels, 0 if unknown
+double GetProgressBarPixelWidthWindows(void* handle);
+
+// Switches the bar to marquee mode and back
+void SetProgressBarIndeterminateWindows(void* handle, bool indeterminate);
+
 void CloseProgressBarWindows(void* handle);
 
+// Keeps `count` hidden windows ready for the next shows. Closed bars return
+// their window while the pool has room. 0 empties the pool.
+void PrewarmProgressBarsWindows(size_t count, const char* style);
+
+void GetProgressBarPoolStatsWindows(WindowPoolStats* stats);
+
+void* ShowProgressGroupWindows(const char* title, const char* style);
+
+void UpdateProgressGroupWindows(void* handle, const ProgressGroupRowUpdate* updates, size_t count);
+
+void CloseProgressGroupWindows(void* handle);
+
 #ifdef __cplusplus
 }
 #endif
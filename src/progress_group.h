@@ -0,0 +1,37 @@
+#ifndef PROGRESS_GROUP_H
+#define PROGRESS_GROUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A progress group is a single window hosting a list of progress rows. Rows
+// are identified by ids the caller picks; the core collects row changes and
+// hands them to the backend in one batch per frame, in the order they were
+// made.
+
+enum ProgressGroupRowOp {
+    PROGRESS_GROUP_ROW_ADD = 0,
+    PROGRESS_GROUP_ROW_UPDATE = 1,
+    PROGRESS_GROUP_ROW_REMOVE = 2,
+};
+
+typedef struct ProgressGroupRowUpdate {
+    uint32_t id;
+    uint32_t op;
+    // Always set for PROGRESS_GROUP_ROW_ADD
+    bool hasProgress;
+    double progress;
+    // nullptr if unchanged. Never nullptr for PROGRESS_GROUP_ROW_ADD.
+    const char* message;
+} ProgressGroupRowUpdate;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROGRESS_GROUP_H
@@ -0,0 +1,134 @@
+#ifndef PROGRESS_HISTORY_H
+#define PROGRESS_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+
+// The progress of a bar over time, in a fixed number of equally long
+// buckets, so it takes the same memory however long the job runs. Each
+// bucket keeps the first, last, lowest and highest progress recorded in it.
+//
+// Buckets start kInitialInterval long. Once a sample falls past the last
+// bucket, neighbours are merged in pairs and every bucket becomes twice as
+// long, which keeps the whole run in view at half the resolution. That
+// happens once per doubling of the run's length, so recording a sample is
+// O(1) amortized and never allocates. A bucket no sample fell into holds
+// the progress of the one before it.
+class ProgressHistory {
+public:
+    static constexpr size_t kCapacity = 120;
+    static constexpr double kInitialInterval = 0.25;
+
+    struct Bucket {
+        double first = 0;
+        double last = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    // Records `progress` at `seconds`, which never goes back. The first
+    // sample starts the history.
+    void Record(double seconds, double progress) {
+        if (size_ == 0) {
+            origin_ = seconds;
+            buckets_[0] = { progress, progress, progress, progress };
+            size_ = 1;
+            version_++;
+            return;
+        }
+
+        Advance(seconds);
+        Bucket& bucket = buckets_[size_ - 1];
+        bucket.last = progress;
+        bucket.min = std::min(bucket.min, progress);
+        bucket.max = std::max(bucket.max, progress);
+        version_++;
+    }
+
+    // Extends the history to `seconds` without a new sample, so that a bar
+    // that stopped moving shows as flat up to now
+    void Advance(double seconds) {
+        if (size_ == 0) {
+            return;
+        }
+
+        size_t index = IndexOf(seconds);
+        while (index >= kCapacity) {
+            Compact();
+            index = IndexOf(seconds);
+        }
+
+        if (index >= size_) {
+            double carried = buckets_[size_ - 1].last;
+            for (; size_ <= index; size_++) {
+                buckets_[size_] = { carried, carried, carried, carried };
+            }
+            version_++;
+        }
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const Bucket& operator[](size_t index) const {
+        return buckets_[index];
+    }
+
+    // Length of each bucket, in seconds
+    double interval() const {
+        return interval_;
+    }
+
+    // When the first bucket starts, on the clock passed to Record()
+    double origin() const {
+        return origin_;
+    }
+
+    // Changes whenever a bucket does
+    uint64_t version() const {
+        return version_;
+    }
+
+    // How fast progress moved in bucket `index`, in percent per second: the
+    // change since the end of the previous bucket, or since the first sample
+    // for the first bucket
+    double RateAt(size_t index) const {
+        double before = index > 0 ? buckets_[index - 1].last : buckets_[0].first;
+        return (buckets_[index].last - before) / interval_;
+    }
+
+private:
+    size_t IndexOf(double seconds) const {
+        double offset = std::max(0.0, seconds - origin_);
+        return static_cast<size_t>(std::min(std::floor(offset / interval_), 1e9));
+    }
+
+    // Merges neighbouring buckets, halving the count and doubling the interval
+    void Compact() {
+        size_t merged = 0;
+        for (size_t i = 0; i < size_; i += 2) {
+            Bucket bucket = buckets_[i];
+            if (i + 1 < size_) {
+                const Bucket& next = buckets_[i + 1];
+                bucket.last = next.last;
+                bucket.min = std::min(bucket.min, next.min);
+                bucket.max = std::max(bucket.max, next.max);
+            }
+            buckets_[merged++] = bucket;
+        }
+        size_ = merged;
+        interval_ *= 2;
+        version_++;
+    }
+
+    Bucket buckets_[kCapacity];
+    size_t size_ = 0;
+    double origin_ = 0;
+    double interval_ = kInitialInterval;
+    uint64_t version_ = 0;
+};
+
+#endif // PROGRESS_HISTORY_H
@@ -0,0 +1,238 @@
+#ifndef PROGRESS_LAYOUT_H
+#define PROGRESS_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where the controls of a bar's window go, worked out the same way for every
+// backend. Backends measure text and apply the result; everything in between
+// is plain arithmetic that runs on any OS.
+//
+// Units are whatever the backend measures in: device pixels on Windows,
+// points on macOS. y grows downward from the top of the content area.
+
+struct LayoutRect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+inline bool operator==(const LayoutRect& a, const LayoutRect& b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+inline bool operator!=(const LayoutRect& a, const LayoutRect& b) {
+    return !(a == b);
+}
+
+// Sizes and spacing of a bar's window, already scaled for its DPI. From the
+// top: message, progress, then a row of buttons if there are any.
+struct ProgressBarLayoutMetrics {
+    int contentWidth = 0;
+    // Left and right of every row, and above the message
+    int margin = 0;
+    int top = 0;
+    int messageHeight = 0;
+    // Between the message and the progress
+    int progressGap = 0;
+    int progressHeight = 0;
+    // Between the progress and the buttons
+    int buttonGap = 0;
+    int buttonHeight = 0;
+    // Buttons are as wide as their label plus the padding, but no narrower
+    // than the minimum
+    int buttonMinWidth = 0;
+    int buttonPadding = 0;
+    int buttonSpacing = 0;
+    // Below the last row
+    int bottomMargin = 0;
+    // Buttons are aligned right. Either the first is the rightmost, as on
+    // macOS, or the leftmost, as on Windows.
+    bool firstButtonRightmost = false;
+};
+
+struct ProgressBarGeometry {
+    int contentWidth = 0;
+    int contentHeight = 0;
+    LayoutRect message;
+    LayoutRect progress;
+    std::vector<LayoutRect> buttons;
+};
+
+// Lays out a bar with buttons whose labels are `labelWidths` wide
+inline ProgressBarGeometry ComputeProgressBarGeometry(const ProgressBarLayoutMetrics& metrics,
+                                                      const std::vector<int>& labelWidths) {
+    ProgressBarGeometry geometry;
+    geometry.contentWidth = metrics.contentWidth;
+
+    int rowWidth = std::max(0, metrics.contentWidth - 2 * metrics.margin);
+    geometry.message = { metrics.margin, metrics.top, rowWidth, metrics.messageHeight };
+    int y = metrics.top + metrics.messageHeight + metrics.progressGap;
+    geometry.progress = { metrics.margin, y, rowWidth, metrics.progressHeight };
+    y += metrics.progressHeight;
+
+    if (!labelWidths.empty()) {
+        y += metrics.buttonGap;
+        geometry.buttons.resize(labelWidths.size());
+
+        // Right to left from the margin, in whichever order the first button
+        // ends up on the right
+        int right = metrics.contentWidth - metrics.margin;
+        for (size_t i = 0; i < labelWidths.size(); i++) {
+            size_t index = metrics.firstButtonRightmost ? i : labelWidths.size() - 1 - i;
+            int width = std::max(metrics.buttonMinWidth, labelWidths[index] + metrics.buttonPadding);
+            geometry.buttons[index] = { right - width, y, width, metrics.buttonHeight };
+            right -= width + metrics.buttonSpacing;
+        }
+        y += metrics.buttonHeight;
+    }
+
+    geometry.contentHeight = y + metrics.bottomMargin;
+    return geometry;
+}
+
+// A change a backend makes to a window's controls. Rects are where the
+// control goes; buttons are created, relabeled and moved at `index`, which
+// is also the index their clicks report.
+enum class LayoutOpKind {
+    kResize,
+    kMoveMessage,
+    kMoveProgress,
+    kCreateButton,
+    kRelabelButton,
+    kMoveButton,
+    kDestroyButton,
+};
+
+struct LayoutOp {
+    LayoutOpKind kind;
+    size_t index;
+    LayoutRect rect;
+};
+
+// Measured label widths, keyed by text, font and DPI, so that buttons seen
+// before are never measured again. Used on the thread that owns the windows.
+class TextWidthCache {
+public:
+    template <typename Measure>
+    int Get(const std::string& text, uintptr_t font, int dpi, Measure measure) {
+        lookup_.text = text;
+        lookup_.font = font;
+        lookup_.dpi = dpi;
+        auto it = widths_.find(lookup_);
+        if (it != widths_.end()) {
+            return it->second;
+        }
+
+        // Labels rarely vary much, so this only guards against ones that
+        // do, like counters
+        if (widths_.size() >= kMaxEntries) {
+            widths_.clear();
+        }
+        int width = measure();
+        widths_.emplace(lookup_, width);
+        return width;
+    }
+
+private:
+    static constexpr size_t kMaxEntries = 512;
+
+    struct Key {
+        std::string text;
+        uintptr_t font = 0;
+        int dpi = 0;
+
+        bool operator==(const Key& other) const {
+            return font == other.font && dpi == other.dpi && text == other.text;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash = std::hash<std::string>()(key.text);
+            hash ^= std::hash<uintptr_t>()(key.font) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            hash ^= std::hash<int>()(key.dpi) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+
+    std::unordered_map<Key, int, KeyHash> widths_;
+    Key lookup_;
+};
+
+// The layout a window has, so that the next one can be applied as a diff.
+// A new layout has nothing in it: the first Update() places every control.
+class ProgressBarLayout {
+public:
+    // Lays the window out for `labels`, measuring each with measure(label),
+    // and returns what the backend has to do to get there from the last
+    // layout: resize first, then moves, creates, relabels and destroys.
+    // Nothing if nothing changed.
+    template <typename Measure>
+    std::vector<LayoutOp> Update(const ProgressBarLayoutMetrics& metrics,
+                                 const std::vector<std::string>& labels, Measure measure) {
+        std::vector<int> widths;
+        widths.reserve(labels.size());
+        for (const std::string& label : labels) {
+            widths.push_back(measure(label));
+        }
+        ProgressBarGeometry next = ComputeProgressBarGeometry(metrics, widths);
+
+        std::vector<LayoutOp> ops;
+        if (next.contentWidth != geometry_.contentWidth ||
+            next.contentHeight != geometry_.contentHeight) {
+            ops.push_back({ LayoutOpKind::kResize, 0, { 0, 0, next.contentWidth, next.contentHeight } });
+        }
+        if (next.message != geometry_.message) {
+            ops.push_back({ LayoutOpKind::kMoveMessage, 0, next.message });
+        }
+        if (next.progress != geometry_.progress) {
+            ops.push_back({ LayoutOpKind::kMoveProgress, 0, next.progress });
+        }
+
+        // A relabeled button is moved along with its new label, not before
+        size_t kept = std::min(labels.size(), labels_.size());
+        for (size_t i = 0; i < kept; i++) {
+            if (labels[i] == labels_[i] && next.buttons[i] != geometry_.buttons[i]) {
+                ops.push_back({ LayoutOpKind::kMoveButton, i, next.buttons[i] });
+            }
+        }
+        for (size_t i = kept; i < labels.size(); i++) {
+            ops.push_back({ LayoutOpKind::kCreateButton, i, next.buttons[i] });
+        }
+        for (size_t i = 0; i < kept; i++) {
+            if (labels[i] != labels_[i]) {
+                ops.push_back({ LayoutOpKind::kRelabelButton, i, next.buttons[i] });
+            }
+        }
+        // From the back, so the indices of the ones still to go stay valid
+        for (size_t i = labels_.size(); i > kept; i--) {
+            ops.push_back({ LayoutOpKind::kDestroyButton, i - 1, {} });
+        }
+
+        geometry_ = std::move(next);
+        labels_ = labels;
+        return ops;
+    }
+
+    const ProgressBarGeometry& geometry() const {
+        return geometry_;
+    }
+
+    // The label of the button at `index`, for creating and relabeling it
+    const std::string& label(size_t index) const {
+        return labels_[index];
+    }
+
+private:
+    ProgressBarGeometry geometry_;
+    std::vector<std::string> labels_;
+};
+
+#endif // PROGRESS_LAYOUT_H
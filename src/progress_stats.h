@@ -0,0 +1,165 @@
+#ifndef PROGRESS_STATS_H
+#define PROGRESS_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+// Runtime statistics, cheap enough to stay on in production. Every bar keeps
+// its own, so threads updating different bars never write to the same cache
+// lines, and totals are only summed up when someone asks for them. All
+// accesses are relaxed: these are statistics, they don't order anything.
+
+inline void Count(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.fetch_add(amount, std::memory_order_relaxed);
+}
+
+// Latencies in power-of-two buckets of microseconds. Bucket 0 holds anything
+// below 1 us, bucket i anything below 2^i us, and the last bucket everything
+// beyond that (about 8 seconds).
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 24;
+
+    void Record(std::chrono::steady_clock::duration latency) {
+        int64_t count = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        uint64_t micros = count > 0 ? static_cast<uint64_t>(count) : 0;
+
+        size_t bucket = 0;
+        for (uint64_t rest = micros; rest > 0 && bucket + 1 < kBuckets; rest >>= 1) {
+            bucket++;
+        }
+
+        Count(buckets_[bucket]);
+        Count(sumMicros_, micros);
+        uint64_t max = maxMicros_.load(std::memory_order_relaxed);
+        while (micros > max && !maxMicros_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    void AddTo(LatencyHistogram& total) const {
+        for (size_t i = 0; i < kBuckets; i++) {
+            Count(total.buckets_[i], Bucket(i));
+        }
+        Count(total.sumMicros_, sumMicros_.load(std::memory_order_relaxed));
+
+        uint64_t micros = maxMicros_.load(std::memory_order_relaxed);
+        uint64_t max = total.maxMicros_.load(std::memory_order_relaxed);
+        while (micros > max &&
+               !total.maxMicros_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Bucket(size_t index) const {
+        return buckets_[index].load(std::memory_order_relaxed);
+    }
+
+    // Exclusive upper bound of a bucket in microseconds, 0 for the last one,
+    // which has none
+    static uint64_t BucketLimit(size_t index) {
+        return index + 1 < kBuckets ? uint64_t(1) << index : 0;
+    }
+
+    uint64_t SampleCount() const {
+        uint64_t count = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            count += Bucket(i);
+        }
+        return count;
+    }
+
+    uint64_t SumMicros() const {
+        return sumMicros_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t MaxMicros() const {
+        return maxMicros_.load(std::memory_order_relaxed);
+    }
+
+    // Upper estimate of the given quantile (0 to 1) in microseconds: the limit
+    // of the bucket it falls into, capped by the largest sample
+    uint64_t Quantile(double quantile) const {
+        uint64_t count = SampleCount();
+        if (count == 0) {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(quantile * count + 0.5);
+        uint64_t seen = 0;
+        uint64_t max = MaxMicros();
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += Bucket(i);
+            if (seen >= rank && seen > 0) {
+                uint64_t limit = BucketLimit(i);
+                return limit > 0 && limit < max ? limit : max;
+            }
+        }
+        return max;
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> sumMicros_{0};
+    std::atomic<uint64_t> maxMicros_{0};
+};
+
+struct ProgressStats {
+    // Progress, message and button changes that reached the native side, from
+    // any thread
+    std::atomic<uint64_t> updatesReceived{0};
+    // Changes replaced by a newer one before they made it to the backend
+    std::atomic<uint64_t> updatesCoalesced{0};
+    // Progress changes dropped because they wouldn't have moved a pixel
+    std::atomic<uint64_t> updatesSuppressed{0};
+    // Bytes of strings copied in from JS or native callers
+    std::atomic<uint64_t> stringBytes{0};
+    // Calls to the N-API update functions, and the time spent in them
+    std::atomic<uint64_t> napiCalls{0};
+    std::atomic<uint64_t> napiNanoseconds{0};
+    // Updates handed to the backend, and the calls it took. Bars batched into
+    // a single backend call only count one call between them, so the latter
+    // is only kept globally.
+    std::atomic<uint64_t> backendDispatches{0};
+    std::atomic<uint64_t> backendCalls{0};
+    // From the oldest change in a frame until the backend has taken it
+    LatencyHistogram latency;
+
+    void AddTo(ProgressStats& total) const {
+        Count(total.updatesReceived, updatesReceived.load(std::memory_order_relaxed));
+        Count(total.updatesCoalesced, updatesCoalesced.load(std::memory_order_relaxed));
+        Count(total.updatesSuppressed, updatesSuppressed.load(std::memory_order_relaxed));
+        Count(total.stringBytes, stringBytes.load(std::memory_order_relaxed));
+        Count(total.napiCalls, napiCalls.load(std::memory_order_relaxed));
+        Count(total.napiNanoseconds, napiNanoseconds.load(std::memory_order_relaxed));
+        Count(total.backendDispatches, backendDispatches.load(std::memory_order_relaxed));
+        Count(total.backendCalls, backendCalls.load(std::memory_order_relaxed));
+        latency.AddTo(total.latency);
+    }
+};
+
+// Adds the time until it goes out of scope to the stats it is pointed at by
+// then, if any. For N-API functions, which can return from anywhere.
+class NapiCallTimer {
+public:
+    NapiCallTimer() : start_(std::chrono::steady_clock::now()) {}
+
+    ~NapiCallTimer() {
+        if (stats) {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            Count(stats->napiCalls);
+            Count(stats->napiNanoseconds, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    NapiCallTimer(const NapiCallTimer&) = delete;
+    NapiCallTimer& operator=(const NapiCallTimer&) = delete;
+
+    ProgressStats* stats = nullptr;
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif // PROGRESS_STATS_H
@@ -0,0 +1,59 @@
+// Layout of the shared progress channel, mirrored in src/progress_bar.cpp.
+// Writers store the progress, then bump the sequence so the native side
+// knows something changed.
+const SEQUENCE = 0;
+const VALUE = 1;
+const LENGTH = 4;
+const SCALE = 10000;
+
+/**
+ * Creates the buffer backing a shared progress channel.
+ */
+export function createSharedProgressBuffer(): SharedArrayBuffer {
+  return new SharedArrayBuffer(LENGTH * Int32Array.BYTES_PER_ELEMENT);
+}
+
+/**
+ * Writes progress into a buffer obtained from `ProgressBar.sharedProgress`.
+ * Safe to use from any worker thread - this module does not load the native
+ * addon, and writes never block or wake the main thread.
+ *
+ * @example
+ * // worker.js
+ * const { SharedProgress } = require("native-progress-bar/lib/shared-progress");
+ * const shared = new SharedProgress(workerData.progressBuffer);
+ * shared.progress = 42.5;
+ */
+export class SharedProgress {
+  private readonly view: Int32Array;
+
+  constructor(buffer: SharedArrayBuffer) {
+    if (buffer.byteLength < LENGTH * Int32Array.BYTES_PER_ELEMENT) {
+      throw new Error("Buffer is too small to be a shared progress channel");
+    }
+
+    this.view = new Int32Array(buffer, 0, LENGTH);
+  }
+
+  /**
+   * The progress of the progress bar, between 0 and 100
+   */
+  public get progress() {
+    return Atomics.load(this.view, VALUE) / SCALE;
+  }
+  public set progress(value: number) {
+    if (value < 0 || value > 100) {
+      throw new Error("Progress must be between 0 and 100");
+    }
+
+    Atomics.store(this.view, VALUE, Math.round(value * SCALE));
+    Atomics.add(this.view, SEQUENCE, 1);
+  }
+
+  /**
+   * The underlying Int32Array, handed to the native side
+   */
+  public get array() {
+    return this.view;
+  }
+}
@@ -0,0 +1,361 @@
+#include "shared_segment.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static unsigned long CurrentProcessId() {
+    return GetCurrentProcessId();
+}
+
+static bool ProcessExists(uint32_t pid) {
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!process) {
+        // Access denied still means there is one
+        return GetLastError() != ERROR_INVALID_PARAMETER;
+    }
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+}
+#else
+static unsigned long CurrentProcessId() {
+    return static_cast<unsigned long>(getpid());
+}
+
+static bool ProcessExists(uint32_t pid) {
+    // EPERM means there is one, just not ours to signal
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+#endif
+
+// Short enough for macOS, which allows 31 characters including the slash
+static std::string NewSegmentName() {
+    std::random_device device;
+    uint64_t random = (static_cast<uint64_t>(device()) << 32) ^ device() ^
+                      static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    char name[32];
+    snprintf(name, sizeof(name), "npb-%lx-%08x", CurrentProcessId() & 0xffffff,
+             static_cast<uint32_t>(random ^ (random >> 32)));
+    return name;
+}
+
+// Names come from other processes, so only ours get near the platform
+static bool IsSegmentName(const char* name) {
+    size_t length = strlen(name);
+    if (length < 5 || length > 24 || strncmp(name, "npb-", 4) != 0) {
+        return false;
+    }
+    for (size_t i = 4; i < length; i++) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+static std::wstring PlatformName(const std::string& name) {
+    return L"Local\\" + std::wstring(name.begin(), name.end());
+}
+
+SharedSegment* SharedSegment::Create() {
+    for (int attempt = 0; attempt < 4; attempt++) {
+        std::string name = NewSegmentName();
+        HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                            sizeof(SharedSegmentLayout), PlatformName(name).c_str());
+        if (!mapping) {
+            return nullptr;
+        }
+        if (GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(mapping);
+            continue;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedSegmentLayout));
+        if (!view) {
+            CloseHandle(mapping);
+            return nullptr;
+        }
+
+        SharedSegment* segment = new SharedSegment();
+        segment->name_ = std::move(name);
+        segment->layout_ = static_cast<SharedSegmentLayout*>(view);
+        segment->owner_ = true;
+        segment->mapping_ = mapping;
+        segment->layout_->progress.store(-1, std::memory_order_relaxed);
+        segment->layout_->version.store(kSharedSegmentVersion, std::memory_order_relaxed);
+        segment->layout_->magic.store(kSharedSegmentMagic, std::memory_order_release);
+        return segment;
+    }
+    return nullptr;
+}
+
+SharedSegment* SharedSegment::Open(const char* name) {
+    if (!IsSegmentName(name)) {
+        return nullptr;
+    }
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, PlatformName(name).c_str());
+    if (!mapping) {
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedSegmentLayout));
+    if (!view) {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+
+    SharedSegmentLayout* layout = static_cast<SharedSegmentLayout*>(view);
+    if (layout->magic.load(std::memory_order_acquire) != kSharedSegmentMagic ||
+        layout->version.load(std::memory_order_relaxed) != kSharedSegmentVersion) {
+        UnmapViewOfFile(view);
+        CloseHandle(mapping);
+        return nullptr;
+    }
+
+    SharedSegment* segment = new SharedSegment();
+    segment->name_ = name;
+    segment->layout_ = layout;
+    segment->mapping_ = mapping;
+    return segment;
+}
+
+// Windows removes the name along with the last handle to it
+SharedSegment::~SharedSegment() {
+    UnmapViewOfFile(layout_);
+    CloseHandle(static_cast<HANDLE>(mapping_));
+}
+
+#else
+
+static std::string PlatformName(const std::string& name) {
+    return "/" + name;
+}
+
+SharedSegment* SharedSegment::Create() {
+    for (int attempt = 0; attempt < 4; attempt++) {
+        std::string name = NewSegmentName();
+        std::string path = PlatformName(name);
+        int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            if (errno == EEXIST) {
+                continue;
+            }
+            return nullptr;
+        }
+
+        // A new segment is all zeros, which is what every field starts as
+        void* view = MAP_FAILED;
+        if (ftruncate(fd, sizeof(SharedSegmentLayout)) == 0) {
+            view = mmap(nullptr, sizeof(SharedSegmentLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (view == MAP_FAILED) {
+            shm_unlink(path.c_str());
+            return nullptr;
+        }
+
+        SharedSegment* segment = new SharedSegment();
+        segment->name_ = std::move(name);
+        segment->layout_ = static_cast<SharedSegmentLayout*>(view);
+        segment->owner_ = true;
+        segment->layout_->progress.store(-1, std::memory_order_relaxed);
+        segment->layout_->version.store(kSharedSegmentVersion, std::memory_order_relaxed);
+        segment->layout_->magic.store(kSharedSegmentMagic, std::memory_order_release);
+        return segment;
+    }
+    return nullptr;
+}
+
+SharedSegment* SharedSegment::Open(const char* name) {
+    if (!IsSegmentName(name)) {
+        return nullptr;
+    }
+    int fd = shm_open(PlatformName(name).c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // The creator may not have sized it yet
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(SharedSegmentLayout)) {
+        view = mmap(nullptr, sizeof(SharedSegmentLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+
+    SharedSegmentLayout* layout = static_cast<SharedSegmentLayout*>(view);
+    if (layout->magic.load(std::memory_order_acquire) != kSharedSegmentMagic ||
+        layout->version.load(std::memory_order_relaxed) != kSharedSegmentVersion) {
+        munmap(view, sizeof(SharedSegmentLayout));
+        return nullptr;
+    }
+
+    SharedSegment* segment = new SharedSegment();
+    segment->name_ = name;
+    segment->layout_ = layout;
+    return segment;
+}
+
+SharedSegment::~SharedSegment() {
+    munmap(layout_, sizeof(SharedSegmentLayout));
+    if (owner_) {
+        shm_unlink(PlatformName(name_).c_str());
+    }
+}
+
+#endif
+
+// How much of `message` fits, without splitting a character
+static size_t FittingLength(const char* message, size_t length) {
+    if (length <= kSharedSegmentMessageBytes) {
+        return length;
+    }
+    length = kSharedSegmentMessageBytes;
+    while (length > 0 && (static_cast<unsigned char>(message[length]) & 0xc0) == 0x80) {
+        length--;
+    }
+    return length;
+}
+
+// The sequence after `sequence`, held by `writer` if it is odd
+static uint64_t NextSequence(uint64_t sequence, uint32_t writer) {
+    return ((sequence + 1) & 0xffffffff) | (static_cast<uint64_t>(writer) << 32);
+}
+
+// Makes the odd sequence `odd` even again if its writer's process is gone,
+// unless someone else already did
+static void EndAbandonedWrite(SharedSegmentLayout* layout, uint64_t odd) {
+    if (ProcessExists(static_cast<uint32_t>(odd >> 32))) {
+        return;
+    }
+    layout->sequence.compare_exchange_strong(odd, NextSequence(odd, 0), std::memory_order_acq_rel,
+                                             std::memory_order_relaxed);
+}
+
+void WriteSharedSegment(SharedSegmentLayout* layout, const int32_t* progress, const char* message,
+                        size_t length) {
+    // Take the sequence from even to odd. Another writer holds it while it
+    // is odd, for as long as a few stores take, or it died holding it.
+    uint32_t writer = static_cast<uint32_t>(CurrentProcessId());
+    uint64_t sequence = layout->sequence.load(std::memory_order_relaxed);
+    uint64_t waitingOn = 0;
+    int spins = 0;
+    std::chrono::steady_clock::time_point waitingSince;
+    for (;;) {
+        if (!(sequence & 1)) {
+            if (layout->sequence.compare_exchange_weak(sequence, NextSequence(sequence, writer),
+                                                       std::memory_order_acquire,
+                                                       std::memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (sequence != waitingOn) {
+            waitingOn = sequence;
+            waitingSince = now;
+            spins = 0;
+        } else if (now - waitingSince >= kSharedSegmentWriteTimeout) {
+            EndAbandonedWrite(layout, sequence);
+            waitingSince = now;
+        }
+        // A write takes microseconds, so only one that doesn't end soon is
+        // worth sleeping on
+        if (spins++ < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        sequence = layout->sequence.load(std::memory_order_relaxed);
+    }
+    // No store below may be seen before the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (progress) {
+        layout->progress.store(*progress, std::memory_order_relaxed);
+    }
+    if (message) {
+        length = FittingLength(message, length);
+        for (size_t word = 0; word * 4 < length; word++) {
+            uint32_t packed = 0;
+            size_t bytes = std::min<size_t>(4, length - word * 4);
+            memcpy(&packed, message + word * 4, bytes);
+            layout->message[word].store(packed, std::memory_order_relaxed);
+        }
+        layout->messageLength.store(static_cast<uint32_t>(length), std::memory_order_relaxed);
+        layout->messageVersion.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Nobody else ends a write while this process is alive
+    uint64_t odd = NextSequence(sequence, writer);
+    layout->sequence.store(NextSequence(odd, 0), std::memory_order_release);
+}
+
+bool ReadSharedSegment(SharedSegmentLayout* layout, SharedSegmentReader* reader, int32_t* progress,
+                       std::string* message, bool* messageChanged) {
+    uint64_t before = layout->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+        auto now = std::chrono::steady_clock::now();
+        if (before != reader->oddSequence) {
+            reader->oddSequence = before;
+            reader->oddSince = now;
+        } else if (now - reader->oddSince >= kSharedSegmentWriteTimeout) {
+            EndAbandonedWrite(layout, before);
+            reader->oddSince = now;
+        }
+        return false;
+    }
+    if (before == reader->sequence) {
+        return false;
+    }
+
+    int32_t nextProgress = layout->progress.load(std::memory_order_relaxed);
+    uint32_t nextMessageVersion = layout->messageVersion.load(std::memory_order_relaxed);
+    bool changed = nextMessageVersion != reader->messageVersion;
+    if (changed) {
+        size_t length = std::min<size_t>(layout->messageLength.load(std::memory_order_relaxed),
+                                         kSharedSegmentMessageBytes);
+        message->resize(length);
+        for (size_t word = 0; word * 4 < length; word++) {
+            uint32_t packed = layout->message[word].load(std::memory_order_relaxed);
+            memcpy(&(*message)[word * 4], &packed, std::min<size_t>(4, length - word * 4));
+        }
+    }
+
+    // The copy is whole only if no writer started in the meantime
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (layout->sequence.load(std::memory_order_relaxed) != before) {
+        return false;
+    }
+
+    reader->sequence = before;
+    *progress = nextProgress;
+    if (changed) {
+        reader->messageVersion = nextMessageVersion;
+    }
+    *messageChanged = changed;
+    return true;
+}
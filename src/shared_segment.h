@@ -0,0 +1,114 @@
+#ifndef SHARED_SEGMENT_H
+#define SHARED_SEGMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// A bar's progress and message in named shared memory, so that another
+// process can write them without a message to the bar's process per tick.
+// The bar's process samples the segment once per frame, like a
+// SharedArrayBuffer channel.
+//
+// Writes are guarded by a seqlock: a writer makes the sequence odd, stores,
+// and makes it even again; a reader that saw the same even sequence before
+// and after copying knows its copy is whole. Nobody ever waits on a reader,
+// and a torn read is simply retried on the next frame.
+//
+// A writer that dies while the sequence is odd would leave it odd for good,
+// so the odd sequence carries the writer's process ID in its upper half.
+// Whoever waits on it for kSharedSegmentWriteTimeout, writer or reader,
+// makes it even again if that process is gone. A writer that is only slow,
+// stopped or in a debugger keeps it: ending its write would let it go on
+// storing into a segment that readers take as whole. What a dead writer
+// stored so far stays, and is overwritten by the next write.
+
+static const uint32_t kSharedSegmentMagic = 0x4e504253;  // "NPBS"
+static const uint32_t kSharedSegmentVersion = 2;
+// Much longer than any write takes, even with the writer descheduled. How
+// often a waiter checks whether the writer's process is still there.
+static const std::chrono::milliseconds kSharedSegmentWriteTimeout(500);
+static const size_t kSharedSegmentMessageWords = 256;
+// Longer messages are cut short, at a character boundary
+static const size_t kSharedSegmentMessageBytes = kSharedSegmentMessageWords * 4;
+
+// Shared between processes, so every field is a lock-free atomic
+struct SharedSegmentLayout {
+    // Set last by the creator, once the rest is in place
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> version;
+    // The write count below, and the writer's process ID above while odd
+    std::atomic<uint64_t> sequence;
+    // Bumped with every message, so readers skip copying an unchanged one
+    std::atomic<uint32_t> messageVersion;
+    // Progress times kSharedProgressScale, as in the SharedArrayBuffer
+    // channel. -1 until a writer sets it.
+    std::atomic<int32_t> progress;
+    std::atomic<uint32_t> messageLength;
+    // UTF-8, packed four bytes to a word
+    std::atomic<uint32_t> message[kSharedSegmentMessageWords];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "Shared segments need address-free atomics");
+
+// Either end of a mapped segment. The creator removes the name when it is
+// destroyed; processes that have it open keep their mapping until they
+// close it too.
+class SharedSegment {
+public:
+    // Creates a segment under a new, unguessable name. Returns null if the
+    // platform refuses.
+    static SharedSegment* Create();
+    // Maps the segment `name` names. Returns null if there is none, or it
+    // isn't one of ours.
+    static SharedSegment* Open(const char* name);
+
+    ~SharedSegment();
+
+    // Without the platform's prefix, as passed to Open()
+    const std::string& name() const {
+        return name_;
+    }
+
+    SharedSegmentLayout* layout() const {
+        return layout_;
+    }
+
+private:
+    SharedSegment() = default;
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    std::string name_;
+    SharedSegmentLayout* layout_ = nullptr;
+    bool owner_ = false;
+    // The mapping's handle on Windows
+    void* mapping_ = nullptr;
+};
+
+// Stores whichever of progress and message aren't null in one write. Writers
+// from several threads or processes take turns; one that waits on the same
+// write for kSharedSegmentWriteTimeout ends it if its writer is gone.
+void WriteSharedSegment(SharedSegmentLayout* layout, const int32_t* progress, const char* message,
+                        size_t length);
+
+// What a reader remembers from one read of a segment to the next
+struct SharedSegmentReader {
+    uint64_t sequence = 0;
+    uint32_t messageVersion = 0;
+    // The odd sequence the last read found, and since when
+    uint64_t oddSequence = 0;
+    std::chrono::steady_clock::time_point oddSince;
+};
+
+// Copies the segment if it changed since the reader's last read, and the
+// message only if it changed too. Returns false if there is nothing new, or
+// a write is under way; ends the write instead if it has been under way for
+// too long and its writer is gone.
+bool ReadSharedSegment(SharedSegmentLayout* layout, SharedSegmentReader* reader, int32_t* progress,
+                       std::string* message, bool* messageChanged);
+
+#endif // SHARED_SEGMENT_H
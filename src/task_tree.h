@@ -0,0 +1,157 @@
+#ifndef TASK_TREE_H
+#define TASK_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Progress made of weighted steps, each of which may be made of weighted
+// steps of its own. A task with subtasks is as far along as their weighted
+// average; only tasks without subtasks report progress.
+//
+// Every task keeps the weighted sum of its subtasks' progress, so a change
+// to one task moves each of its ancestors by a single delta: an update costs
+// one step per level, however many tasks there are and however many
+// siblings it has. The root is task 0.
+class TaskTree {
+public:
+    static constexpr uint32_t kRoot = 0;
+
+    TaskTree() {
+        nodes_.emplace_back();
+    }
+
+    size_t size() const {
+        return nodes_.size();
+    }
+
+    bool Contains(uint32_t id) const {
+        return id < nodes_.size();
+    }
+
+    // Adds a subtask worth `weight` of its parent, relative to its siblings,
+    // and returns its id. A task that reported progress of its own starts
+    // over from its subtasks' once it gets the first one.
+    uint32_t Add(uint32_t parent, std::string name, double weight) {
+        uint32_t id = static_cast<uint32_t>(nodes_.size());
+        Node node;
+        node.parent = parent;
+        node.weight = weight;
+        node.name = std::move(name);
+        nodes_.push_back(std::move(node));
+
+        Node& owner = nodes_[parent];
+        double before = owner.fraction;
+        if (owner.children == 0) {
+            owner.done = 0;
+        }
+        owner.children++;
+        owner.incomplete++;
+        owner.childWeight += weight;
+        UpdateFraction(owner);
+        if (parent != kRoot) {
+            Propagate(parent, before);
+        }
+        return id;
+    }
+
+    // Sets the progress of a task without subtasks, between 0 and 1. Returns
+    // false if the task has subtasks.
+    bool Set(uint32_t id, double fraction) {
+        Node& node = nodes_[id];
+        if (node.children > 0) {
+            return false;
+        }
+
+        double before = node.fraction;
+        node.fraction = std::min(1.0, std::max(0.0, fraction));
+        if (id != kRoot) {
+            Propagate(id, before);
+        }
+        current_ = id;
+        return true;
+    }
+
+    // How far along everything is, between 0 and 1
+    double Progress() const {
+        return nodes_[kRoot].fraction;
+    }
+
+    // The task that reported progress last, or the root if none has
+    uint32_t Current() const {
+        return current_;
+    }
+
+    // Names from the outermost task down to `id`, skipping unnamed ones
+    void AppendPath(std::string& out, uint32_t id, const char* separator) const {
+        path_.clear();
+        for (uint32_t at = id; at != kRoot; at = nodes_[at].parent) {
+            if (!nodes_[at].name.empty()) {
+                path_.push_back(at);
+            }
+        }
+        for (size_t i = path_.size(); i > 0; i--) {
+            out.append(nodes_[path_[i - 1]].name);
+            if (i > 1) {
+                out.append(separator);
+            }
+        }
+    }
+
+private:
+    struct Node {
+        uint32_t parent = kRoot;
+        uint32_t children = 0;
+        // Subtasks that aren't done. Once none are left the task is done too,
+        // exactly, whatever rounding the sums picked up on the way.
+        uint32_t incomplete = 0;
+        double weight = 1;
+        double childWeight = 0;
+        // Sum of weight * fraction over the subtasks
+        double done = 0;
+        double fraction = 0;
+        std::string name;
+    };
+
+    // Carries a change of `id`'s progress, from `before`, up to the root
+    void Propagate(uint32_t id, double before) {
+        while (id != kRoot) {
+            Node& node = nodes_[id];
+            Node& parent = nodes_[node.parent];
+            double parentBefore = parent.fraction;
+
+            parent.done += node.weight * (node.fraction - before);
+            if (before >= 1 && node.fraction < 1) {
+                parent.incomplete++;
+            } else if (before < 1 && node.fraction >= 1) {
+                parent.incomplete--;
+            }
+            UpdateFraction(parent);
+
+            if (parent.fraction == parentBefore) {
+                return;
+            }
+            id = node.parent;
+            before = parentBefore;
+        }
+    }
+
+    static void UpdateFraction(Node& node) {
+        if (node.incomplete == 0) {
+            node.fraction = 1;
+        } else if (node.childWeight > 0) {
+            node.fraction = std::min(1.0, std::max(0.0, node.done / node.childWeight));
+        } else {
+            node.fraction = 0;
+        }
+    }
+
+    std::vector<Node> nodes_;
+    uint32_t current_ = kRoot;
+    // Reused by AppendPath()
+    mutable std::vector<uint32_t> path_;
+};
+
+#endif // TASK_TREE_H
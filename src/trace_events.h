@@ -0,0 +1,271 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Opt-in tracing of the update pipeline, exported as Chrome trace_event JSON
+// (chrome://tracing, Perfetto). Every thread records complete spans into its
+// own ring buffer, so recording never takes a lock; the oldest events are
+// overwritten once a buffer is full. While tracing is off, a span costs one
+// relaxed load.
+//
+// A thread's buffer goes back to the registry when the thread exits, and is
+// handed to the next thread that needs one. Worker threads come and go with
+// their environments, so there are only ever as many buffers as threads were
+// recording at once.
+//
+// Names must be string literals: only the pointer is recorded.
+
+struct TraceThreadBuffer {
+    static constexpr size_t kCapacity = 1 << 14;
+
+    // A slot is rewritten under its own sequence number, odd while the write
+    // is in progress, so readers can skip slots torn by a concurrent write
+    struct Slot {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<const char*> argName{nullptr};
+        std::atomic<int64_t> arg{0};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> duration{0};
+    };
+
+    TraceThreadBuffer(uint32_t id, const char* name) : id(id), name(name), slots(new Slot[kCapacity]) {}
+
+    // Hands the buffer to a new thread. What the previous one recorded is
+    // dropped. Called with the registry's mutex held.
+    void Reuse(uint32_t newId, const char* newName) {
+        id = newId;
+        name = newName;
+        first = written.load(std::memory_order_relaxed);
+    }
+
+    // Only called by the owning thread
+    void Record(const char* name, uint64_t start, uint64_t duration, const char* argName, int64_t arg) {
+        uint64_t index = written.load(std::memory_order_relaxed);
+        Slot& slot = slots[index % kCapacity];
+
+        uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.argName.store(argName, std::memory_order_relaxed);
+        slot.arg.store(arg, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+
+        written.store(index + 1, std::memory_order_release);
+    }
+
+    // The owning thread's, guarded by the registry's mutex like the rest of
+    // what Reuse() sets
+    uint32_t id;
+    // See TraceSetThreadName()
+    const char* name;
+    // Index of the first event the owning thread recorded
+    uint64_t first = 0;
+    // Whether a live thread owns the buffer
+    bool inUse = true;
+    std::atomic<uint64_t> written{0};
+    std::unique_ptr<Slot[]> slots;
+};
+
+// A buffer for every thread that is recording, and for threads that have
+// exited until their buffer is reused, so that their events can still be
+// exported.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceThreadBuffer>> buffers;
+    uint32_t lastId = 0;
+    std::atomic<bool> enabled{false};
+    // Events that started before tracing was last turned on are left out
+    std::atomic<uint64_t> since{0};
+};
+
+inline TraceRegistry& GetTraceRegistry() {
+    static TraceRegistry* registry = new TraceRegistry();
+    return *registry;
+}
+
+inline uint64_t TraceNow() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+inline bool IsTracing() {
+    return GetTraceRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+inline void SetTracing(bool enabled) {
+    TraceRegistry& registry = GetTraceRegistry();
+    if (enabled && !registry.enabled.load()) {
+        registry.since.store(TraceNow());
+    }
+    registry.enabled.store(enabled);
+}
+
+inline const char*& TraceThreadName() {
+    thread_local const char* name = nullptr;
+    return name;
+}
+
+// Names the calling thread in exported traces. `name` must be a literal.
+// Doesn't allocate anything until the thread records its first span.
+inline void TraceSetThreadName(const char* name) {
+    TraceThreadName() = name;
+}
+
+// The calling thread's buffer, taken from a thread that has exited or
+// created on first use
+inline TraceThreadBuffer* GetTraceThreadBuffer() {
+    // Returns the buffer when the thread exits
+    struct Owner {
+        TraceThreadBuffer* buffer = nullptr;
+
+        ~Owner() {
+            if (buffer) {
+                TraceRegistry& registry = GetTraceRegistry();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                buffer->inUse = false;
+            }
+        }
+    };
+    thread_local Owner owner;
+
+    if (!owner.buffer) {
+        TraceRegistry& registry = GetTraceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        uint32_t id = ++registry.lastId;
+        for (const std::unique_ptr<TraceThreadBuffer>& buffer : registry.buffers) {
+            if (!buffer->inUse) {
+                buffer->Reuse(id, TraceThreadName());
+                buffer->inUse = true;
+                owner.buffer = buffer.get();
+                break;
+            }
+        }
+        if (!owner.buffer) {
+            registry.buffers.emplace_back(new TraceThreadBuffer(id, TraceThreadName()));
+            owner.buffer = registry.buffers.back().get();
+        }
+    }
+    return owner.buffer;
+}
+
+// Records a span from its construction until it goes out of scope, with an
+// optional numeric argument
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, int64_t arg = 0)
+        : name_(IsTracing() ? name : nullptr), argName_(argName), arg_(arg), start_(name_ ? TraceNow() : 0) {}
+
+    ~TraceSpan() {
+        if (name_) {
+            GetTraceThreadBuffer()->Record(name_, start_, TraceNow() - start_, argName_, arg_);
+        }
+    }
+
+    void SetArg(const char* argName, int64_t arg) {
+        argName_ = argName;
+        arg_ = arg;
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    const char* argName_;
+    int64_t arg_;
+    uint64_t start_;
+};
+
+inline void AppendTraceMicros(std::string& out, uint64_t nanoseconds) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%llu.%03u",
+                          static_cast<unsigned long long>(nanoseconds / 1000),
+                          static_cast<unsigned>(nanoseconds % 1000));
+    out.append(buffer, length);
+}
+
+// Appends everything recorded since tracing was last turned on, as a trace
+// JSON object. Safe to call while other threads keep recording; events
+// overwritten while they are read are left out.
+inline void AppendTraceJson(std::string& out, uint64_t pid) {
+    TraceRegistry& registry = GetTraceRegistry();
+    uint64_t since = registry.since.load();
+    char buffer[64];
+
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    auto beginEvent = [&](const char* phase, const char* name, uint32_t tid) {
+        if (!first) {
+            out.push_back(',');
+        }
+        first = false;
+        int length = snprintf(buffer, sizeof(buffer), "{\"pid\":%llu,\"tid\":%u,\"ph\":\"",
+                              static_cast<unsigned long long>(pid), tid);
+        out.append(buffer, length);
+        out.append(phase);
+        out.append("\",\"cat\":\"native-progress-bar\",\"name\":\"");
+        out.append(name);
+        out.push_back('"');
+    };
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<TraceThreadBuffer>& thread : registry.buffers) {
+        const char* threadName = thread->name;
+        if (threadName) {
+            beginEvent("M", "thread_name", thread->id);
+            out.append(",\"args\":{\"name\":\"");
+            out.append(threadName);
+            out.append("\"}}");
+        }
+
+        uint64_t written = thread->written.load(std::memory_order_acquire);
+        uint64_t begin = written > TraceThreadBuffer::kCapacity ? written - TraceThreadBuffer::kCapacity : 0;
+        begin = begin > thread->first ? begin : thread->first;
+        for (uint64_t index = begin; index < written; index++) {
+            const TraceThreadBuffer::Slot& slot = thread->slots[index % TraceThreadBuffer::kCapacity];
+            uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            const char* argName = slot.argName.load(std::memory_order_relaxed);
+            int64_t arg = slot.arg.load(std::memory_order_relaxed);
+            uint64_t start = slot.start.load(std::memory_order_relaxed);
+            uint64_t duration = slot.duration.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((sequence & 1) || slot.sequence.load(std::memory_order_relaxed) != sequence || !name ||
+                start < since) {
+                continue;
+            }
+
+            beginEvent("X", name, thread->id);
+            out.append(",\"ts\":");
+            AppendTraceMicros(out, start);
+            out.append(",\"dur\":");
+            AppendTraceMicros(out, duration);
+            if (argName) {
+                int length = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(arg));
+                out.append(",\"args\":{\"");
+                out.append(argName);
+                out.append("\":");
+                out.append(buffer, length);
+                out.push_back('}');
+            }
+            out.push_back('}');
+        }
+    }
+    out.append("]}");
+}
+
+#endif // TRACE_EVENTS_H
@@ -0,0 +1,179 @@
+#ifndef TRANSFER_RATE_H
+#define TRANSFER_RATE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+// Smoothed throughput of a transfer, from a series of byte counts. Uses an
+// exponentially weighted moving average over time rather than over samples,
+// so the estimate doesn't depend on how often the caller reports progress.
+// Once counts stop coming in, the rate read back decays as if they had
+// stopped moving, so a stalled transfer doesn't keep its last rate.
+class TransferRate {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // How far back the average effectively looks
+    static constexpr double kTimeConstant = 3.0;
+    // Counts reported closer together than this are folded into one sample
+    static constexpr double kMinSampleInterval = 0.05;
+    // How long without a count before the rate starts to decay. Covers
+    // callers that report once per second or so.
+    static constexpr double kStallGrace = 1.5;
+    // Slower than this, there is no telling when the transfer will be done
+    static constexpr double kMinBytesPerSecond = 1.0;
+
+    void Reset(uint64_t done, Clock::time_point now) {
+        lastDone_ = done;
+        lastSample_ = now;
+        bytesPerSecond_ = 0;
+        hasRate_ = false;
+    }
+
+    void Sample(uint64_t done, Clock::time_point now) {
+        if (done < lastDone_) {
+            Reset(done, now);
+            return;
+        }
+
+        double elapsed = std::chrono::duration<double>(now - lastSample_).count();
+        if (elapsed < kMinSampleInterval) {
+            return;
+        }
+
+        double rate = (done - lastDone_) / elapsed;
+        if (hasRate_) {
+            double weight = 1.0 - std::exp(-elapsed / kTimeConstant);
+            bytesPerSecond_ += weight * (rate - bytesPerSecond_);
+        } else {
+            bytesPerSecond_ = rate;
+            hasRate_ = true;
+        }
+
+        lastDone_ = done;
+        lastSample_ = now;
+    }
+
+    // The rate as of `now`, decayed by however long the transfer has
+    // stalled beyond kStallGrace
+    double BytesPerSecond(Clock::time_point now) const {
+        double stalled = std::chrono::duration<double>(now - lastSample_).count() - kStallGrace;
+        if (stalled <= 0) {
+            return bytesPerSecond_;
+        }
+        return bytesPerSecond_ * std::exp(-stalled / kTimeConstant);
+    }
+
+    // Seconds until `remaining` more bytes are through, or -1 if unknown
+    double SecondsRemaining(uint64_t remaining, Clock::time_point now) const {
+        if (remaining == 0) {
+            return 0;
+        }
+        double bytesPerSecond = BytesPerSecond(now);
+        if (!hasRate_ || bytesPerSecond < kMinBytesPerSecond) {
+            return -1;
+        }
+        return remaining / bytesPerSecond;
+    }
+
+private:
+    uint64_t lastDone_ = 0;
+    Clock::time_point lastSample_;
+    double bytesPerSecond_ = 0;
+    bool hasRate_ = false;
+};
+
+// "1.5 MB", with decimal units like most file managers
+inline void AppendBytes(std::string& out, double bytes) {
+    static const char* const kUnits[] = { "B", "kB", "MB", "GB", "TB", "PB", "EB" };
+    size_t unit = 0;
+    while (bytes >= 1000 && unit + 1 < sizeof(kUnits) / sizeof(kUnits[0])) {
+        bytes /= 1000;
+        unit++;
+    }
+
+    char buffer[32];
+    int length = unit == 0 || bytes >= 100
+        ? snprintf(buffer, sizeof(buffer), "%.0f %s", bytes, kUnits[unit])
+        : snprintf(buffer, sizeof(buffer), "%.1f %s", bytes, kUnits[unit]);
+    out.append(buffer, length);
+}
+
+// "4:05" or "1:04:05", or "--:--" if unknown
+inline void AppendDuration(std::string& out, double seconds) {
+    if (seconds < 0 || !std::isfinite(seconds)) {
+        out.append("--:--");
+        return;
+    }
+
+    uint64_t total = static_cast<uint64_t>(seconds + 0.5);
+    unsigned hours = static_cast<unsigned>(total / 3600);
+    unsigned minutes = static_cast<unsigned>(total / 60 % 60);
+    unsigned secs = static_cast<unsigned>(total % 60);
+
+    char buffer[32];
+    int length = hours > 0
+        ? snprintf(buffer, sizeof(buffer), "%u:%02u:%02u", hours, minutes, secs)
+        : snprintf(buffer, sizeof(buffer), "%u:%02u", minutes, secs);
+    out.append(buffer, length);
+}
+
+// Expands {done}, {total}, {percent}, {rate} and {eta} in `format` into
+// `out`, reusing its buffer, with the rate as of `now`. Anything else is
+// copied as is.
+inline void FormatTransferMessage(std::string& out, const std::string& format, uint64_t done,
+                                  uint64_t total, const TransferRate& rate,
+                                  TransferRate::Clock::time_point now) {
+    out.clear();
+
+    size_t i = 0;
+    while (i < format.size()) {
+        size_t open = format.find('{', i);
+        if (open == std::string::npos) {
+            out.append(format, i, std::string::npos);
+            break;
+        }
+        out.append(format, i, open - i);
+
+        size_t close = format.find('}', open);
+        if (close == std::string::npos) {
+            out.append(format, open, std::string::npos);
+            break;
+        }
+
+        const char* name = format.c_str() + open + 1;
+        size_t length = close - open - 1;
+        auto is = [&](const char* placeholder) {
+            return format.compare(open + 1, length, placeholder) == 0;
+        };
+
+        if (is("done")) {
+            AppendBytes(out, static_cast<double>(done));
+        } else if (is("total")) {
+            if (total > 0) {
+                AppendBytes(out, static_cast<double>(total));
+            } else {
+                out.append("?");
+            }
+        } else if (is("percent")) {
+            char buffer[16];
+            double percent = total > 0 ? 100.0 * done / total : 0;
+            int written = snprintf(buffer, sizeof(buffer), "%.0f%%", percent > 100 ? 100 : percent);
+            out.append(buffer, written);
+        } else if (is("rate")) {
+            AppendBytes(out, rate.BytesPerSecond(now));
+            out.append("/s");
+        } else if (is("eta")) {
+            AppendDuration(out, total > 0 && done <= total ? rate.SecondsRemaining(total - done, now) : -1);
+        } else {
+            out.append(name - 1, length + 2);
+        }
+
+        i = close + 1;
+    }
+}
+
+#endif // TRANSFER_RATE_H
@@ -0,0 +1,180 @@
+#ifndef UTF16_H
+#define UTF16_H
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROGRESS_BAR_UTF16_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define PROGRESS_BAR_UTF16_NEON 1
+#endif
+
+// UTF-8 to UTF-16 for the platforms that want the latter. Strings from JS are
+// almost always ASCII, so runs of it are widened 16 bytes at a time; anything
+// else goes through a strict decoder. Invalid input never fails: it becomes
+// U+FFFD, as in TextDecoder.
+//
+// Header-only and free of platform APIs, so it can be checked and measured
+// on any OS, see bench/utf16.cpp.
+
+// Decodes the code point at `*position` and moves past it. Invalid input
+// decodes to one U+FFFD per maximal subpart, as the WHATWG Encoding Standard
+// has it: the longest prefix of a valid sequence, or a single byte if not
+// even that. Overlong forms, surrogates and anything beyond U+10FFFF are
+// ruled out by the range allowed for the second byte.
+inline char32_t DecodeUtf8(const char* data, size_t length, size_t* position) {
+    size_t i = *position;
+    unsigned char lead = static_cast<unsigned char>(data[i]);
+    if (lead < 0x80) {
+        *position = i + 1;
+        return lead;
+    }
+
+    size_t count;
+    char32_t codePoint;
+    unsigned char lower = 0x80;
+    unsigned char upper = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        count = 1;
+        codePoint = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        count = 2;
+        codePoint = lead & 0x0f;
+        if (lead == 0xe0) {
+            lower = 0xa0;
+        } else if (lead == 0xed) {
+            upper = 0x9f;
+        }
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        count = 3;
+        codePoint = lead & 0x07;
+        if (lead == 0xf0) {
+            lower = 0x90;
+        } else if (lead == 0xf4) {
+            upper = 0x8f;
+        }
+    } else {
+        *position = i + 1;
+        return 0xfffd;
+    }
+
+    // A byte that doesn't continue the sequence ends it, and starts the next
+    size_t j = i + 1;
+    for (size_t k = 0; k < count; k++, j++) {
+        unsigned char next = j < length ? static_cast<unsigned char>(data[j]) : 0;
+        if (j >= length || next < lower || next > upper) {
+            *position = j;
+            return 0xfffd;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3f);
+        lower = 0x80;
+        upper = 0xbf;
+    }
+
+    *position = j;
+    return codePoint;
+}
+
+// Copies the ASCII bytes at the start of `data` to `out`, which must have room
+// for `length` units. Returns how many there were.
+inline size_t WidenAscii(const char* data, size_t length, char16_t* out) {
+    size_t i = 0;
+#if defined(PROGRESS_BAR_UTF16_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+#elif defined(PROGRESS_BAR_UTF16_NEON)
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        if (vmaxvq_u8(bytes) >= 0x80) {
+            break;
+        }
+        vst1q_u16(reinterpret_cast<uint16_t*>(out + i), vmovl_u8(vget_low_u8(bytes)));
+        vst1q_u16(reinterpret_cast<uint16_t*>(out + i + 8), vmovl_u8(vget_high_u8(bytes)));
+    }
+#endif
+    for (; i < length && static_cast<unsigned char>(data[i]) < 0x80; i++) {
+        out[i] = static_cast<char16_t>(data[i]);
+    }
+    return i;
+}
+
+// Replaces the contents of `out` with `data` in UTF-16. Reuses the capacity
+// `out` already has, so converting into the same string over and over
+// doesn't allocate once it is large enough.
+inline void AssignUtf8AsUtf16(std::u16string& out, const char* data, size_t length) {
+    // A UTF-16 string never has more units than its UTF-8 form has bytes
+    out.resize(length);
+    char16_t* units = &out[0];
+
+    size_t i = 0;
+    size_t written = 0;
+    while (i < length) {
+        size_t ascii = WidenAscii(data + i, length - i, units + written);
+        i += ascii;
+        written += ascii;
+        if (i == length) {
+            break;
+        }
+
+        char32_t codePoint = DecodeUtf8(data, length, &i);
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            units[written++] = static_cast<char16_t>(0xd800 | (codePoint >> 10));
+            units[written++] = static_cast<char16_t>(0xdc00 | (codePoint & 0x3ff));
+        } else {
+            units[written++] = static_cast<char16_t>(codePoint);
+        }
+    }
+    out.resize(written);
+}
+
+inline void AssignUtf8AsUtf16(std::u16string& out, const char* text) {
+    AssignUtf8AsUtf16(out, text, strlen(text));
+}
+
+// A string a backend shows, kept in both encodings. Setting the text it
+// already has is free, so callers can tell when there is nothing to redraw.
+class Utf16Text {
+public:
+    // Returns false, without converting anything, if `text` is unchanged
+    bool Assign(const char* text, size_t length) {
+        if (assigned_ && utf8_.size() == length && memcmp(utf8_.data(), text, length) == 0) {
+            return false;
+        }
+
+        utf8_.assign(text, length);
+        AssignUtf8AsUtf16(utf16_, text, length);
+        assigned_ = true;
+        return true;
+    }
+
+    bool Assign(const char* text) {
+        return Assign(text, strlen(text));
+    }
+
+    const char16_t* c_str() const {
+        return utf16_.c_str();
+    }
+
+    size_t size() const {
+        return utf16_.size();
+    }
+
+private:
+    std::string utf8_;
+    std::u16string utf16_;
+    bool assigned_ = false;
+};
+
+#endif // UTF16_H
@@ -0,0 +1,133 @@
+#ifndef WINDOW_POOL_H
+#define WINDOW_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What a backend's window pool has done so far, see ProgressBar.prewarm()
+struct WindowPoolStats {
+    // Windows built and waiting to be shown, and how many the pool keeps
+    size_t idle;
+    size_t target;
+    // Shows that got a window from the pool, and shows that had to build one
+    // while the pool was in use
+    uint64_t hits;
+    uint64_t misses;
+    // Time it took to build the windows handed out by the pool, which their
+    // shows didn't have to spend
+    uint64_t savedNanoseconds;
+};
+
+#ifdef __cplusplus
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// Windows built ahead of time and kept hidden, so that showing a bar only has
+// to fill one in. Closed windows go back to the pool while it has room. Off
+// until a target is set; `Window` must be cheap to copy and falsy when empty.
+template <typename Window>
+class WindowPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Builds windows until `target` are idle, or destroys the surplus. Runs on
+    // the thread the windows belong to.
+    template <typename Build, typename Destroy>
+    void Prewarm(size_t target, Build build, Destroy destroy) {
+        std::vector<Window> surplus;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            target_ = target;
+            while (idle_.size() > target_) {
+                surplus.push_back(idle_.back().window);
+                idle_.pop_back();
+            }
+        }
+        for (Window window : surplus) {
+            destroy(window);
+        }
+
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (idle_.size() >= target_) {
+                    break;
+                }
+            }
+
+            Clock::time_point start = Clock::now();
+            Window window = build();
+            if (!window) {
+                break;
+            }
+            uint64_t cost = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle_.push_back({ window, cost });
+            built_++;
+            buildNanoseconds_ += cost;
+        }
+    }
+
+    // Hands out an idle window. Returns false if there is none, in which case
+    // the caller builds one itself.
+    bool Take(Window* window) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (target_ == 0) {
+            return false;
+        }
+        if (idle_.empty()) {
+            misses_++;
+            return false;
+        }
+
+        *window = idle_.back().window;
+        savedNanoseconds_ += idle_.back().cost;
+        idle_.pop_back();
+        hits_++;
+        return true;
+    }
+
+    // Keeps a closed window, already hidden and reset, for a later show.
+    // Returns false if the pool is full, in which case the caller destroys it.
+    bool Return(Window window) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() >= target_) {
+            return false;
+        }
+
+        // Building it again would have cost about as much as any other
+        idle_.push_back({ window, built_ > 0 ? buildNanoseconds_ / built_ : 0 });
+        return true;
+    }
+
+    void GetStats(WindowPoolStats* stats) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats->idle = idle_.size();
+        stats->target = target_;
+        stats->hits = hits_;
+        stats->misses = misses_;
+        stats->savedNanoseconds = savedNanoseconds_;
+    }
+
+private:
+    struct Entry {
+        Window window;
+        // What it took to build
+        uint64_t cost;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> idle_;
+    size_t target_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t savedNanoseconds_ = 0;
+    uint64_t built_ = 0;
+    uint64_t buildNanoseconds_ = 0;
+};
+#endif
+
+#endif // WINDOW_POOL_H